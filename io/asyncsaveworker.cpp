@@ -0,0 +1,130 @@
+#include "./asyncsaveworker.h"
+#include "./passwordfile.h"
+
+#include <utility>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class AsyncSaveWorker
+ * \brief The AsyncSaveWorker class saves snapshots of password files on a background thread.
+ *
+ * Snapshots are saved one after another in the order they have been enqueued. A snapshot which is still pending when
+ * another one is enqueued is replaced by the newer one because the newer one contains all changes anyways. So
+ * back-to-back saves are coalesced and the futures returned for them are fulfilled by the same save.
+ *
+ * The thread is started when the first snapshot is enqueued and stopped when the worker is destroyed. Pending snapshots
+ * are still saved before the worker is destroyed.
+ */
+
+/*!
+ * \brief Constructs a new worker. The thread is not started yet.
+ */
+AsyncSaveWorker::AsyncSaveWorker()
+    : m_pendingOptions(PasswordFileSaveFlags::None)
+    , m_busy(false)
+    , m_saved(false)
+    , m_stopping(false)
+{
+}
+
+/*!
+ * \brief Saves pending snapshots and stops the thread.
+ */
+AsyncSaveWorker::~AsyncSaveWorker()
+{
+    {
+        const auto lock = std::lock_guard(m_mutex);
+        m_stopping = true;
+    }
+    m_pendingCondition.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+/*!
+ * \brief Enqueues the specified \a snapshot to be saved with the specified \a options.
+ * \returns Returns a future which is fulfilled when the snapshot (or a newer one replacing it) has been saved. It holds
+ *          the exception thrown by PasswordFile::save() if saving fails.
+ */
+std::shared_future<void> AsyncSaveWorker::enqueue(std::unique_ptr<PasswordFile> &&snapshot, PasswordFileSaveFlags options)
+{
+    auto replacedSnapshot = std::unique_ptr<PasswordFile>(); // destroy the replaced snapshot after unlocking
+    auto lock = std::unique_lock(m_mutex);
+    if (m_pending) {
+        replacedSnapshot = std::move(m_pending);
+    } else {
+        m_pendingPromise = std::promise<void>();
+        m_pendingFuture = m_pendingPromise.get_future().share();
+    }
+    m_pending = std::move(snapshot);
+    m_pendingOptions = options;
+    auto future = m_pendingFuture;
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&AsyncSaveWorker::run, this);
+    }
+    lock.unlock();
+    m_pendingCondition.notify_one();
+    return future;
+}
+
+/*!
+ * \brief Waits until all enqueued snapshots have been saved.
+ * \returns Returns whether a snapshot has been saved successfully since the last call.
+ */
+bool AsyncSaveWorker::wait()
+{
+    auto lock = std::unique_lock(m_mutex);
+    m_idleCondition.wait(lock, [this] { return !m_pending && !m_busy; });
+    return std::exchange(m_saved, false);
+}
+
+/*!
+ * \brief Returns whether no snapshot is being saved or pending.
+ */
+bool AsyncSaveWorker::isIdle()
+{
+    const auto lock = std::lock_guard(m_mutex);
+    return !m_pending && !m_busy;
+}
+
+/*!
+ * \brief Saves pending snapshots until the worker is destroyed.
+ */
+void AsyncSaveWorker::run()
+{
+    auto lock = std::unique_lock(m_mutex);
+    for (;;) {
+        m_pendingCondition.wait(lock, [this] { return m_pending || m_stopping; });
+        if (!m_pending) {
+            return;
+        }
+        auto snapshot = std::move(m_pending);
+        auto promise = std::move(m_pendingPromise);
+        const auto options = m_pendingOptions;
+        m_busy = true;
+        lock.unlock();
+
+        auto saved = false;
+        try {
+            snapshot->save(options);
+            saved = true;
+            promise.set_value();
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+        snapshot.reset();
+
+        lock.lock();
+        m_saved = m_saved || saved;
+        m_busy = false;
+        if (!m_pending) {
+            m_idleCondition.notify_all();
+        }
+    }
+}
+
+} // namespace Io
@@ -0,0 +1,47 @@
+#ifndef PASSWORD_FILE_IO_ASYNCSAVEWORKER_H
+#define PASSWORD_FILE_IO_ASYNCSAVEWORKER_H
+
+#include "../global.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Io {
+
+class PasswordFile;
+enum class PasswordFileSaveFlags : std::uint64_t;
+
+class PASSWORD_FILE_EXPORT AsyncSaveWorker {
+public:
+    explicit AsyncSaveWorker();
+    AsyncSaveWorker(const AsyncSaveWorker &) = delete;
+    ~AsyncSaveWorker();
+    AsyncSaveWorker &operator=(const AsyncSaveWorker &) = delete;
+
+    std::shared_future<void> enqueue(std::unique_ptr<PasswordFile> &&snapshot, PasswordFileSaveFlags options);
+    bool wait();
+    bool isIdle();
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_pendingCondition;
+    std::condition_variable m_idleCondition;
+    std::unique_ptr<PasswordFile> m_pending;
+    PasswordFileSaveFlags m_pendingOptions;
+    std::promise<void> m_pendingPromise;
+    std::shared_future<void> m_pendingFuture;
+    bool m_busy;
+    bool m_saved;
+    bool m_stopping;
+    std::thread m_thread;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_ASYNCSAVEWORKER_H
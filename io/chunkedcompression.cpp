@@ -0,0 +1,304 @@
+#include "./chunkedcompression.h"
+#include "./decompressingstreambuffer.h"
+#include "./parsingexception.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace Io {
+
+/// \brief The BlockStreamBuffer class appends the data written to it to a string.
+class BlockStreamBuffer : public std::streambuf {
+public:
+    explicit BlockStreamBuffer(std::string &block)
+        : m_block(block)
+    {
+    }
+
+protected:
+    std::streamsize xsputn(const char *data, std::streamsize size) override
+    {
+        m_block.append(data, static_cast<std::size_t>(size));
+        return size;
+    }
+    int_type overflow(int_type c) override
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            m_block.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+private:
+    std::string &m_block;
+};
+
+/*!
+ * \brief Returns the number of blocks to keep in flight when using \a threadCount threads.
+ * \remarks Twice the number of threads keeps all workers busy while the blocks are passed to/from the caller.
+ */
+static std::size_t maxPendingBlocks(std::size_t threadCount)
+{
+    return threadCount > 1 ? threadCount * 2 : 1;
+}
+
+/*!
+ * \class ChunkedCompressingStreamBuffer
+ * \brief The ChunkedCompressingStreamBuffer class provides a write-only stream buffer which splits the data written
+ *        to it into blocks and compresses the blocks independently of each other on multiple threads.
+ *
+ * Each full block is handed to a pool of worker threads which lives as long as the buffer. Up to two blocks per
+ * thread are in flight; when that limit is reached, the oldest block is awaited and written to the sink so the
+ * blocks end up in order and the memory usage stays bounded. Each block is preceded by its index entry consisting of
+ * the size of the compressed block and the size of the decompressed block (both as 32-bit little-endian integers).
+ * Each block is a complete stream of the used CompressionCodec so the blocks can be decompressed concurrently as well
+ * (see ChunkedDecompressingStreamBuffer).
+ *
+ * \remarks The compressed data is slightly bigger than when compressing it as one stream because the state of the
+ *          codec is not carried over from one block to the next.
+ */
+
+/*!
+ * \brief Constructs a new buffer compressing the data with the specified \a codec and writing it to \a sink.
+ * \param level Specifies the compression level (see CompressingStreamBuffer::create()).
+ * \param threadCount Specifies the number of threads to use for compressing (at least one).
+ * \throws Throws std::runtime_error when the codec is not supported.
+ */
+ChunkedCompressingStreamBuffer::ChunkedCompressingStreamBuffer(
+    CompressionCodec codec, std::streambuf *sink, std::optional<int> level, std::size_t threadCount)
+    : CompressingStreamBuffer(sink, blockSize)
+    , m_codec(codec)
+    , m_level(level)
+    , m_maxPendingBlocks(maxPendingBlocks(threadCount))
+    , m_threadPool(threadCount)
+{
+    if (!isCompressionCodecSupported(codec)) {
+        throw runtime_error(argsToString("Compressing failed. The codec \"", compressionCodecName(codec), "\" is not supported."));
+    }
+}
+
+/*!
+ * \brief Hands the specified block of \a data to the worker threads and writes the blocks which have been compressed.
+ * \remarks Waits for all pending blocks if \a finish is set.
+ */
+void ChunkedCompressingStreamBuffer::compress(const char *data, std::size_t size, bool finish)
+{
+    if (size) {
+        auto block = std::unique_ptr<Block>();
+        if (m_idleBlocks.empty()) {
+            block = make_unique<Block>();
+        } else {
+            block = std::move(m_idleBlocks.back());
+            m_idleBlocks.pop_back();
+        }
+        block->data.assign(data, size);
+        block->compressedData.clear();
+        block->result = m_threadPool.post([this, &block = *block](std::size_t) {
+            auto blockBuffer = BlockStreamBuffer(block.compressedData);
+            auto compressingBuffer = CompressingStreamBuffer::create(m_codec, &blockBuffer, m_level);
+            compressingBuffer->sputn(block.data.data(), static_cast<std::streamsize>(block.data.size()));
+            compressingBuffer->finish();
+        });
+        m_pendingBlocks.emplace_back(std::move(block));
+    }
+    while (!m_pendingBlocks.empty() && (finish || m_pendingBlocks.size() >= m_maxPendingBlocks)) {
+        writeBlock();
+    }
+}
+
+/*!
+ * \brief Waits for the oldest pending block to be compressed and writes it to the sink.
+ * \throws Rethrows the exception thrown when compressing the block.
+ */
+void ChunkedCompressingStreamBuffer::writeBlock()
+{
+    auto block = std::move(m_pendingBlocks.front());
+    m_pendingBlocks.pop_front();
+    block->result.get();
+    char indexEntry[8];
+    LE::getBytes(static_cast<std::uint32_t>(block->compressedData.size()), indexEntry);
+    LE::getBytes(static_cast<std::uint32_t>(block->data.size()), indexEntry + 4);
+    writeToSink(indexEntry, sizeof(indexEntry));
+    writeToSink(block->compressedData.data(), block->compressedData.size());
+    m_idleBlocks.emplace_back(std::move(block));
+}
+
+/*!
+ * \class ChunkedDecompressingStreamBuffer
+ * \brief The ChunkedDecompressingStreamBuffer class provides a read-only stream buffer which decompresses data
+ *        written by ChunkedCompressingStreamBuffer on multiple threads.
+ *
+ * The blocks are read ahead and handed to a pool of worker threads which lives as long as the buffer. Up to two
+ * blocks per thread are in flight. Each block is decompressed into its own buffer which is then read sequentially and
+ * reused once it has been consumed. So apart from the decompressed data of the blocks in flight, only a fixed amount
+ * of memory is required.
+ *
+ * \remarks Decompression errors are reported by throwing a ParsingException. When the buffer is used via an std::istream,
+ *          enable exceptions for std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Constructs a new buffer reading the compressed blocks from \a source.
+ * \param announcedSize Specifies the size of the decompressed data as stored in the file. It is not possible to read
+ *                      more data than that.
+ * \param threadCount Specifies the number of threads to use for decompressing (at least one).
+ * \throws Throws ParsingException when the codec is not supported.
+ */
+ChunkedDecompressingStreamBuffer::ChunkedDecompressingStreamBuffer(
+    CompressionCodec codec, std::streambuf *source, std::uint64_t announcedSize, std::size_t threadCount)
+    : ChunkedDecompressingStreamBuffer(codec, nullptr, 0, announcedSize, threadCount)
+{
+    m_source = source;
+}
+
+/*!
+ * \brief Constructs a new buffer decompressing the compressed blocks from the specified \a data.
+ * \param announcedSize Specifies the size of the decompressed data as stored in the file. It is not possible to read
+ *                      more data than that.
+ * \param threadCount Specifies the number of threads to use for decompressing (at least one).
+ * \remarks The \a data is passed to the codec directly without copying it first so it must outlive the buffer.
+ * \throws Throws ParsingException when the codec is not supported.
+ */
+ChunkedDecompressingStreamBuffer::ChunkedDecompressingStreamBuffer(
+    CompressionCodec codec, const char *data, std::size_t size, std::uint64_t announcedSize, std::size_t threadCount)
+    : m_codec(codec)
+    , m_source(nullptr)
+    , m_data(data)
+    , m_dataEnd(data + size)
+    , m_remainingSize(announcedSize)
+    , m_maxPendingBlocks(maxPendingBlocks(threadCount))
+    , m_threadPool(threadCount)
+{
+    if (!isCompressionCodecSupported(codec)) {
+        throw ParsingException(argsToString("Decompressing failed. The codec \"", compressionCodecName(codec), "\" is not supported."));
+    }
+}
+
+/*!
+ * \brief Destroys the buffer.
+ * \remarks Blocks which are still being decompressed are awaited.
+ */
+ChunkedDecompressingStreamBuffer::~ChunkedDecompressingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Reads the next blocks, hands them to the worker threads and provides the oldest one once decompressed.
+ * \throws Throws ParsingException when a decompression error occurs.
+ */
+ChunkedDecompressingStreamBuffer::int_type ChunkedDecompressingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (m_currentBlock) {
+        m_idleBlocks.emplace_back(std::move(m_currentBlock));
+    }
+
+    // read ahead until the maximum number of blocks is in flight
+    while (m_pendingBlocks.size() < m_maxPendingBlocks && m_remainingSize) {
+        auto block = std::unique_ptr<Block>();
+        if (m_idleBlocks.empty()) {
+            block = make_unique<Block>();
+        } else {
+            block = std::move(m_idleBlocks.back());
+            m_idleBlocks.pop_back();
+        }
+        if (!readBlock(*block)) {
+            m_idleBlocks.emplace_back(std::move(block));
+            break;
+        }
+        if (block->decompressedSize > m_remainingSize) {
+            throw ParsingException("Decompressing failed. The decompressed data exceeds the announced size.");
+        }
+        m_remainingSize -= block->decompressedSize;
+        if (block->decompressedSize > block->outputBufferSize) {
+            block->outputBuffer = make_unique<char[]>(block->decompressedSize);
+            block->outputBufferSize = block->decompressedSize;
+        }
+        block->result = m_threadPool.post([this, &block = *block](std::size_t) {
+            auto decompressingBuffer = DecompressingStreamBuffer::create(m_codec, block.data, block.size, block.decompressedSize);
+            const auto size = static_cast<std::streamsize>(block.decompressedSize);
+            if (decompressingBuffer->sgetn(block.outputBuffer.get(), size) != size) {
+                throw ParsingException("Decompressing failed. A block is smaller than announced.");
+            }
+            if (decompressingBuffer->sgetc() != traits_type::eof()) {
+                throw ParsingException("Decompressing failed. A block is bigger than announced.");
+            }
+        });
+        m_pendingBlocks.emplace_back(std::move(block));
+    }
+    if (m_pendingBlocks.empty()) {
+        return traits_type::eof();
+    }
+
+    // provide the oldest block once it has been decompressed
+    m_currentBlock = std::move(m_pendingBlocks.front());
+    m_pendingBlocks.pop_front();
+    m_currentBlock->result.get();
+    const auto output = m_currentBlock->outputBuffer.get();
+    setg(output, output, output + m_currentBlock->decompressedSize);
+    return traits_type::to_int_type(*gptr());
+}
+
+/*!
+ * \brief Reads \a size bytes from the source into \a buffer.
+ * \returns Returns whether the data could be read; returns false if the end of the source has been reached and
+ *          \a allowEnd is set.
+ * \throws Throws ParsingException if only parts of the data could be read or the end has been reached unexpectedly.
+ */
+bool ChunkedDecompressingStreamBuffer::read(char *buffer, std::size_t size, bool allowEnd)
+{
+    auto readSize = std::size_t();
+    if (m_source) {
+        readSize = static_cast<std::size_t>(std::max<std::streamsize>(m_source->sgetn(buffer, static_cast<std::streamsize>(size)), 0));
+    } else {
+        readSize = std::min(static_cast<std::size_t>(m_dataEnd - m_data), size);
+        std::memcpy(buffer, m_data, readSize);
+        m_data += readSize;
+    }
+    if (readSize == size) {
+        return true;
+    } else if (!readSize && allowEnd) {
+        return false;
+    }
+    throw ParsingException("Decompressing failed. The input data was incomplete.");
+}
+
+/*!
+ * \brief Reads the index entry and the compressed data of the next block into \a block.
+ * \returns Returns whether a block could be read; returns false if the end of the source has been reached.
+ * \remarks When reading from memory, the compressed data is not copied.
+ */
+bool ChunkedDecompressingStreamBuffer::readBlock(Block &block)
+{
+    char indexEntry[8];
+    if (!read(indexEntry, sizeof(indexEntry), true)) {
+        return false;
+    }
+    block.size = LE::toUInt32(indexEntry);
+    block.decompressedSize = LE::toUInt32(indexEntry + 4);
+    if (!block.size || !block.decompressedSize || block.decompressedSize > maxBlockSize || block.size > maxBlockSize * 2) {
+        throw ParsingException("Decompressing failed. The block index is corrupted.");
+    }
+    if (m_source) {
+        block.buffer.resize(block.size);
+        read(block.buffer.data(), block.size, false);
+        block.data = block.buffer.data();
+    } else if (static_cast<std::size_t>(m_dataEnd - m_data) >= block.size) {
+        block.data = m_data;
+        m_data += block.size;
+    } else {
+        throw ParsingException("Decompressing failed. The input data was incomplete.");
+    }
+    return true;
+}
+
+} // namespace Io
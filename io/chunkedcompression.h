@@ -0,0 +1,84 @@
+#ifndef PASSWORD_FILE_IO_CHUNKEDCOMPRESSION_H
+#define PASSWORD_FILE_IO_CHUNKEDCOMPRESSION_H
+
+#include "./compressingstreambuffer.h"
+
+#include "../util/concurrency.h"
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT ChunkedCompressingStreamBuffer : public CompressingStreamBuffer {
+public:
+    static constexpr std::size_t blockSize = 0x100000;
+
+    explicit ChunkedCompressingStreamBuffer(CompressionCodec codec, std::streambuf *sink, std::optional<int> level, std::size_t threadCount);
+
+protected:
+    void compress(const char *data, std::size_t size, bool finish) override;
+
+private:
+    struct Block {
+        std::string data;
+        std::string compressedData;
+        std::future<void> result;
+    };
+
+    void writeBlock();
+
+    CompressionCodec m_codec;
+    std::optional<int> m_level;
+    std::size_t m_maxPendingBlocks;
+    std::deque<std::unique_ptr<Block>> m_pendingBlocks;
+    std::vector<std::unique_ptr<Block>> m_idleBlocks;
+    Util::ThreadPool m_threadPool;
+};
+
+class PASSWORD_FILE_EXPORT ChunkedDecompressingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t maxBlockSize = 0x4000000;
+
+    explicit ChunkedDecompressingStreamBuffer(CompressionCodec codec, std::streambuf *source, std::uint64_t announcedSize, std::size_t threadCount);
+    explicit ChunkedDecompressingStreamBuffer(
+        CompressionCodec codec, const char *data, std::size_t size, std::uint64_t announcedSize, std::size_t threadCount);
+    ChunkedDecompressingStreamBuffer(const ChunkedDecompressingStreamBuffer &) = delete;
+    ~ChunkedDecompressingStreamBuffer() override;
+    ChunkedDecompressingStreamBuffer &operator=(const ChunkedDecompressingStreamBuffer &) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct Block {
+        const char *data = nullptr;
+        std::size_t size = 0;
+        std::size_t decompressedSize = 0;
+        std::string buffer;
+        std::unique_ptr<char[]> outputBuffer;
+        std::size_t outputBufferSize = 0;
+        std::future<void> result;
+    };
+
+    bool read(char *buffer, std::size_t size, bool allowEnd);
+    bool readBlock(Block &block);
+
+    CompressionCodec m_codec;
+    std::streambuf *m_source;
+    const char *m_data;
+    const char *m_dataEnd;
+    std::uint64_t m_remainingSize;
+    std::size_t m_maxPendingBlocks;
+    std::deque<std::unique_ptr<Block>> m_pendingBlocks;
+    std::vector<std::unique_ptr<Block>> m_idleBlocks;
+    std::unique_ptr<Block> m_currentBlock;
+    Util::ThreadPool m_threadPool;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_CHUNKEDCOMPRESSION_H
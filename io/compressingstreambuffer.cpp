@@ -0,0 +1,312 @@
+#include "./compressingstreambuffer.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <zlib.h>
+#ifdef PASSWORD_FILE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef PASSWORD_FILE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <ios>
+#include <stdexcept>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace Io {
+
+/// \brief The ZlibCompressingStreamBuffer class implements CompressingStreamBuffer for CompressionCodec::Zlib.
+class ZlibCompressingStreamBuffer final : public CompressingStreamBuffer {
+public:
+    explicit ZlibCompressingStreamBuffer(std::streambuf *sink, std::optional<int> level);
+    ~ZlibCompressingStreamBuffer() override;
+
+protected:
+    void compress(const char *data, std::size_t size, bool finish) override;
+
+private:
+    z_stream m_stream;
+    std::unique_ptr<char[]> m_outputBuffer;
+};
+
+ZlibCompressingStreamBuffer::ZlibCompressingStreamBuffer(std::streambuf *sink, std::optional<int> level)
+    : CompressingStreamBuffer(sink)
+    , m_stream()
+    , m_outputBuffer(make_unique<char[]>(bufferSize))
+{
+    if (deflateInit(&m_stream, level.value_or(Z_DEFAULT_COMPRESSION)) != Z_OK) {
+        throw runtime_error("Compressing failed. Unable to initialize zlib.");
+    }
+}
+
+ZlibCompressingStreamBuffer::~ZlibCompressingStreamBuffer()
+{
+    deflateEnd(&m_stream);
+}
+
+void ZlibCompressingStreamBuffer::compress(const char *data, std::size_t size, bool finish)
+{
+    const auto flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream.avail_in = static_cast<uInt>(size);
+    for (;;) {
+        m_stream.next_out = reinterpret_cast<Bytef *>(m_outputBuffer.get());
+        m_stream.avail_out = static_cast<uInt>(bufferSize);
+        const auto result = deflate(&m_stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            throw runtime_error("Compressing failed. The zlib stream is inconsistent.");
+        }
+        writeToSink(m_outputBuffer.get(), bufferSize - m_stream.avail_out);
+        if (finish ? result == Z_STREAM_END : m_stream.avail_out != 0) {
+            break;
+        }
+    }
+}
+
+#ifdef PASSWORD_FILE_ZSTD
+/// \brief The ZstdCompressingStreamBuffer class implements CompressingStreamBuffer for CompressionCodec::Zstd.
+class ZstdCompressingStreamBuffer final : public CompressingStreamBuffer {
+public:
+    explicit ZstdCompressingStreamBuffer(std::streambuf *sink, std::optional<int> level);
+    ~ZstdCompressingStreamBuffer() override;
+
+protected:
+    void compress(const char *data, std::size_t size, bool finish) override;
+
+private:
+    ZSTD_CCtx *m_context;
+    std::unique_ptr<char[]> m_outputBuffer;
+};
+
+ZstdCompressingStreamBuffer::ZstdCompressingStreamBuffer(std::streambuf *sink, std::optional<int> level)
+    : CompressingStreamBuffer(sink)
+    , m_context(ZSTD_createCCtx())
+    , m_outputBuffer(make_unique<char[]>(bufferSize))
+{
+    if (!m_context) {
+        throw runtime_error("Compressing failed. Unable to initialize zstd.");
+    }
+    if (level) {
+        if (const auto result = ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, *level); ZSTD_isError(result)) {
+            ZSTD_freeCCtx(m_context);
+            throw runtime_error(argsToString("Compressing failed. Unable to set zstd compression level: ", ZSTD_getErrorName(result)));
+        }
+    }
+}
+
+ZstdCompressingStreamBuffer::~ZstdCompressingStreamBuffer()
+{
+    ZSTD_freeCCtx(m_context);
+}
+
+void ZstdCompressingStreamBuffer::compress(const char *data, std::size_t size, bool finish)
+{
+    auto input = ZSTD_inBuffer{ data, size, 0 };
+    for (;;) {
+        auto output = ZSTD_outBuffer{ m_outputBuffer.get(), bufferSize, 0 };
+        const auto remaining = ZSTD_compressStream2(m_context, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining)) {
+            throw runtime_error(argsToString("Compressing failed. zstd error: ", ZSTD_getErrorName(remaining)));
+        }
+        writeToSink(m_outputBuffer.get(), output.pos);
+        if (finish ? remaining == 0 : input.pos == input.size) {
+            break;
+        }
+    }
+}
+#endif
+
+#ifdef PASSWORD_FILE_LZ4
+/// \brief The Lz4CompressingStreamBuffer class implements CompressingStreamBuffer for CompressionCodec::Lz4.
+class Lz4CompressingStreamBuffer final : public CompressingStreamBuffer {
+public:
+    explicit Lz4CompressingStreamBuffer(std::streambuf *sink, std::optional<int> level);
+    ~Lz4CompressingStreamBuffer() override;
+
+protected:
+    void compress(const char *data, std::size_t size, bool finish) override;
+
+private:
+    void checkResult(std::size_t result);
+
+    LZ4F_cctx *m_context;
+    LZ4F_preferences_t m_preferences;
+    std::size_t m_outputBufferSize;
+    std::unique_ptr<char[]> m_outputBuffer;
+    bool m_begun;
+};
+
+Lz4CompressingStreamBuffer::Lz4CompressingStreamBuffer(std::streambuf *sink, std::optional<int> level)
+    : CompressingStreamBuffer(sink)
+    , m_context(nullptr)
+    , m_preferences()
+    , m_begun(false)
+{
+    m_preferences.compressionLevel = level.value_or(0);
+    // note: The output buffer must be able to hold the compressed data of a whole input buffer in the worst case.
+    m_outputBufferSize = LZ4F_compressBound(bufferSize, &m_preferences);
+    m_outputBuffer = make_unique<char[]>(m_outputBufferSize);
+    if (LZ4F_isError(LZ4F_createCompressionContext(&m_context, LZ4F_VERSION))) {
+        throw runtime_error("Compressing failed. Unable to initialize lz4.");
+    }
+}
+
+Lz4CompressingStreamBuffer::~Lz4CompressingStreamBuffer()
+{
+    LZ4F_freeCompressionContext(m_context);
+}
+
+void Lz4CompressingStreamBuffer::checkResult(std::size_t result)
+{
+    if (LZ4F_isError(result)) {
+        throw runtime_error(argsToString("Compressing failed. lz4 error: ", LZ4F_getErrorName(result)));
+    }
+}
+
+void Lz4CompressingStreamBuffer::compress(const char *data, std::size_t size, bool finish)
+{
+    if (!m_begun) {
+        const auto headerSize = LZ4F_compressBegin(m_context, m_outputBuffer.get(), m_outputBufferSize, &m_preferences);
+        checkResult(headerSize);
+        writeToSink(m_outputBuffer.get(), headerSize);
+        m_begun = true;
+    }
+    if (size) {
+        const auto outputSize = LZ4F_compressUpdate(m_context, m_outputBuffer.get(), m_outputBufferSize, data, size, nullptr);
+        checkResult(outputSize);
+        writeToSink(m_outputBuffer.get(), outputSize);
+    }
+    if (finish) {
+        const auto outputSize = LZ4F_compressEnd(m_context, m_outputBuffer.get(), m_outputBufferSize, nullptr);
+        checkResult(outputSize);
+        writeToSink(m_outputBuffer.get(), outputSize);
+    }
+}
+#endif
+
+/*!
+ * \class CompressingStreamBuffer
+ * \brief The CompressingStreamBuffer class provides a write-only stream buffer which compresses the data written to it
+ *        and writes the compressed data to another stream buffer.
+ *
+ * Use create() to instantiate the buffer for a certain CompressionCodec. The data is buffered and compressed in chunks of
+ * bufferSize bytes so only a fixed window of the data is held in memory at a time. Call finish() after writing all data
+ * to complete the compressed stream.
+ *
+ * \remarks Compression errors are reported by throwing an std::runtime_error and errors when writing to the sink by
+ *          throwing an std::ios_base::failure. When the buffer is used via an std::ostream, enable exceptions for
+ *          std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Returns a new buffer compressing the data with the specified \a codec and writing it to \a sink.
+ * \param level Specifies the compression level. The meaning depends on the codec (zlib: 0 to 9, zstd: 1 to 22 and
+ *              negative values for faster modes, lz4: 0 for the fast mode and 3 to 12 for the high compression mode).
+ *              The codec's default is used if not specified.
+ * \throws Throws std::runtime_error when the codec is not supported or the compression can not be initialized.
+ */
+std::unique_ptr<CompressingStreamBuffer> CompressingStreamBuffer::create(CompressionCodec codec, std::streambuf *sink, std::optional<int> level)
+{
+    switch (codec) {
+    case CompressionCodec::Zlib:
+        return make_unique<ZlibCompressingStreamBuffer>(sink, level);
+#ifdef PASSWORD_FILE_ZSTD
+    case CompressionCodec::Zstd:
+        return make_unique<ZstdCompressingStreamBuffer>(sink, level);
+#endif
+#ifdef PASSWORD_FILE_LZ4
+    case CompressionCodec::Lz4:
+        return make_unique<Lz4CompressingStreamBuffer>(sink, level);
+#endif
+    default:
+        throw runtime_error(argsToString("Compressing failed. The codec \"", compressionCodecName(codec), "\" is not supported."));
+    }
+}
+
+/*!
+ * \brief Constructs a new buffer writing the compressed data to \a sink.
+ * \param inputBufferSize Specifies the number of bytes to buffer before compress() is invoked.
+ */
+CompressingStreamBuffer::CompressingStreamBuffer(std::streambuf *sink, std::size_t inputBufferSize)
+    : m_sink(sink)
+    , m_inputBuffer(make_unique<char[]>(inputBufferSize))
+    , m_inputBufferSize(inputBufferSize)
+    , m_uncompressedSize(0)
+    , m_finished(false)
+{
+    setp(m_inputBuffer.get(), m_inputBuffer.get() + m_inputBufferSize);
+}
+
+/*!
+ * \brief Destroys the buffer.
+ * \remarks Buffered data which has not been compressed yet is discarded; call finish() before.
+ */
+CompressingStreamBuffer::~CompressingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Compresses the buffered data, completes the compressed stream and writes it to the sink.
+ * \remarks No further data can be written afterwards.
+ * \throws Throws std::runtime_error when a compression error occurs.
+ * \throws Throws std::ios_base::failure when the compressed data can not be written to the sink.
+ */
+void CompressingStreamBuffer::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    compressBuffer(true);
+    m_finished = true;
+    setp(nullptr, nullptr);
+}
+
+/*!
+ * \brief Compresses the buffered data to make room for \a c.
+ */
+CompressingStreamBuffer::int_type CompressingStreamBuffer::overflow(int_type c)
+{
+    if (m_finished) {
+        return traits_type::eof();
+    }
+    compressBuffer(false);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+/*!
+ * \fn CompressingStreamBuffer::compress()
+ * \brief Compresses the specified \a data and writes the compressed data via writeToSink().
+ * \param finish Specifies whether this is the last chunk of data so the compressed stream needs to be completed.
+ * \remarks The \a size never exceeds the input buffer size passed to the constructor.
+ */
+
+/*!
+ * \brief Writes the specified compressed \a data to the sink.
+ * \throws Throws std::ios_base::failure when the data can not be written.
+ */
+void CompressingStreamBuffer::writeToSink(const char *data, std::size_t size)
+{
+    if (size && m_sink->sputn(data, static_cast<std::streamsize>(size)) != static_cast<std::streamsize>(size)) {
+        throw std::ios_base::failure("Unable to write compressed data.");
+    }
+}
+
+/*!
+ * \brief Compresses the buffered data and resets the buffer.
+ */
+void CompressingStreamBuffer::compressBuffer(bool finish)
+{
+    const auto size = static_cast<std::size_t>(pptr() - pbase());
+    compress(pbase(), size, finish);
+    m_uncompressedSize += size;
+    setp(m_inputBuffer.get(), m_inputBuffer.get() + m_inputBufferSize);
+}
+
+} // namespace Io
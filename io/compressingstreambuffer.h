@@ -0,0 +1,53 @@
+#ifndef PASSWORD_FILE_IO_COMPRESSINGSTREAMBUFFER_H
+#define PASSWORD_FILE_IO_COMPRESSINGSTREAMBUFFER_H
+
+#include "./compressioncodec.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <streambuf>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT CompressingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t bufferSize = 0x10000;
+
+    static std::unique_ptr<CompressingStreamBuffer> create(
+        CompressionCodec codec, std::streambuf *sink, std::optional<int> level = std::optional<int>());
+    CompressingStreamBuffer(const CompressingStreamBuffer &) = delete;
+    ~CompressingStreamBuffer() override;
+    CompressingStreamBuffer &operator=(const CompressingStreamBuffer &) = delete;
+
+    void finish();
+    std::uint64_t uncompressedSize() const;
+
+protected:
+    explicit CompressingStreamBuffer(std::streambuf *sink, std::size_t inputBufferSize = bufferSize);
+    int_type overflow(int_type c) override;
+    virtual void compress(const char *data, std::size_t size, bool finish) = 0;
+    void writeToSink(const char *data, std::size_t size);
+
+private:
+    void compressBuffer(bool finish);
+
+    std::streambuf *m_sink;
+    std::unique_ptr<char[]> m_inputBuffer;
+    std::size_t m_inputBufferSize;
+    std::uint64_t m_uncompressedSize;
+    bool m_finished;
+};
+
+/*!
+ * \brief Returns the number of bytes passed to compress() so far.
+ * \remarks Buffered data is only taken into account once finish() has been called.
+ */
+inline std::uint64_t CompressingStreamBuffer::uncompressedSize() const
+{
+    return m_uncompressedSize;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_COMPRESSINGSTREAMBUFFER_H
@@ -0,0 +1,46 @@
+#include "./compressioncodec.h"
+
+namespace Io {
+
+/*!
+ * \brief Returns the name of the specified \a codec.
+ */
+const char *compressionCodecName(CompressionCodec codec)
+{
+    switch (codec) {
+    case CompressionCodec::Zlib:
+        return "zlib";
+    case CompressionCodec::Zstd:
+        return "zstd";
+    case CompressionCodec::Lz4:
+        return "lz4";
+    }
+    return "unknown";
+}
+
+/*!
+ * \brief Returns whether the specified \a codec is supported by this build of the library.
+ * \remarks zlib is always supported; zstd and lz4 are optional dependencies.
+ */
+bool isCompressionCodecSupported(CompressionCodec codec)
+{
+    switch (codec) {
+    case CompressionCodec::Zlib:
+        return true;
+    case CompressionCodec::Zstd:
+#ifdef PASSWORD_FILE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    case CompressionCodec::Lz4:
+#ifdef PASSWORD_FILE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+} // namespace Io
@@ -0,0 +1,25 @@
+#ifndef PASSWORD_FILE_IO_COMPRESSIONCODEC_H
+#define PASSWORD_FILE_IO_COMPRESSIONCODEC_H
+
+#include "../global.h"
+
+#include <cstdint>
+
+namespace Io {
+
+/*!
+ * \brief The CompressionCodec enum specifies the algorithm used to compress the contents of a file.
+ * \remarks The values are stored in the file header (as of version 9) so they must not be changed.
+ */
+enum class CompressionCodec : std::uint8_t {
+    Zlib = 0, /**< zlib (the only codec supported before version 9) */
+    Zstd = 1, /**< Zstandard (fast decompression, level can be set from 1 to 22) */
+    Lz4 = 2, /**< LZ4 frame format (very fast compression and decompression at the cost of a lower ratio) */
+};
+
+PASSWORD_FILE_EXPORT const char *compressionCodecName(CompressionCodec codec);
+PASSWORD_FILE_EXPORT bool isCompressionCodecSupported(CompressionCodec codec);
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_COMPRESSIONCODEC_H
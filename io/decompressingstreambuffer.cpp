@@ -0,0 +1,304 @@
+#include "./decompressingstreambuffer.h"
+#include "./parsingexception.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <zlib.h>
+#ifdef PASSWORD_FILE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef PASSWORD_FILE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <algorithm>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace Io {
+
+/// \brief The ZlibDecompressingStreamBuffer class implements DecompressingStreamBuffer for CompressionCodec::Zlib.
+class ZlibDecompressingStreamBuffer final : public DecompressingStreamBuffer {
+public:
+    explicit ZlibDecompressingStreamBuffer(std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize);
+    ~ZlibDecompressingStreamBuffer() override;
+
+protected:
+    bool decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize) override;
+
+private:
+    z_stream m_stream;
+};
+
+ZlibDecompressingStreamBuffer::ZlibDecompressingStreamBuffer(
+    std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize)
+    : DecompressingStreamBuffer(source, data, size, announcedSize)
+    , m_stream()
+{
+    if (inflateInit(&m_stream) != Z_OK) {
+        throw ParsingException("Decompressing failed. Unable to initialize zlib.");
+    }
+}
+
+ZlibDecompressingStreamBuffer::~ZlibDecompressingStreamBuffer()
+{
+    inflateEnd(&m_stream);
+}
+
+bool ZlibDecompressingStreamBuffer::decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize)
+{
+    m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input));
+    m_stream.avail_in = static_cast<uInt>(inputSize);
+    m_stream.next_out = reinterpret_cast<Bytef *>(output);
+    m_stream.avail_out = static_cast<uInt>(outputSize);
+    auto finished = false;
+    switch (inflate(&m_stream, Z_NO_FLUSH)) {
+    case Z_OK:
+    case Z_BUF_ERROR:
+        break;
+    case Z_STREAM_END:
+        finished = true;
+        break;
+    case Z_MEM_ERROR:
+        throw ParsingException("Decompressing failed. Not enough memory available.");
+    default:
+        throw ParsingException("Decompressing failed. The input data was corrupted.");
+    }
+    input = reinterpret_cast<const char *>(m_stream.next_in);
+    inputSize = m_stream.avail_in;
+    outputSize -= m_stream.avail_out;
+    return finished;
+}
+
+#ifdef PASSWORD_FILE_ZSTD
+/// \brief The ZstdDecompressingStreamBuffer class implements DecompressingStreamBuffer for CompressionCodec::Zstd.
+class ZstdDecompressingStreamBuffer final : public DecompressingStreamBuffer {
+public:
+    explicit ZstdDecompressingStreamBuffer(std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize);
+    ~ZstdDecompressingStreamBuffer() override;
+
+protected:
+    bool decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize) override;
+
+private:
+    ZSTD_DCtx *m_context;
+};
+
+ZstdDecompressingStreamBuffer::ZstdDecompressingStreamBuffer(
+    std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize)
+    : DecompressingStreamBuffer(source, data, size, announcedSize)
+    , m_context(ZSTD_createDCtx())
+{
+    if (!m_context) {
+        throw ParsingException("Decompressing failed. Unable to initialize zstd.");
+    }
+}
+
+ZstdDecompressingStreamBuffer::~ZstdDecompressingStreamBuffer()
+{
+    ZSTD_freeDCtx(m_context);
+}
+
+bool ZstdDecompressingStreamBuffer::decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize)
+{
+    auto inputBuffer = ZSTD_inBuffer{ input, inputSize, 0 };
+    auto outputBuffer = ZSTD_outBuffer{ output, outputSize, 0 };
+    const auto result = ZSTD_decompressStream(m_context, &outputBuffer, &inputBuffer);
+    if (ZSTD_isError(result)) {
+        throw ParsingException(argsToString("Decompressing failed. The input data was corrupted: ", ZSTD_getErrorName(result)));
+    }
+    input += inputBuffer.pos;
+    inputSize -= inputBuffer.pos;
+    outputSize = outputBuffer.pos;
+    return result == 0;
+}
+#endif
+
+#ifdef PASSWORD_FILE_LZ4
+/// \brief The Lz4DecompressingStreamBuffer class implements DecompressingStreamBuffer for CompressionCodec::Lz4.
+class Lz4DecompressingStreamBuffer final : public DecompressingStreamBuffer {
+public:
+    explicit Lz4DecompressingStreamBuffer(std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize);
+    ~Lz4DecompressingStreamBuffer() override;
+
+protected:
+    bool decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize) override;
+
+private:
+    LZ4F_dctx *m_context;
+};
+
+Lz4DecompressingStreamBuffer::Lz4DecompressingStreamBuffer(
+    std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize)
+    : DecompressingStreamBuffer(source, data, size, announcedSize)
+    , m_context(nullptr)
+{
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&m_context, LZ4F_VERSION))) {
+        throw ParsingException("Decompressing failed. Unable to initialize lz4.");
+    }
+}
+
+Lz4DecompressingStreamBuffer::~Lz4DecompressingStreamBuffer()
+{
+    LZ4F_freeDecompressionContext(m_context);
+}
+
+bool Lz4DecompressingStreamBuffer::decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize)
+{
+    auto consumedSize = inputSize;
+    const auto result = LZ4F_decompress(m_context, output, &outputSize, input, &consumedSize, nullptr);
+    if (LZ4F_isError(result)) {
+        throw ParsingException(argsToString("Decompressing failed. The input data was corrupted: ", LZ4F_getErrorName(result)));
+    }
+    input += consumedSize;
+    inputSize -= consumedSize;
+    return result == 0;
+}
+#endif
+
+/*!
+ * \class DecompressingStreamBuffer
+ * \brief The DecompressingStreamBuffer class provides a read-only stream buffer which decompresses data read from
+ *        another stream buffer or from memory.
+ *
+ * Use create() to instantiate the buffer for a certain CompressionCodec. The compressed data is read and decompressed
+ * in chunks of bufferSize bytes so only a fixed window of the data is held in memory at a time.
+ *
+ * \remarks Decompression errors are reported by throwing a ParsingException. When the buffer is used via an std::istream,
+ *          enable exceptions for std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Returns a new buffer decompressing the data read from \a source with the specified \a codec.
+ * \param announcedSize Specifies the size of the decompressed data as stored in the file. It is not possible to read
+ *                      more data than that.
+ * \throws Throws ParsingException when the codec is not supported or the decompression can not be initialized.
+ */
+std::unique_ptr<DecompressingStreamBuffer> DecompressingStreamBuffer::create(
+    CompressionCodec codec, std::streambuf *source, std::uint64_t announcedSize)
+{
+    switch (codec) {
+    case CompressionCodec::Zlib:
+        return make_unique<ZlibDecompressingStreamBuffer>(source, nullptr, 0, announcedSize);
+#ifdef PASSWORD_FILE_ZSTD
+    case CompressionCodec::Zstd:
+        return make_unique<ZstdDecompressingStreamBuffer>(source, nullptr, 0, announcedSize);
+#endif
+#ifdef PASSWORD_FILE_LZ4
+    case CompressionCodec::Lz4:
+        return make_unique<Lz4DecompressingStreamBuffer>(source, nullptr, 0, announcedSize);
+#endif
+    default:
+        throw ParsingException(argsToString("Decompressing failed. The codec \"", compressionCodecName(codec), "\" is not supported."));
+    }
+}
+
+/*!
+ * \brief Returns a new buffer decompressing the specified \a data with the specified \a codec.
+ * \param announcedSize Specifies the size of the decompressed data as stored in the file. It is not possible to read
+ *                      more data than that.
+ * \remarks The \a data is passed to the codec directly without copying it first so it must outlive the buffer.
+ * \throws Throws ParsingException when the codec is not supported or the decompression can not be initialized.
+ */
+std::unique_ptr<DecompressingStreamBuffer> DecompressingStreamBuffer::create(
+    CompressionCodec codec, const char *data, std::size_t size, std::uint64_t announcedSize)
+{
+    switch (codec) {
+    case CompressionCodec::Zlib:
+        return make_unique<ZlibDecompressingStreamBuffer>(nullptr, data, size, announcedSize);
+#ifdef PASSWORD_FILE_ZSTD
+    case CompressionCodec::Zstd:
+        return make_unique<ZstdDecompressingStreamBuffer>(nullptr, data, size, announcedSize);
+#endif
+#ifdef PASSWORD_FILE_LZ4
+    case CompressionCodec::Lz4:
+        return make_unique<Lz4DecompressingStreamBuffer>(nullptr, data, size, announcedSize);
+#endif
+    default:
+        throw ParsingException(argsToString("Decompressing failed. The codec \"", compressionCodecName(codec), "\" is not supported."));
+    }
+}
+
+/*!
+ * \brief Constructs a new buffer reading the compressed data from \a source or (if \a source is nullptr) from the
+ *        specified \a data.
+ */
+DecompressingStreamBuffer::DecompressingStreamBuffer(std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize)
+    : m_source(source)
+    , m_data(data)
+    , m_dataEnd(data + size)
+    , m_inputBuffer(source ? make_unique<char[]>(bufferSize) : nullptr)
+    , m_outputBuffer(make_unique<char[]>(bufferSize))
+    , m_input(nullptr)
+    , m_inputSize(0)
+    , m_remainingSize(announcedSize)
+    , m_sourceExhausted(false)
+    , m_finished(false)
+{
+}
+
+/*!
+ * \brief Destroys the buffer.
+ */
+DecompressingStreamBuffer::~DecompressingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Decompresses the next chunk of the source.
+ * \throws Throws ParsingException when a decompression error occurs.
+ */
+DecompressingStreamBuffer::int_type DecompressingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    auto outputSize = std::size_t();
+    while (!outputSize && !m_finished) {
+        if (!m_inputSize && !m_sourceExhausted) {
+            auto inputSize = std::streamsize();
+            if (m_source) {
+                m_input = m_inputBuffer.get();
+                inputSize = m_source->sgetn(m_inputBuffer.get(), static_cast<std::streamsize>(bufferSize));
+            } else {
+                m_input = m_data;
+                inputSize = std::min<std::streamsize>(m_dataEnd - m_data, static_cast<std::streamsize>(bufferSize));
+                m_data += inputSize;
+            }
+            if (inputSize > 0) {
+                m_inputSize = static_cast<std::size_t>(inputSize);
+            } else {
+                m_sourceExhausted = true;
+            }
+        }
+        // note: The codec is invoked once more without input after the source has been exhausted to flush data it
+        //       might still hold internally.
+        outputSize = bufferSize;
+        m_finished = decompress(m_input, m_inputSize, m_outputBuffer.get(), outputSize);
+        if (!outputSize && !m_finished && m_sourceExhausted) {
+            throw ParsingException("Decompressing failed. The input data was incomplete.");
+        }
+    }
+    if (outputSize > m_remainingSize) {
+        throw ParsingException("Decompressing failed. The decompressed data exceeds the announced size.");
+    }
+    m_remainingSize -= outputSize;
+    if (!outputSize) {
+        return traits_type::eof();
+    }
+    setg(m_outputBuffer.get(), m_outputBuffer.get(), m_outputBuffer.get() + outputSize);
+    return traits_type::to_int_type(*gptr());
+}
+
+/*!
+ * \fn DecompressingStreamBuffer::decompress()
+ * \brief Decompresses data from \a input into \a output.
+ * \param input Specifies the compressed data; advanced by the number of consumed bytes.
+ * \param inputSize Specifies the size of \a input; decreased by the number of consumed bytes. Might be zero to flush
+ *                  data the codec holds internally.
+ * \param outputSize Specifies the capacity of \a output; set to the number of produced bytes.
+ * \returns Returns whether the end of the compressed stream has been reached.
+ */
+
+} // namespace Io
@@ -0,0 +1,43 @@
+#ifndef PASSWORD_FILE_IO_DECOMPRESSINGSTREAMBUFFER_H
+#define PASSWORD_FILE_IO_DECOMPRESSINGSTREAMBUFFER_H
+
+#include "./compressioncodec.h"
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT DecompressingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t bufferSize = 0x10000;
+
+    static std::unique_ptr<DecompressingStreamBuffer> create(CompressionCodec codec, std::streambuf *source, std::uint64_t announcedSize);
+    static std::unique_ptr<DecompressingStreamBuffer> create(
+        CompressionCodec codec, const char *data, std::size_t size, std::uint64_t announcedSize);
+    DecompressingStreamBuffer(const DecompressingStreamBuffer &) = delete;
+    ~DecompressingStreamBuffer() override;
+    DecompressingStreamBuffer &operator=(const DecompressingStreamBuffer &) = delete;
+
+protected:
+    explicit DecompressingStreamBuffer(std::streambuf *source, const char *data, std::size_t size, std::uint64_t announcedSize);
+    int_type underflow() override;
+    virtual bool decompress(const char *&input, std::size_t &inputSize, char *output, std::size_t &outputSize) = 0;
+
+private:
+    std::streambuf *m_source;
+    const char *m_data;
+    const char *m_dataEnd;
+    std::unique_ptr<char[]> m_inputBuffer;
+    std::unique_ptr<char[]> m_outputBuffer;
+    const char *m_input;
+    std::size_t m_inputSize;
+    std::uint64_t m_remainingSize;
+    bool m_sourceExhausted;
+    bool m_finished;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_DECOMPRESSINGSTREAMBUFFER_H
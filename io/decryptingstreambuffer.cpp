@@ -0,0 +1,173 @@
+#include "./decryptingstreambuffer.h"
+#include "./cryptoexception.h"
+
+#include "../util/openssl.h"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class DecryptingStreamBuffer
+ * \brief The DecryptingStreamBuffer class provides a read-only stream buffer which decrypts data encrypted with the
+ *        specified EncryptionCipher read from another stream buffer or from memory.
+ *
+ * The encrypted data is read in chunks of bufferSize bytes so only a fixed window of the data is held in memory at
+ * a time. The source is read until its end and the padding is checked when reaching it. When using an authenticated
+ * cipher, the last authenticationTagSize bytes of the source are taken as authentication tag and checked when reaching
+ * the end instead.
+ *
+ * \remarks
+ * - Decryption errors are reported by throwing a CryptoException. When the buffer is used via an std::istream,
+ *   enable exceptions for std::ios_base::badbit so the exception is propagated.
+ * - The data is returned before it has been authenticated. So when using an authenticated cipher, the data can only be
+ *   trusted once the end has been reached without an exception.
+ */
+
+/*!
+ * \brief Constructs a new buffer reading the encrypted data from \a source using the specified \a key and \a iv.
+ * \remarks The \a key must be 32 bytes long and the \a iv as long as encryptionCipherIvSize() returns for the
+ *          \a cipher. Both are copied.
+ * \throws Throws CryptoException when the decryption can not be initialized.
+ */
+DecryptingStreamBuffer::DecryptingStreamBuffer(std::streambuf *source, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher)
+    : m_source(source)
+    , m_data(nullptr)
+    , m_dataEnd(nullptr)
+    , m_inputBuffer(make_unique<char[]>(bufferSize + authenticationTagSize))
+    , m_outputBuffer(make_unique<char[]>(bufferSize + EVP_MAX_BLOCK_LENGTH))
+    , m_heldBackSize(0)
+    , m_authenticated(isAuthenticatedCipher(cipher))
+    , m_finished(false)
+{
+    init(key, iv, cipher);
+}
+
+/*!
+ * \brief Constructs a new buffer decrypting the specified \a data using the specified \a key and \a iv.
+ * \remarks
+ * - The \a data is passed to OpenSSL directly without copying it first so it must outlive the buffer.
+ * - The \a key must be 32 bytes long and the \a iv as long as encryptionCipherIvSize() returns for the \a cipher.
+ *   Both are copied.
+ * \throws Throws CryptoException when the decryption can not be initialized.
+ */
+DecryptingStreamBuffer::DecryptingStreamBuffer(
+    const char *data, std::size_t size, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher)
+    : m_source(nullptr)
+    , m_data(data)
+    , m_dataEnd(data + size)
+    , m_outputBuffer(make_unique<char[]>(bufferSize + EVP_MAX_BLOCK_LENGTH))
+    , m_heldBackSize(0)
+    , m_authenticated(isAuthenticatedCipher(cipher))
+    , m_finished(false)
+{
+    init(key, iv, cipher);
+}
+
+/*!
+ * \brief Destroys the buffer.
+ */
+DecryptingStreamBuffer::~DecryptingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Initializes the cipher context.
+ */
+void DecryptingStreamBuffer::init(const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher)
+{
+    if (EVP_DecryptInit_ex(m_context.get(), evpCipher(cipher), nullptr, key, iv) != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    if (m_authenticated && !m_source) {
+        if (static_cast<std::size_t>(m_dataEnd - m_data) < authenticationTagSize) {
+            throw CryptoException("The authentication tag is truncated.");
+        }
+        m_dataEnd -= authenticationTagSize; // the tag is located after the encrypted data
+    }
+}
+
+/*!
+ * \brief Decrypts the last block and checks the padding or (when using an authenticated cipher) the specified \a tag.
+ */
+void DecryptingStreamBuffer::finish(const char *tag)
+{
+    if (m_authenticated
+        && EVP_CIPHER_CTX_ctrl(m_context.get(), EVP_CTRL_AEAD_SET_TAG, static_cast<int>(authenticationTagSize), const_cast<char *>(tag)) != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    auto outputSize = 0;
+    if (EVP_DecryptFinal_ex(m_context.get(), reinterpret_cast<unsigned char *>(m_outputBuffer.get()), &outputSize) != 1) {
+        if (m_authenticated) {
+            throw CryptoException("Unable to authenticate the encrypted data. The password is wrong or the data has been modified.");
+        }
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    m_finished = true;
+    if (outputSize) {
+        setg(m_outputBuffer.get(), m_outputBuffer.get(), m_outputBuffer.get() + outputSize);
+    }
+}
+
+/*!
+ * \brief Decrypts the next chunk of the source.
+ * \throws Throws CryptoException when a decryption error occurs, e.g. because the padding is invalid or the data can
+ *         not be authenticated.
+ */
+DecryptingStreamBuffer::int_type DecryptingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    auto *const output = reinterpret_cast<unsigned char *>(m_outputBuffer.get());
+    auto outputSize = 0;
+    while (!outputSize && !m_finished) {
+        const char *input;
+        auto inputSize = std::size_t();
+        if (m_source) {
+            // read after the data held back from the previous chunk
+            // note: When authenticating, the last bytes read are held back as they might be the tag.
+            input = m_inputBuffer.get();
+            const auto readSize = m_source->sgetn(m_inputBuffer.get() + m_heldBackSize, static_cast<std::streamsize>(bufferSize));
+            if (readSize <= 0) {
+                if (m_heldBackSize != (m_authenticated ? authenticationTagSize : 0)) {
+                    throw CryptoException("The authentication tag is truncated.");
+                }
+                finish(m_inputBuffer.get());
+                return gptr() < egptr() ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+            }
+            const auto availableSize = m_heldBackSize + static_cast<std::size_t>(readSize);
+            m_heldBackSize = m_authenticated ? std::min(availableSize, authenticationTagSize) : 0;
+            inputSize = availableSize - m_heldBackSize;
+        } else {
+            input = m_data;
+            inputSize = std::min(static_cast<std::size_t>(m_dataEnd - m_data), bufferSize);
+            m_data += inputSize;
+            if (!inputSize) {
+                finish(m_dataEnd);
+                return gptr() < egptr() ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+            }
+        }
+        if (inputSize
+            && EVP_DecryptUpdate(
+                   m_context.get(), output, &outputSize, reinterpret_cast<const unsigned char *>(input), static_cast<int>(inputSize))
+                != 1) {
+            throw CryptoException(Util::OpenSsl::errorMessages());
+        }
+        if (m_heldBackSize) {
+            std::memmove(m_inputBuffer.get(), input + inputSize, m_heldBackSize);
+        }
+    }
+    if (!outputSize) {
+        return traits_type::eof();
+    }
+    setg(m_outputBuffer.get(), m_outputBuffer.get(), m_outputBuffer.get() + outputSize);
+    return traits_type::to_int_type(*gptr());
+}
+
+} // namespace Io
@@ -0,0 +1,45 @@
+#ifndef PASSWORD_FILE_IO_DECRYPTINGSTREAMBUFFER_H
+#define PASSWORD_FILE_IO_DECRYPTINGSTREAMBUFFER_H
+
+#include "./encryptioncipher.h"
+
+#include "../util/openssl.h"
+
+#include <memory>
+#include <streambuf>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT DecryptingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t bufferSize = 0x10000;
+
+    explicit DecryptingStreamBuffer(
+        std::streambuf *source, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher = EncryptionCipher::Aes256Cbc);
+    explicit DecryptingStreamBuffer(const char *data, std::size_t size, const unsigned char *key, const unsigned char *iv,
+        EncryptionCipher cipher = EncryptionCipher::Aes256Cbc);
+    DecryptingStreamBuffer(const DecryptingStreamBuffer &) = delete;
+    ~DecryptingStreamBuffer() override;
+    DecryptingStreamBuffer &operator=(const DecryptingStreamBuffer &) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    void init(const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher);
+    void finish(const char *tag);
+
+    std::streambuf *m_source;
+    const char *m_data;
+    const char *m_dataEnd;
+    Util::OpenSsl::CipherContext m_context;
+    std::unique_ptr<char[]> m_inputBuffer;
+    std::unique_ptr<char[]> m_outputBuffer;
+    std::size_t m_heldBackSize;
+    bool m_authenticated;
+    bool m_finished;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_DECRYPTINGSTREAMBUFFER_H
@@ -0,0 +1,204 @@
+#include "./derivedkeycache.h"
+
+#ifdef PLATFORM_UNIX
+#include <sys/mman.h>
+#endif
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+namespace Io {
+
+/// \brief The Slot struct holds a cached key and the parameters it has been derived with.
+struct DerivedKeyCache::Slot {
+    KeyDerivationParameters parameters;
+    unsigned char key[keySize];
+};
+
+/*!
+ * \brief Returns the parameters for hashing the password \a hashCount times (as done before version 13).
+ */
+static KeyDerivationParameters hashCountParameters(std::uint32_t hashCount)
+{
+    auto parameters = KeyDerivationParameters();
+    parameters.iterations = hashCount;
+    return parameters;
+}
+
+/// \brief The size of the memory holding the slots (one page).
+constexpr std::size_t storageSize = 0x1000;
+
+/*!
+ * \class DerivedKeyCache
+ * \brief The DerivedKeyCache class caches keys derived from a password so deriving them again can be skipped.
+ *
+ * The keys are identified by the parameters they have been derived with. The password itself is not part of the
+ * identification so the cache must be cleared whenever the password changes (PasswordFile takes care of that).
+ *
+ * The keys are kept in memory which is allocated separately and locked if possible so they are not swapped to disk
+ * (and excluded from core dumps where supported). The memory is zeroized when keys are evicted or the cache is cleared
+ * or destroyed. At most maxEntries keys are cached; the least recently used key is evicted first.
+ */
+
+/*!
+ * \brief Constructs an empty cache. Memory for keys is only allocated when the first key is inserted.
+ */
+DerivedKeyCache::DerivedKeyCache()
+    : m_slots(nullptr)
+    , m_size(0)
+    , m_locked(false)
+{
+}
+
+/*!
+ * \brief Moves the keys of \a other into a new cache.
+ */
+DerivedKeyCache::DerivedKeyCache(DerivedKeyCache &&other)
+    : m_slots(other.m_slots)
+    , m_size(other.m_size)
+    , m_locked(other.m_locked)
+{
+    other.m_slots = nullptr;
+    other.m_size = 0;
+    other.m_locked = false;
+}
+
+/*!
+ * \brief Zeroizes and frees the cached keys.
+ */
+DerivedKeyCache::~DerivedKeyCache()
+{
+    free();
+}
+
+/*!
+ * \brief Returns the key derived with the specified \a parameters or nullptr if no such key is cached.
+ * \remarks The returned key is marked as most recently used. It stays valid until the next call to a non-const function.
+ */
+const unsigned char *DerivedKeyCache::find(const KeyDerivationParameters &parameters)
+{
+    const auto end = m_slots + m_size;
+    const auto slot = find_if(m_slots, end, [&parameters](const Slot &s) { return s.parameters == parameters; });
+    if (slot == end) {
+        return nullptr;
+    }
+    rotate(m_slots, slot, slot + 1);
+    return m_slots->key;
+}
+
+/*!
+ * \brief Returns the key derived by hashing the password \a hashCount times or nullptr if no such key is cached.
+ * \remarks This is a shortcut for KeyDerivationFunction::Sha256Iterations; see find() above.
+ */
+const unsigned char *DerivedKeyCache::find(std::uint32_t hashCount)
+{
+    return find(hashCountParameters(hashCount));
+}
+
+/*!
+ * \brief Inserts the specified \a key (keySize bytes) derived with the specified \a parameters.
+ * \remarks Replaces a key with the same parameters and evicts the least recently used key if the cache is full.
+ * \returns Returns the cached copy of the key. It stays valid until the next call to a non-const function.
+ */
+const unsigned char *DerivedKeyCache::insert(const KeyDerivationParameters &parameters, const unsigned char *key)
+{
+    if (!m_slots) {
+        allocate();
+    }
+    if (!find(parameters)) {
+        // use the least recently used slot (or a free one) and move it to the front
+        m_size = min(m_size + 1, maxEntries);
+        rotate(m_slots, m_slots + m_size - 1, m_slots + m_size);
+        m_slots->parameters = parameters;
+    }
+    std::memcpy(m_slots->key, key, keySize);
+    return m_slots->key;
+}
+
+/*!
+ * \brief Inserts the specified \a key (keySize bytes) derived by hashing the password \a hashCount times.
+ * \remarks This is a shortcut for KeyDerivationFunction::Sha256Iterations; see insert() above.
+ */
+const unsigned char *DerivedKeyCache::insert(std::uint32_t hashCount, const unsigned char *key)
+{
+    return insert(hashCountParameters(hashCount), key);
+}
+
+/*!
+ * \brief Returns the parameters of the most recently used key or nullptr if the cache is empty.
+ */
+const KeyDerivationParameters *DerivedKeyCache::mostRecentParameters() const
+{
+    return m_size ? &m_slots->parameters : nullptr;
+}
+
+/*!
+ * \brief Returns the hash count of the most recently used key or zero if the cache is empty or the most recently
+ *        used key has not been derived via KeyDerivationFunction::Sha256Iterations.
+ */
+std::uint32_t DerivedKeyCache::mostRecentHashCount() const
+{
+    return m_size && m_slots->parameters.function == KeyDerivationFunction::Sha256Iterations ? m_slots->parameters.iterations : 0;
+}
+
+/*!
+ * \brief Zeroizes all cached keys.
+ */
+void DerivedKeyCache::clear()
+{
+    if (m_slots) {
+        OPENSSL_cleanse(m_slots, storageSize);
+    }
+    m_size = 0;
+}
+
+/*!
+ * \brief Allocates (and locks if possible) the memory for the slots.
+ * \throws Throws std::bad_alloc if the memory can not be allocated.
+ */
+void DerivedKeyCache::allocate()
+{
+    static_assert(sizeof(Slot) * maxEntries <= storageSize, "slots fit into one page");
+#ifdef PLATFORM_UNIX
+    auto *const storage = ::mmap(nullptr, storageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (storage == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    m_locked = ::mlock(storage, storageSize) == 0;
+#ifdef MADV_DONTDUMP
+    ::madvise(storage, storageSize, MADV_DONTDUMP);
+#endif
+#else
+    auto *const storage = ::operator new(storageSize);
+    std::memset(storage, 0, storageSize);
+#endif
+    m_slots = static_cast<Slot *>(storage);
+}
+
+/*!
+ * \brief Zeroizes and frees the memory for the slots.
+ */
+void DerivedKeyCache::free()
+{
+    if (!m_slots) {
+        return;
+    }
+    clear();
+#ifdef PLATFORM_UNIX
+    if (m_locked) {
+        ::munlock(m_slots, storageSize);
+    }
+    ::munmap(m_slots, storageSize);
+#else
+    ::operator delete(m_slots);
+#endif
+    m_slots = nullptr;
+    m_locked = false;
+}
+
+} // namespace Io
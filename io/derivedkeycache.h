@@ -0,0 +1,73 @@
+#ifndef PASSWORD_FILE_IO_DERIVEDKEYCACHE_H
+#define PASSWORD_FILE_IO_DERIVEDKEYCACHE_H
+
+#include "./keyderivation.h"
+
+#include "../global.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT DerivedKeyCache {
+public:
+    static constexpr std::size_t keySize = 32;
+    static constexpr std::size_t maxEntries = 8;
+
+    explicit DerivedKeyCache();
+    DerivedKeyCache(const DerivedKeyCache &) = delete;
+    DerivedKeyCache(DerivedKeyCache &&other);
+    ~DerivedKeyCache();
+    DerivedKeyCache &operator=(const DerivedKeyCache &) = delete;
+
+    bool isEmpty() const;
+    std::size_t size() const;
+    bool isLocked() const;
+    const unsigned char *find(const KeyDerivationParameters &parameters);
+    const unsigned char *find(std::uint32_t hashCount);
+    const unsigned char *insert(const KeyDerivationParameters &parameters, const unsigned char *key);
+    const unsigned char *insert(std::uint32_t hashCount, const unsigned char *key);
+    const KeyDerivationParameters *mostRecentParameters() const;
+    std::uint32_t mostRecentHashCount() const;
+    void clear();
+
+private:
+    struct Slot;
+    void allocate();
+    void free();
+
+    Slot *m_slots;
+    std::size_t m_size;
+    bool m_locked;
+};
+
+/*!
+ * \brief Returns whether no keys are cached.
+ */
+inline bool DerivedKeyCache::isEmpty() const
+{
+    return !m_size;
+}
+
+/*!
+ * \brief Returns the number of cached keys.
+ */
+inline std::size_t DerivedKeyCache::size() const
+{
+    return m_size;
+}
+
+/*!
+ * \brief Returns whether the memory holding the keys is locked (prevented from being swapped).
+ * \remarks Locking is best-effort; it fails if the limit for locked memory has been reached or the platform
+ *          does not support it. Nothing is locked before the first key has been inserted.
+ */
+inline bool DerivedKeyCache::isLocked() const
+{
+    return m_locked;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_DERIVEDKEYCACHE_H
@@ -0,0 +1,140 @@
+#include "./encryptingstreambuffer.h"
+#include "./cryptoexception.h"
+
+#include "../util/openssl.h"
+
+#include <openssl/evp.h>
+
+#include <ios>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class EncryptingStreamBuffer
+ * \brief The EncryptingStreamBuffer class provides a write-only stream buffer which encrypts the data written to it
+ *        using the specified EncryptionCipher and writes the encrypted data to another stream buffer.
+ *
+ * The data is buffered and encrypted in chunks of bufferSize bytes so only a fixed window of the data is held in memory
+ * at a time. Call finish() after writing all data to write the last (padded) block or, when using an authenticated
+ * cipher, the authentication tag (authenticationTagSize bytes appended to the encrypted data).
+ *
+ * \remarks Encryption errors are reported by throwing a CryptoException and errors when writing to the sink by throwing
+ *          an std::ios_base::failure. When the buffer is used via an std::ostream, enable exceptions for
+ *          std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Constructs a new buffer writing the encrypted data to \a sink using the specified \a key and \a iv.
+ * \remarks The \a key must be 32 bytes long and the \a iv as long as encryptionCipherIvSize() returns for the
+ *          \a cipher. Both are copied.
+ * \throws Throws CryptoException when the encryption can not be initialized.
+ */
+EncryptingStreamBuffer::EncryptingStreamBuffer(std::streambuf *sink, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher)
+    : m_sink(sink)
+    , m_inputBuffer(make_unique<char[]>(bufferSize))
+    , m_outputBuffer(make_unique<char[]>(bufferSize + EVP_MAX_BLOCK_LENGTH))
+    , m_authenticated(isAuthenticatedCipher(cipher))
+    , m_finished(false)
+{
+    if (EVP_EncryptInit_ex(m_context.get(), evpCipher(cipher), nullptr, key, iv) != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    setp(m_inputBuffer.get(), m_inputBuffer.get() + bufferSize);
+}
+
+/*!
+ * \brief Destroys the buffer.
+ * \remarks Buffered data which has not been encrypted yet is discarded; call finish() before.
+ */
+EncryptingStreamBuffer::~EncryptingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Encrypts the buffered data and the last block (including padding) and writes it to the sink.
+ * \remarks No further data can be written afterwards. When using an authenticated cipher, the authentication tag is
+ *          written instead of a padded block.
+ * \throws Throws CryptoException when an encryption error occurs.
+ * \throws Throws std::ios_base::failure when the encrypted data can not be written to the sink.
+ */
+void EncryptingStreamBuffer::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    encryptBuffer();
+    auto outputSize = 0;
+    if (EVP_EncryptFinal_ex(m_context.get(), reinterpret_cast<unsigned char *>(m_outputBuffer.get()), &outputSize) != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    writeOutput(outputSize);
+    if (m_authenticated) {
+        if (EVP_CIPHER_CTX_ctrl(m_context.get(), EVP_CTRL_AEAD_GET_TAG, static_cast<int>(authenticationTagSize), m_outputBuffer.get()) != 1) {
+            throw CryptoException(Util::OpenSsl::errorMessages());
+        }
+        writeOutput(static_cast<int>(authenticationTagSize));
+    }
+    m_finished = true;
+    setp(nullptr, nullptr);
+}
+
+/*!
+ * \brief Encrypts the buffered data to make room for \a c.
+ */
+EncryptingStreamBuffer::int_type EncryptingStreamBuffer::overflow(int_type c)
+{
+    if (m_finished) {
+        return traits_type::eof();
+    }
+    encryptBuffer();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+/*!
+ * \brief Encrypts the buffered data and flushes the sink.
+ * \remarks The last block is only written by finish().
+ */
+int EncryptingStreamBuffer::sync()
+{
+    if (!m_finished) {
+        encryptBuffer();
+    }
+    return m_sink->pubsync();
+}
+
+/*!
+ * \brief Encrypts the buffered data and writes the encrypted data to the sink.
+ */
+void EncryptingStreamBuffer::encryptBuffer()
+{
+    const auto inputSize = static_cast<int>(pptr() - pbase());
+    if (!inputSize) {
+        return;
+    }
+    auto outputSize = 0;
+    if (EVP_EncryptUpdate(m_context.get(), reinterpret_cast<unsigned char *>(m_outputBuffer.get()), &outputSize,
+            reinterpret_cast<const unsigned char *>(pbase()), inputSize)
+        != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    setp(m_inputBuffer.get(), m_inputBuffer.get() + bufferSize);
+    writeOutput(outputSize);
+}
+
+/*!
+ * \brief Writes \a size bytes of the output buffer to the sink.
+ */
+void EncryptingStreamBuffer::writeOutput(int size)
+{
+    if (size && m_sink->sputn(m_outputBuffer.get(), size) != size) {
+        throw std::ios_base::failure("Unable to write encrypted data.");
+    }
+}
+
+} // namespace Io
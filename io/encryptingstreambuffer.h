@@ -0,0 +1,43 @@
+#ifndef PASSWORD_FILE_IO_ENCRYPTINGSTREAMBUFFER_H
+#define PASSWORD_FILE_IO_ENCRYPTINGSTREAMBUFFER_H
+
+#include "./encryptioncipher.h"
+
+#include "../util/openssl.h"
+
+#include <memory>
+#include <streambuf>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT EncryptingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t bufferSize = 0x10000;
+
+    explicit EncryptingStreamBuffer(
+        std::streambuf *sink, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher = EncryptionCipher::Aes256Cbc);
+    EncryptingStreamBuffer(const EncryptingStreamBuffer &) = delete;
+    ~EncryptingStreamBuffer() override;
+    EncryptingStreamBuffer &operator=(const EncryptingStreamBuffer &) = delete;
+
+    void finish();
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    void encryptBuffer();
+    void writeOutput(int size);
+
+    std::streambuf *m_sink;
+    Util::OpenSsl::CipherContext m_context;
+    std::unique_ptr<char[]> m_inputBuffer;
+    std::unique_ptr<char[]> m_outputBuffer;
+    bool m_authenticated;
+    bool m_finished;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_ENCRYPTINGSTREAMBUFFER_H
@@ -0,0 +1,83 @@
+#include "./encryptioncipher.h"
+
+#include "../util/openssl.h"
+
+#include <openssl/evp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace Io {
+
+/*!
+ * \brief Returns the name of the specified \a cipher.
+ */
+const char *encryptionCipherName(EncryptionCipher cipher)
+{
+    switch (cipher) {
+    case EncryptionCipher::Aes256Cbc:
+        return "AES-256-CBC";
+    case EncryptionCipher::Aes256Gcm:
+        return "AES-256-GCM";
+    case EncryptionCipher::ChaCha20Poly1305:
+        return "ChaCha20-Poly1305";
+    }
+    return "unknown";
+}
+
+/*!
+ * \brief Returns whether the specified \a cipher authenticates the encrypted data via a tag.
+ */
+bool isAuthenticatedCipher(EncryptionCipher cipher)
+{
+    return cipher != EncryptionCipher::Aes256Cbc;
+}
+
+/*!
+ * \brief Returns the size of the IV (or nonce) used by the specified \a cipher.
+ */
+std::size_t encryptionCipherIvSize(EncryptionCipher cipher)
+{
+    return isAuthenticatedCipher(cipher) ? 12 : 16;
+}
+
+/*!
+ * \brief Returns the authenticated cipher which is expected to be the fastest on the current CPU.
+ * \remarks Returns EncryptionCipher::Aes256Gcm if the CPU provides AES instructions (or if that can not be determined)
+ *          and EncryptionCipher::ChaCha20Poly1305 otherwise.
+ */
+EncryptionCipher preferredAuthenticatedCipher()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && !(ecx & bit_AES)) {
+        return EncryptionCipher::ChaCha20Poly1305;
+    }
+#elif defined(__aarch64__) && defined(__linux__)
+    if (!(getauxval(AT_HWCAP) & HWCAP_AES)) {
+        return EncryptionCipher::ChaCha20Poly1305;
+    }
+#endif
+    return EncryptionCipher::Aes256Gcm;
+}
+
+/*!
+ * \brief Returns the OpenSSL cipher for the specified \a cipher.
+ * \remarks The ciphers are only fetched once (see Util::OpenSsl::fetchCipher()).
+ */
+const evp_cipher_st *evpCipher(EncryptionCipher cipher)
+{
+    static const evp_cipher_st *const ciphers[] = {
+        Util::OpenSsl::fetchCipher("AES-256-CBC"),
+        Util::OpenSsl::fetchCipher("AES-256-GCM"),
+        Util::OpenSsl::fetchCipher("ChaCha20-Poly1305"),
+    };
+    const auto index = static_cast<std::size_t>(cipher);
+    return index < sizeof(ciphers) / sizeof(ciphers[0]) ? ciphers[index] : ciphers[0];
+}
+
+} // namespace Io
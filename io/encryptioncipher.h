@@ -0,0 +1,34 @@
+#ifndef PASSWORD_FILE_IO_ENCRYPTIONCIPHER_H
+#define PASSWORD_FILE_IO_ENCRYPTIONCIPHER_H
+
+#include "../global.h"
+
+#include <cstddef>
+#include <cstdint>
+
+struct evp_cipher_st;
+
+namespace Io {
+
+/*!
+ * \brief The EncryptionCipher enum specifies the algorithm used to encrypt the contents of a file.
+ * \remarks The values are stored in the file header (as of version 11) so they must not be changed.
+ */
+enum class EncryptionCipher : std::uint8_t {
+    Aes256Cbc = 0, /**< AES-256 in CBC mode with PKCS #7 padding (the only cipher supported before version 11) */
+    Aes256Gcm = 1, /**< AES-256 in GCM mode (authenticated, fast on CPUs with AES instructions) */
+    ChaCha20Poly1305 = 2, /**< ChaCha20 with Poly1305 (authenticated, fast on CPUs without AES instructions) */
+};
+
+/// \brief The size of the authentication tag appended to data encrypted with an authenticated cipher.
+constexpr std::size_t authenticationTagSize = 16;
+
+PASSWORD_FILE_EXPORT const char *encryptionCipherName(EncryptionCipher cipher);
+PASSWORD_FILE_EXPORT bool isAuthenticatedCipher(EncryptionCipher cipher);
+PASSWORD_FILE_EXPORT std::size_t encryptionCipherIvSize(EncryptionCipher cipher);
+PASSWORD_FILE_EXPORT EncryptionCipher preferredAuthenticatedCipher();
+const evp_cipher_st *evpCipher(EncryptionCipher cipher);
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_ENCRYPTIONCIPHER_H
@@ -1,4 +1,5 @@
 #include "./entry.h"
+#include "./entryparser.h"
 #include "./parsingexception.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
@@ -6,13 +7,147 @@
 #include <c++utilities/io/binarywriter.h>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
 
 using namespace std;
 using namespace CppUtilities;
 
 namespace Io {
 
+/// \brief The FieldShapeIndex struct assigns indices to the field shapes of the accounts serialized within the same node.
+struct FieldShapeIndex {
+    std::map<std::vector<std::string_view>, std::uint32_t> indices;
+};
+
+/// \brief Returns \a flags without EntrySerializationFlags::CacheSubtrees which has no influence on the serialized data.
+static constexpr EntrySerializationFlags withoutCacheSubtrees(EntrySerializationFlags flags)
+{
+    return static_cast<EntrySerializationFlags>(
+        static_cast<std::uint64_t>(flags) & ~static_cast<std::uint64_t>(EntrySerializationFlags::CacheSubtrees));
+}
+
+/// \brief The StringAppendingStreamBuffer class is an output buffer which appends the data written to it to a string.
+class StringAppendingStreamBuffer : public std::streambuf {
+public:
+    explicit StringAppendingStreamBuffer(std::string &data)
+        : m_data(data)
+    {
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            m_data.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char_type *data, std::streamsize count) override
+    {
+        m_data.append(data, static_cast<std::size_t>(count));
+        return count;
+    }
+
+private:
+    std::string &m_data;
+};
+
+/*!
+ * \brief The SubtreeCache struct collects the serialized children of node entries when serializing with
+ *        EntrySerializationFlags::CacheSubtrees.
+ *
+ * All data is serialized into one buffer. The cached children of each node refer to their part of that buffer.
+ */
+struct SubtreeCache {
+    /// \brief The Span struct denotes the serialized children of a node within the buffer.
+    struct Span {
+        const NodeEntry *node;
+        std::size_t offset;
+        std::uint64_t size;
+        bool deferred;
+    };
+
+    explicit SubtreeCache();
+    void addSplicedSpans(const NodeEntry &node, const char *oldData, std::uint64_t oldSize, std::size_t offset);
+    std::shared_ptr<const std::string> commit(EntrySerializationFlags flags);
+
+    std::string data;
+    StringAppendingStreamBuffer buffer;
+    std::ostream stream;
+    std::vector<Span> spans;
+};
+
+SubtreeCache::SubtreeCache()
+    : buffer(data)
+    , stream(&buffer)
+{
+    stream.exceptions(ios_base::failbit | ios_base::badbit);
+}
+
+/*!
+ * \brief Adds spans for the cached and deferred children of the descendants of \a node.
+ * \remarks This is used after the cached children of \a node have been copied from \a oldData (which is \a oldSize bytes
+ *          long) to \a offset. The descendants' data is contained within \a oldData so it can be re-located to the new
+ *          buffer as well which allows freeing the old buffer.
+ */
+void SubtreeCache::addSplicedSpans(const NodeEntry &node, const char *oldData, std::uint64_t oldSize, std::size_t offset)
+{
+    const auto *const oldEnd = oldData + oldSize;
+    const auto contains = [oldData, oldEnd](const char *begin, std::uint64_t size) {
+        return begin >= oldData && begin <= oldEnd && size <= static_cast<std::uint64_t>(oldEnd - begin);
+    };
+    for (const Entry *const child : node.m_children) {
+        if (child->type() != EntryType::Node) {
+            continue;
+        }
+        const auto &childNode = *static_cast<const NodeEntry *>(child);
+        const auto children = childNode.serializedChildren(EntrySerializationFlags::None);
+        if (children.deferred && contains(children.data.get(), children.size)) {
+            spans.emplace_back(Span{ &childNode, offset + static_cast<std::size_t>(children.data.get() - oldData), children.size, true });
+            continue;
+        }
+        auto cachedData = std::shared_ptr<const char>();
+        auto cachedSize = std::uint64_t();
+        {
+            const auto lock = std::lock_guard<std::mutex>(childNode.m_mutex);
+            cachedData = childNode.m_cachedChildren;
+            cachedSize = childNode.m_cachedSize;
+        }
+        if (cachedData && contains(cachedData.get(), cachedSize)) {
+            spans.emplace_back(Span{ &childNode, offset + static_cast<std::size_t>(cachedData.get() - oldData), cachedSize, false });
+            addSplicedSpans(childNode, oldData, oldSize, offset);
+        }
+    }
+}
+
+/*!
+ * \brief Moves the buffer into shared memory and assigns the spans to the nodes.
+ * \remarks Deferred children which have been parsed in the meantime (by another thread) are not assigned again.
+ */
+std::shared_ptr<const std::string> SubtreeCache::commit(EntrySerializationFlags flags)
+{
+    const auto sharedData = std::make_shared<const std::string>(std::move(data));
+    for (const auto &span : spans) {
+        auto spanData = std::shared_ptr<const char>(sharedData, sharedData->data() + span.offset);
+        const auto lock = std::lock_guard<std::mutex>(span.node->m_mutex);
+        if (!span.deferred) {
+            span.node->m_cachedChildren = std::move(spanData);
+            span.node->m_cachedSize = span.size;
+            span.node->m_cachedFlags = flags;
+        } else if (span.node->m_deferredChildren) {
+            span.node->m_deferredChildren = std::move(spanData);
+        }
+    }
+    return sharedData;
+}
+
 /*!
  * \namespace Io
  * \brief Contains all IO related classes.
@@ -84,6 +219,20 @@ void Entry::makeLabelUnique()
     m_label.swap(newLabel);
 }
 
+/*!
+ * \brief Marks the entry as modified so the cached serialized children of its ancestors are discarded.
+ * \remarks This is done automatically by all methods modifying entries and when accessing the fields of an account
+ *          for modification via AccountEntry::fields(). It is only required to call this method explicitly when
+ *          modifying fields via a reference obtained before the entry has been serialized.
+ * \sa NodeEntry::hasCachedChildren()
+ */
+void Entry::markAsModified()
+{
+    for (auto *node = m_parent; node; node = node->m_parent) {
+        node->m_cachedChildren.reset();
+    }
+}
+
 /*!
  * \brief Sets the \a parent for the entry.
  *
@@ -105,6 +254,7 @@ void Entry::setParent(NodeEntry *parent, int index)
 
     // detach the current parent
     if (m_parent) {
+        m_parent->markChildrenAsModified();
         m_parent->m_children.erase(m_parent->m_children.begin() + m_index);
         for (auto i = m_parent->m_children.begin() + m_index; i < m_parent->m_children.end(); ++i) {
             (*i)->m_index -= 1;
@@ -113,6 +263,7 @@ void Entry::setParent(NodeEntry *parent, int index)
 
     // attach the new parent
     if (parent) {
+        parent->parseDeferredChildren();
         if (index < 0 || static_cast<size_t>(index) >= parent->m_children.size()) {
             m_index = static_cast<int>(parent->m_children.size());
             parent->m_children.push_back(this);
@@ -122,6 +273,7 @@ void Entry::setParent(NodeEntry *parent, int index)
             }
             m_index = index;
         }
+        parent->markChildrenAsModified();
     } else {
         m_index = -1;
     }
@@ -191,6 +343,8 @@ Entry *Entry::parse(istream &stream)
 /*!
  * \fn Entry::make()
  * \brief Serializes the entry to the specified \a stream.
+ * \remarks Specify EntrySerializationFlags::SubtreeSizes via \a flags to allow parsing the children of node entries
+ *          lazily. This requires NodeEntry version 0x2 which is not supported by older versions of this library.
  */
 
 /*!
@@ -203,6 +357,10 @@ Entry *Entry::parse(istream &stream)
 /*!
  * \class NodeEntry
  * \brief The NodeEntry class acts as parent for other entries.
+ *
+ * When a node entry has been serialized with EntrySerializationFlags::SubtreeSizes and is parsed via an EntryParser
+ * operating on a shared buffer, its children are not parsed immediately. Instead the node keeps a reference to the
+ * buffer and parses them on first access (see parseDeferredChildren()).
  */
 
 /*!
@@ -210,6 +368,11 @@ Entry *Entry::parse(istream &stream)
  */
 NodeEntry::NodeEntry()
     : Entry()
+    , m_deferredSize(0)
+    , m_deferredCount(0)
+    , m_cachedSize(0)
+    , m_cachedFlags(EntrySerializationFlags::None)
+    , m_hasDeferredChildren(false)
     , m_expandedByDefault(true)
 {
 }
@@ -219,6 +382,11 @@ NodeEntry::NodeEntry()
  */
 NodeEntry::NodeEntry(const string &label, NodeEntry *parent)
     : Entry(label, parent)
+    , m_deferredSize(0)
+    , m_deferredCount(0)
+    , m_cachedSize(0)
+    , m_cachedFlags(EntrySerializationFlags::None)
+    , m_hasDeferredChildren(false)
     , m_expandedByDefault(true)
 {
 }
@@ -227,19 +395,24 @@ NodeEntry::NodeEntry(const string &label, NodeEntry *parent)
  * \brief Constructs a new node entry which is deserialized from the specified \a stream.
  */
 NodeEntry::NodeEntry(istream &stream)
-    : m_expandedByDefault(true)
+    : m_deferredSize(0)
+    , m_deferredCount(0)
+    , m_cachedSize(0)
+    , m_cachedFlags(EntrySerializationFlags::None)
+    , m_hasDeferredChildren(false)
+    , m_expandedByDefault(true)
 {
     BinaryReader reader(&stream);
     const std::uint8_t version = reader.readByte();
     if (!denotesNodeEntry(version)) {
         throw ParsingException("Node entry expected.");
     }
-    if (version != 0x0 && version != 0x1) {
+    if (version != 0x0 && version != 0x1 && version != 0x2) {
         throw ParsingException("Entry version not supported.");
     }
     setLabel(reader.readLengthPrefixedString());
-    // read extended header for version 0x1
-    if (version == 0x1) {
+    // read extended header for version 0x1 and 0x2
+    if (version >= 0x1) {
         std::uint16_t extendedHeaderSize = reader.readUInt16BE();
         if (extendedHeaderSize >= 1) {
             std::uint8_t flags = reader.readByte();
@@ -249,8 +422,16 @@ NodeEntry::NodeEntry(istream &stream)
         m_extendedData = reader.readString(extendedHeaderSize);
     }
     const std::uint32_t childCount = reader.readUInt32BE();
+    // skip the size of the children present in version 0x2 (only relevant when parsing lazily)
+    if (version == 0x2) {
+        reader.readUInt64BE();
+    }
+    // note: Field shapes of accounts are only valid within the node so they are tracked here.
+    auto shapes = std::vector<FieldShape>();
     for (std::uint32_t i = 0; i != childCount; ++i) {
-        Entry::parse(stream)->setParent(this);
+        const auto childVersion = static_cast<std::uint8_t>(stream.peek());
+        auto *const child = denotesNodeEntry(childVersion) ? static_cast<Entry *>(new NodeEntry(stream)) : new AccountEntry(stream, &shapes);
+        child->setParent(this);
     }
 }
 
@@ -261,7 +442,25 @@ NodeEntry::NodeEntry(istream &stream)
  */
 NodeEntry::NodeEntry(const NodeEntry &other)
     : Entry(other)
+    , m_deferredSize(other.m_deferredSize)
+    , m_deferredCount(other.m_deferredCount)
+    , m_cachedSize(0)
+    , m_cachedFlags(EntrySerializationFlags::None)
+    , m_hasDeferredChildren(false)
+    , m_expandedByDefault(other.m_expandedByDefault)
 {
+    // note: Deferred and cached children are not parsed/serialized again but share the buffer of \a other.
+    {
+        const auto lock = std::lock_guard<std::mutex>(other.m_mutex);
+        m_deferredChildren = other.m_deferredChildren;
+        m_cachedChildren = other.m_cachedChildren;
+        m_cachedSize = other.m_cachedSize;
+        m_cachedFlags = other.m_cachedFlags;
+    }
+    if (m_deferredChildren) {
+        m_hasDeferredChildren = true;
+        return;
+    }
     for (Entry *const otherChild : other.m_children) {
         Entry *clonedChild = otherChild->clone();
         clonedChild->m_parent = this;
@@ -281,6 +480,176 @@ NodeEntry::~NodeEntry()
     }
 }
 
+/*!
+ * \brief Parses the children if their parsing has been deferred; does nothing otherwise.
+ *
+ * Node entries serialized with EntrySerializationFlags::SubtreeSizes store the size of their children. When parsing
+ * them via an EntryParser operating on a shared buffer, the children are skipped and this method is called when they
+ * are accessed for the first time. Nested node entries are parsed lazily again.
+ *
+ * \remarks
+ * - This method is const because parsing the children does not change the logical state of the node.
+ * - The children of a node are parsed only once, even when they are accessed from multiple threads at the same time.
+ *   So const methods might be used concurrently. Methods modifying the tree still require exclusive access.
+ * \throws Throws ParsingException when a parsing error occurs. The node is left unchanged in this case.
+ */
+void NodeEntry::parseDeferredChildren() const
+{
+    parseDeferredData(true);
+}
+
+/*!
+ * \brief Parses all deferred children of the node and its descendants.
+ *
+ * The subtrees of different nodes are independent of each other. So if \a threadCount is greater than one, they are
+ * parsed concurrently using up to \a threadCount threads (including the calling thread). Subtrees which are too big
+ * to distribute the work evenly are split by parsing their direct children first.
+ *
+ * \throws Throws ParsingException when a parsing error occurs. The node for which the error occurred is left unchanged
+ *         but other nodes might have been parsed successfully.
+ */
+void NodeEntry::parseDeferredDescendants(std::size_t threadCount) const
+{
+    // collect the topmost nodes with deferred children
+    auto candidates = std::vector<const NodeEntry *>();
+    auto totalSize = std::uint64_t();
+    const auto collect = [&candidates, &totalSize](const NodeEntry *node) {
+        for (auto stack = std::vector<const NodeEntry *>{ node }; !stack.empty();) {
+            node = stack.back();
+            stack.pop_back();
+            if (node->hasDeferredChildren()) {
+                candidates.emplace_back(node);
+                totalSize += node->m_deferredSize;
+                continue;
+            }
+            for (const Entry *const child : node->m_children) {
+                if (child->type() == EntryType::Node) {
+                    stack.emplace_back(static_cast<const NodeEntry *>(child));
+                }
+            }
+        }
+    };
+    collect(this);
+    if (candidates.empty()) {
+        return;
+    }
+
+    // split big subtrees into smaller ones
+    auto subtrees = std::vector<const NodeEntry *>();
+    const auto maxSubtreeSize = threadCount > 1 ? totalSize / (threadCount * 4) : totalSize;
+    while (!candidates.empty()) {
+        const auto *const node = candidates.back();
+        candidates.pop_back();
+        if (node->m_deferredSize <= maxSubtreeSize) {
+            subtrees.emplace_back(node);
+            continue;
+        }
+        node->parseDeferredData(true);
+        for (const Entry *const child : node->m_children) {
+            if (child->type() == EntryType::Node) {
+                collect(static_cast<const NodeEntry *>(child));
+            }
+        }
+    }
+
+    // parse the subtrees, the biggest first
+    std::sort(subtrees.begin(), subtrees.end(), [](const NodeEntry *lhs, const NodeEntry *rhs) { return lhs->m_deferredSize > rhs->m_deferredSize; });
+    auto nextSubtree = std::atomic<std::size_t>();
+    auto error = std::exception_ptr();
+    auto errorMutex = std::mutex();
+    const auto parseSubtrees = [&] {
+        for (auto i = nextSubtree++; i < subtrees.size(); i = nextSubtree++) {
+            try {
+                // parse the descendants individually if the subtree has been parsed lazily by another thread in the meantime
+                if (!subtrees[i]->parseDeferredData(false)) {
+                    subtrees[i]->parseDeferredDescendants();
+                }
+            } catch (...) {
+                const auto lock = std::lock_guard<std::mutex>(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+    auto threads = std::vector<std::thread>();
+    threads.reserve(std::min(threadCount, subtrees.size()));
+    for (auto i = std::size_t(1); i < threadCount && i < subtrees.size(); ++i) {
+        threads.emplace_back(parseSubtrees);
+    }
+    parseSubtrees();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/*!
+ * \brief Parses the deferred children; the children of nested node entries are deferred again if \a lazily is set.
+ * \returns Returns whether the children have been parsed by this call; returns false if there were no deferred children.
+ */
+bool NodeEntry::parseDeferredData(bool lazily) const
+{
+    const auto lock = std::lock_guard<std::mutex>(m_mutex);
+    if (!m_deferredChildren) {
+        return false;
+    }
+    auto *const self = const_cast<NodeEntry *>(this);
+    try {
+        auto parser = lazily ? EntryParser(m_deferredChildren, m_deferredSize) : EntryParser(m_deferredChildren.get(), m_deferredSize);
+        parser.parseChildren(self, m_deferredCount);
+        if (!parser.isAtEnd()) {
+            throw ParsingException("The size of the children does not match the denoted size.");
+        }
+    } catch (...) {
+        // note: Not using deleteChildren() because marking the ancestors as modified would race with the parsing of
+        //       other subtrees (see parseDeferredDescendants()).
+        for (Entry *const child : self->m_children) {
+            child->m_parent = nullptr;
+            delete child;
+        }
+        self->m_children.clear();
+        throw;
+    }
+    // keep the data as cached children when parsing lazily (it is kept alive by the siblings anyways)
+    // note: The deferred data might use all features so it can only be copied as-is if they're enabled.
+    auto data = std::move(m_deferredChildren);
+    if (lazily) {
+        m_cachedChildren = std::move(data);
+        m_cachedSize = m_deferredSize;
+        m_cachedFlags = EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes;
+    }
+    m_hasDeferredChildren.store(false, std::memory_order_release);
+    return true;
+}
+
+/*!
+ * \brief Returns the deferred children or the children cached for the specified \a flags; returns no data otherwise.
+ * \remarks If no data is returned, the children have been parsed and can be accessed without locking.
+ */
+NodeEntry::SerializedChildren NodeEntry::serializedChildren(EntrySerializationFlags flags) const
+{
+    const auto lock = std::lock_guard<std::mutex>(m_mutex);
+    if (m_deferredChildren) {
+        return SerializedChildren{ m_deferredChildren, m_deferredSize, true };
+    }
+    if (m_cachedChildren && m_cachedFlags == flags) {
+        return SerializedChildren{ m_cachedChildren, m_cachedSize, false };
+    }
+    return SerializedChildren();
+}
+
+/*!
+ * \brief Discards the cached children of the node and its ancestors because the children have been modified.
+ */
+void NodeEntry::markChildrenAsModified()
+{
+    m_cachedChildren.reset();
+    markAsModified();
+}
+
 /*!
  * \brief Deletes children from the node entry.
  * \param begin Specifies the index of the first children to delete.
@@ -289,6 +658,8 @@ NodeEntry::~NodeEntry()
  */
 void NodeEntry::deleteChildren(int begin, int end)
 {
+    parseDeferredChildren();
+    markChildrenAsModified();
     const auto endIterator = m_children.begin() + end;
 
     // delete the children
@@ -316,16 +687,20 @@ void NodeEntry::deleteChildren(int begin, int end)
  */
 void NodeEntry::replaceChild(size_t at, Entry *newChild)
 {
+    parseDeferredChildren();
     if (at >= m_children.size()) {
         return;
     }
 
+    markChildrenAsModified();
+
     // detach the old child
     m_children[at]->m_parent = nullptr;
     m_children[at]->m_index = -1;
 
     // detach new child from its previous parent
     if (auto *newChildOldParent = newChild->m_parent) {
+        newChildOldParent->markChildrenAsModified();
         newChildOldParent->m_children.erase(newChildOldParent->m_children.begin() + newChild->m_index);
         for (auto i = newChildOldParent->m_children.begin() + newChild->m_index; i < newChildOldParent->m_children.end(); ++i) {
             (*i)->m_index -= 1;
@@ -365,7 +740,7 @@ Entry *NodeEntry::entryByPath(list<string> &path, bool includeThis, const EntryT
         return this;
     }
 
-    for (Entry *const child : m_children) {
+    for (Entry *const child : children()) {
         if (path.front() != child->label()) {
             continue;
         }
@@ -392,23 +767,190 @@ Entry *NodeEntry::entryByPath(list<string> &path, bool includeThis, const EntryT
     return nullptr;
 }
 
-void NodeEntry::make(ostream &stream) const
+/*!
+ * \brief Serializes the entry to the specified \a stream.
+ * \remarks
+ * - Children which have not been modified since they have been serialized with the same \a flags and
+ *   EntrySerializationFlags::CacheSubtrees (or parsed lazily) are copied as-is.
+ * - When EntrySerializationFlags::CacheSubtrees is specified and the children are not cached yet, the node is
+ *   serialized into a buffer first. The serialized children of all nodes are kept within that buffer.
+ * - This method is const because caching the serialized children does not change the logical state of the node. The
+ *   same tree might be serialized from multiple threads at the same time.
+ */
+void NodeEntry::make(ostream &stream, EntrySerializationFlags flags) const
 {
+    const auto cacheSubtrees = flags & EntrySerializationFlags::CacheSubtrees;
+    flags = withoutCacheSubtrees(flags);
+    if (const auto cached = serializedChildren(flags); cacheSubtrees && (!cached.data || cached.deferred)) {
+        auto cache = SubtreeCache();
+        makeCached(cache, flags);
+        const auto data = cache.commit(flags);
+        stream.write(data->data(), static_cast<std::streamsize>(data->size()));
+        return;
+    }
+
+    makeHeader(stream, flags);
     BinaryWriter writer(&stream);
-    writer.writeByte(isExpandedByDefault() && m_extendedData.empty() ? 0x0 : 0x1); // version
+    const auto withSubtreeSizes = flags & EntrySerializationFlags::SubtreeSizes;
+
+    // copy deferred or cached children as-is
+    const auto children = serializedChildren(flags);
+    if (children.deferred) {
+        writer.writeUInt32BE(m_deferredCount);
+        writer.writeUInt64BE(children.size);
+        stream.write(children.data.get(), static_cast<std::streamsize>(children.size));
+        return;
+    }
+    writer.writeUInt32BE(static_cast<std::uint32_t>(m_children.size()));
+    if (children.data) {
+        if (withSubtreeSizes) {
+            writer.writeUInt64BE(children.size);
+        }
+        stream.write(children.data.get(), static_cast<std::streamsize>(children.size));
+        return;
+    }
+
+    if (withSubtreeSizes) {
+        writer.writeUInt64BE(childrenSize(flags));
+    }
+    makeChildren(stream, flags);
+}
+
+/*!
+ * \brief Serializes the entry excluding its children (and their count/size) to the specified \a stream.
+ * \remarks Parses deferred children if they can not be copied as-is.
+ */
+void NodeEntry::makeHeader(ostream &stream, EntrySerializationFlags flags) const
+{
+    const auto withSubtreeSizes = flags & EntrySerializationFlags::SubtreeSizes;
+    if (!withSubtreeSizes || !(flags & EntrySerializationFlags::FieldShapes)) {
+        parseDeferredChildren(); // the deferred data might use all features so it can only be copied as-is if they're enabled
+    }
+
+    BinaryWriter writer(&stream);
+    const auto hasExtendedHeader = withSubtreeSizes || !isExpandedByDefault() || !m_extendedData.empty();
+    writer.writeByte(withSubtreeSizes ? 0x2 : (hasExtendedHeader ? 0x1 : 0x0)); // version
     writer.writeLengthPrefixedString(label());
-    if (!isExpandedByDefault() || !m_extendedData.empty()) {
+    if (hasExtendedHeader) {
         writer.writeUInt16BE(static_cast<std::uint16_t>(1 + m_extendedData.size())); // extended header is 1 byte long
-        std::uint8_t flags = 0x00;
+        std::uint8_t headerFlags = 0x00;
         if (isExpandedByDefault()) {
-            flags |= 0x80;
+            headerFlags |= 0x80;
         }
-        writer.writeByte(flags);
+        writer.writeByte(headerFlags);
         writer.writeString(m_extendedData);
     }
-    writer.writeUInt32BE(static_cast<std::uint32_t>(m_children.size()));
+}
+
+/*!
+ * \brief Returns the number of bytes make() would write.
+ * \remarks
+ * - The size of cached children is re-used (see EntrySerializationFlags::CacheSubtrees).
+ * - Parses deferred children if they can not be copied as-is.
+ */
+std::uint64_t NodeEntry::serializedSize(EntrySerializationFlags flags) const
+{
+    flags = withoutCacheSubtrees(flags);
+    const auto size = headerSize(flags) + 4 + childrenSize(flags);
+    return flags & EntrySerializationFlags::SubtreeSizes ? size + 8 : size;
+}
+
+/*!
+ * \brief Returns the number of bytes makeHeader() would write.
+ */
+std::uint64_t NodeEntry::headerSize(EntrySerializationFlags flags) const
+{
+    const auto withSubtreeSizes = flags & EntrySerializationFlags::SubtreeSizes;
+    if (!withSubtreeSizes || !(flags & EntrySerializationFlags::FieldShapes)) {
+        parseDeferredChildren();
+    }
+    const auto hasExtendedHeader = withSubtreeSizes || !isExpandedByDefault() || !m_extendedData.empty();
+    return 1 + Field::serializedSize(label()) + (hasExtendedHeader ? 2 + 1 + m_extendedData.size() : 0);
+}
+
+/*!
+ * \brief Returns the number of bytes makeChildren() would write.
+ * \remarks The size is only re-used if the serialized children are cached for the same \a flags. It is not cached
+ *          on its own because the fields of accounts might be modified via references obtained before.
+ */
+std::uint64_t NodeEntry::childrenSize(EntrySerializationFlags flags) const
+{
+    if (const auto children = serializedChildren(flags); children.data) {
+        return children.size;
+    }
+    auto size = std::uint64_t();
+    auto shapes = FieldShapeIndex();
+    for (const Entry *const child : m_children) {
+        if (child->type() == EntryType::Account) {
+            size += static_cast<const AccountEntry *>(child)->serializedSize(flags, shapes);
+        } else {
+            size += child->serializedSize(flags);
+        }
+    }
+    return size;
+}
+
+/*!
+ * \brief Serializes the children to the specified \a stream.
+ * \remarks Field shapes are only valid within the same node so the index is shared between the children.
+ */
+void NodeEntry::makeChildren(ostream &stream, EntrySerializationFlags flags) const
+{
+    auto shapes = FieldShapeIndex();
     for (const Entry *const child : m_children) {
-        child->make(stream);
+        if (child->type() == EntryType::Account) {
+            static_cast<const AccountEntry *>(child)->make(stream, flags, shapes);
+        } else {
+            child->make(stream, flags);
+        }
+    }
+}
+
+/*!
+ * \brief Serializes the entry into the buffer of the specified \a cache and adds spans for the children of this
+ *        node and its descendants.
+ * \remarks The size of the children is written after serializing them so they don't need to be serialized twice.
+ */
+void NodeEntry::makeCached(SubtreeCache &cache, EntrySerializationFlags flags) const
+{
+    makeHeader(cache.stream, flags);
+    BinaryWriter writer(&cache.stream);
+    const auto withSubtreeSizes = flags & EntrySerializationFlags::SubtreeSizes;
+
+    // copy deferred children as-is, they are relocated to the new buffer
+    const auto children = serializedChildren(flags);
+    if (children.deferred) {
+        writer.writeUInt32BE(m_deferredCount);
+        writer.writeUInt64BE(children.size);
+        cache.spans.emplace_back(SubtreeCache::Span{ this, cache.data.size(), children.size, true });
+        cache.data.append(children.data.get(), static_cast<std::size_t>(children.size));
+        return;
+    }
+
+    writer.writeUInt32BE(static_cast<std::uint32_t>(m_children.size()));
+    const auto sizeOffset = cache.data.size();
+    if (withSubtreeSizes) {
+        writer.writeUInt64BE(0); // actual size is written below
+    }
+    const auto offset = cache.data.size();
+    if (children.data) {
+        // copy cached children as-is, the cached data of descendants is relocated to the new buffer
+        cache.data.append(children.data.get(), static_cast<std::size_t>(children.size));
+        cache.addSplicedSpans(*this, children.data.get(), children.size, offset);
+    } else {
+        auto shapes = FieldShapeIndex();
+        for (const Entry *const child : m_children) {
+            if (child->type() == EntryType::Account) {
+                static_cast<const AccountEntry *>(child)->make(cache.stream, flags, shapes);
+            } else {
+                static_cast<const NodeEntry *>(child)->makeCached(cache, flags);
+            }
+        }
+    }
+    const auto size = static_cast<std::uint64_t>(cache.data.size() - offset);
+    cache.spans.emplace_back(SubtreeCache::Span{ this, offset, size, false });
+    if (withSubtreeSizes) {
+        BE::getBytes(size, cache.data.data() + sizeOffset);
     }
 }
 
@@ -449,6 +991,15 @@ AccountEntry::AccountEntry(const string &label, NodeEntry *parent)
  * \brief Constructs a new account entry which is deserialized from the specified \a stream.
  */
 AccountEntry::AccountEntry(istream &stream)
+    : AccountEntry(stream, nullptr)
+{
+}
+
+/*!
+ * \brief Constructs a new account entry which is deserialized from the specified \a stream.
+ * \param shapes Specifies the field shapes defined by previous siblings. Shapes defined by this account are appended.
+ */
+AccountEntry::AccountEntry(istream &stream, std::vector<FieldShape> *shapes)
 {
     BinaryReader reader(&stream);
     std::uint8_t version = reader.readByte();
@@ -456,16 +1007,49 @@ AccountEntry::AccountEntry(istream &stream)
         throw ParsingException("Account entry expected.");
     }
     version ^= 0x80; // set first bit to zero
-    if (version != 0x0 && version != 0x1) {
+    if (version != 0x0 && version != 0x1 && version != 0x2) {
         throw ParsingException("Entry version not supported.");
     }
     setLabel(reader.readLengthPrefixedString());
-    // read extended header for version 0x1
-    if (version == 0x1) {
+    // read extended header for version 0x1 and 0x2
+    if (version >= 0x1) {
         const std::uint16_t extendedHeaderSize = reader.readUInt16BE();
         // currently there's nothing to read here
         m_extendedData = reader.readString(extendedHeaderSize);
     }
+
+    // read fields referring to a shape for version 0x2
+    if (version == 0x2) {
+        auto ownShapes = std::vector<FieldShape>();
+        auto &knownShapes = shapes ? *shapes : ownShapes;
+        const auto shapeIndex = reader.readUInt32BE();
+        if (shapeIndex == knownShapes.size()) {
+            auto &shape = knownShapes.emplace_back();
+            for (auto fieldCount = reader.readUInt32BE(); fieldCount; --fieldCount) {
+                auto name = reader.readLengthPrefixedString();
+                shape.emplace_back(name.empty() ? nullptr : make_shared<const string>(std::move(name)));
+            }
+        } else if (shapeIndex > knownShapes.size()) {
+            throw ParsingException("Field shape is not defined.");
+        }
+        const auto &shape = knownShapes[shapeIndex];
+        m_fields.reserve(shape.size());
+        for (const auto &name : shape) {
+            auto &field = m_fields.emplace_back(this);
+            field.m_name = name;
+            field.m_value = reader.readLengthPrefixedString();
+            const auto typeAndFlags = reader.readByte();
+            if (!Field::isValidType(typeAndFlags & 0x7F)) {
+                throw ParsingException("Field type is not supported.");
+            }
+            field.m_type = static_cast<FieldType>(typeAndFlags & 0x7F);
+            if (typeAndFlags & 0x80) {
+                field.m_extendedData = reader.readString(reader.readUInt16BE());
+            }
+        }
+        return;
+    }
+
     const std::uint32_t fieldCount = reader.readUInt32BE();
     for (std::uint32_t i = 0; i != fieldCount; ++i) {
         m_fields.push_back(Field(this, stream));
@@ -479,8 +1063,11 @@ AccountEntry::AccountEntry(istream &stream)
  */
 AccountEntry::AccountEntry(const AccountEntry &other)
     : Entry(other)
+    , m_fields(other.m_fields)
 {
-    m_fields = other.m_fields;
+    for (auto &field : m_fields) {
+        field.m_tiedAccount = this;
+    }
 }
 
 /*!
@@ -490,9 +1077,91 @@ AccountEntry::~AccountEntry()
 {
 }
 
-void AccountEntry::make(ostream &stream) const
+/*!
+ * \brief Appends a copy of the specified \a field which is tied to this account.
+ * \returns Returns the added field.
+ * \remarks Marks the account as modified (see markAsModified()).
+ */
+Field &AccountEntry::addField(const Field &field)
+{
+    markAsModified();
+    auto &addedField = m_fields.emplace_back(field);
+    addedField.m_tiedAccount = this;
+    return addedField;
+}
+
+/*!
+ * \brief Replaces the field at the specified \a index with a copy of the specified \a field which is tied to this account.
+ * \remarks Marks the account as modified (see markAsModified()). Does nothing if \a index is out of range.
+ */
+void AccountEntry::replaceField(std::size_t index, const Field &field)
+{
+    if (index >= m_fields.size()) {
+        return;
+    }
+    markAsModified();
+    auto &replacedField = m_fields[index];
+    replacedField = field;
+    replacedField.m_tiedAccount = this;
+}
+
+/*!
+ * \brief Removes the field at the specified \a index.
+ * \remarks Marks the account as modified (see markAsModified()). Does nothing if \a index is out of range.
+ */
+void AccountEntry::removeField(std::size_t index)
+{
+    if (index >= m_fields.size()) {
+        return;
+    }
+    markAsModified();
+    m_fields.erase(m_fields.begin() + static_cast<std::vector<Field>::difference_type>(index));
+}
+
+void AccountEntry::make(ostream &stream, EntrySerializationFlags flags) const
+{
+    auto shapes = FieldShapeIndex();
+    make(stream, flags, shapes);
+}
+
+/*!
+ * \brief Serializes the entry to the specified \a stream.
+ * \param shapes Specifies the field shapes defined by previous siblings. Shapes defined by this account are added.
+ */
+void AccountEntry::make(ostream &stream, EntrySerializationFlags flags, FieldShapeIndex &shapes) const
 {
     BinaryWriter writer(&stream);
+    if (flags & EntrySerializationFlags::FieldShapes) {
+        writer.writeByte(0x82); // version
+        writer.writeLengthPrefixedString(label());
+        writer.writeUInt16BE(static_cast<std::uint16_t>(m_extendedData.size()));
+        writer.writeString(m_extendedData);
+
+        // refer to the shape of the fields; define it if it is used for the first time within the node
+        auto shape = std::vector<std::string_view>();
+        shape.reserve(m_fields.size());
+        for (const Field &field : m_fields) {
+            shape.emplace_back(field.name());
+        }
+        const auto [index, isNew] = shapes.indices.emplace(std::move(shape), static_cast<std::uint32_t>(shapes.indices.size()));
+        writer.writeUInt32BE(index->second);
+        if (isNew) {
+            writer.writeUInt32BE(static_cast<std::uint32_t>(m_fields.size()));
+            for (const Field &field : m_fields) {
+                writer.writeLengthPrefixedString(field.name());
+            }
+        }
+        for (const Field &field : m_fields) {
+            writer.writeLengthPrefixedString(field.value());
+            writer.writeByte(static_cast<std::uint8_t>(static_cast<std::uint8_t>(field.type()) | (field.m_extendedData.empty() ? 0x00 : 0x80)));
+            if (!field.m_extendedData.empty()) {
+                writer.writeUInt16BE(static_cast<std::uint16_t>(field.m_extendedData.size()));
+                writer.writeString(field.m_extendedData);
+            }
+        }
+        return;
+    }
+
     writer.writeByte(0x80 | (m_extendedData.empty() ? 0x0 : 0x1)); // version
     writer.writeLengthPrefixedString(label());
     if (!m_extendedData.empty()) {
@@ -505,6 +1174,49 @@ void AccountEntry::make(ostream &stream) const
     }
 }
 
+/*!
+ * \brief Returns the number of bytes make() would write.
+ */
+std::uint64_t AccountEntry::serializedSize(EntrySerializationFlags flags) const
+{
+    auto shapes = FieldShapeIndex();
+    return serializedSize(flags, shapes);
+}
+
+/*!
+ * \brief Returns the number of bytes make() would write considering the field shapes of the accounts serialized before
+ *        within the same node.
+ * \remarks Adds the shape of the fields to \a shapes if it is used for the first time.
+ */
+std::uint64_t AccountEntry::serializedSize(EntrySerializationFlags flags, FieldShapeIndex &shapes) const
+{
+    auto size = std::uint64_t(1) + Field::serializedSize(label());
+    if (flags & EntrySerializationFlags::FieldShapes) {
+        size += 2 + m_extendedData.size() + 4;
+        auto shape = std::vector<std::string_view>();
+        shape.reserve(m_fields.size());
+        for (const Field &field : m_fields) {
+            shape.emplace_back(field.name());
+        }
+        if (shapes.indices.emplace(std::move(shape), static_cast<std::uint32_t>(shapes.indices.size())).second) {
+            size += 4;
+            for (const Field &field : m_fields) {
+                size += Field::serializedSize(field.name());
+            }
+        }
+        for (const Field &field : m_fields) {
+            size += Field::serializedSize(field.value()) + 1 + (field.m_extendedData.empty() ? 0 : 2 + field.m_extendedData.size());
+        }
+        return size;
+    }
+
+    size += (m_extendedData.empty() ? 0 : 2 + m_extendedData.size()) + 4;
+    for (const Field &field : m_fields) {
+        size += field.serializedSize();
+    }
+    return size;
+}
+
 AccountEntry *AccountEntry::clone() const
 {
     return new AccountEntry(*this);
@@ -3,9 +3,14 @@
 
 #include "./field.h"
 
+#include <c++utilities/misc/flagenumclass.h>
+
+#include <atomic>
 #include <cstdint>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -19,6 +24,19 @@ enum class EntryType : int {
     Account /**< denotes an AccountEntry */
 };
 
+/*!
+ * \brief Specifies options for serializing entries.
+ */
+enum class EntrySerializationFlags : std::uint64_t {
+    None = 0, /**< serialize node entries in the most compatible format */
+    SubtreeSizes = 1, /**< store the size of the children of node entries so they can be skipped when parsing (NodeEntry version 0x2) */
+    FieldShapes = 2, /**< store the field names of accounts only once per node for all accounts with the same names (AccountEntry version 0x2) */
+    CacheSubtrees = 4, /**< keep the serialized children of node entries to copy them as-is when serializing again (until modified) */
+};
+
+struct FieldShapeIndex;
+struct SubtreeCache;
+
 struct EntryStatistics {
     std::size_t nodeCount = 0;
     std::size_t accountCount = 0;
@@ -29,6 +47,8 @@ class NodeEntry;
 
 class PASSWORD_FILE_EXPORT Entry {
     friend class NodeEntry;
+    friend class EntryParser;
+    friend class PersistentEntry;
 
 public:
     virtual ~Entry();
@@ -37,13 +57,15 @@ public:
     const std::string &label() const;
     void setLabel(const std::string &label);
     void makeLabelUnique();
+    void markAsModified();
     NodeEntry *parent() const;
     void setParent(NodeEntry *parent, int index = -1);
     int index() const;
     bool isIndirectChildOf(const NodeEntry *entry) const;
     std::list<std::string> path() const;
     void path(std::list<std::string> &res) const;
-    virtual void make(std::ostream &stream) const = 0;
+    virtual void make(std::ostream &stream, EntrySerializationFlags flags = EntrySerializationFlags::None) const = 0;
+    virtual std::uint64_t serializedSize(EntrySerializationFlags flags = EntrySerializationFlags::None) const = 0;
     virtual Entry *clone() const = 0;
     EntryStatistics computeStatistics() const;
     virtual void accumulateStatistics(EntryStatistics &stats) const = 0;
@@ -81,6 +103,7 @@ inline void Entry::setLabel(const std::string &label)
 {
     m_label = label;
     makeLabelUnique();
+    markAsModified();
 }
 
 /*!
@@ -113,6 +136,8 @@ inline EntryStatistics Entry::computeStatistics() const
 
 class PASSWORD_FILE_EXPORT NodeEntry : public Entry {
     friend class Entry;
+    friend class EntryParser;
+    friend struct SubtreeCache;
 
 public:
     NodeEntry();
@@ -123,17 +148,46 @@ public:
 
     EntryType type() const override;
     const std::vector<Entry *> &children() const;
+    bool hasDeferredChildren() const;
+    bool hasCachedChildren() const;
+    void parseDeferredChildren() const;
+    void parseDeferredDescendants(std::size_t threadCount = 1) const;
     void deleteChildren(int begin, int end);
     void replaceChild(std::size_t at, Entry *newChild);
     Entry *entryByPath(std::list<std::string> &path, bool includeThis = true, const EntryType *creationType = nullptr);
     bool isExpandedByDefault() const;
     void setExpandedByDefault(bool expandedByDefault);
-    void make(std::ostream &stream) const override;
+    void make(std::ostream &stream, EntrySerializationFlags flags = EntrySerializationFlags::None) const override;
+    std::uint64_t serializedSize(EntrySerializationFlags flags = EntrySerializationFlags::None) const override;
     NodeEntry *clone() const override;
     void accumulateStatistics(EntryStatistics &stats) const override;
 
 private:
+    /// \brief The SerializedChildren struct holds the deferred or cached children of a node (see serializedChildren()).
+    struct SerializedChildren {
+        std::shared_ptr<const char> data;
+        std::uint64_t size = 0;
+        bool deferred = false;
+    };
+
+    bool parseDeferredData(bool lazily) const;
+    SerializedChildren serializedChildren(EntrySerializationFlags flags) const;
+    void markChildrenAsModified();
+    void makeHeader(std::ostream &stream, EntrySerializationFlags flags) const;
+    std::uint64_t headerSize(EntrySerializationFlags flags) const;
+    std::uint64_t childrenSize(EntrySerializationFlags flags) const;
+    void makeChildren(std::ostream &stream, EntrySerializationFlags flags) const;
+    void makeCached(SubtreeCache &cache, EntrySerializationFlags flags) const;
+
     std::vector<Entry *> m_children;
+    mutable std::shared_ptr<const char> m_deferredChildren;
+    std::uint64_t m_deferredSize;
+    std::uint32_t m_deferredCount;
+    mutable std::shared_ptr<const char> m_cachedChildren;
+    mutable std::uint64_t m_cachedSize;
+    mutable EntrySerializationFlags m_cachedFlags;
+    mutable std::atomic<bool> m_hasDeferredChildren;
+    mutable std::mutex m_mutex;
     bool m_expandedByDefault;
 };
 
@@ -142,11 +196,39 @@ inline EntryType NodeEntry::type() const
     return EntryType::Node;
 }
 
+/*!
+ * \brief Returns the children.
+ * \remarks Parses deferred children first. So this might throw a ParsingException when the node has been loaded
+ *          lazily (see parseDeferredChildren()).
+ */
 inline const std::vector<Entry *> &NodeEntry::children() const
 {
+    if (m_hasDeferredChildren.load(std::memory_order_acquire)) {
+        parseDeferredChildren();
+    }
     return m_children;
 }
 
+/*!
+ * \brief Returns whether the children have not been parsed yet.
+ * \sa parseDeferredChildren()
+ */
+inline bool NodeEntry::hasDeferredChildren() const
+{
+    return m_hasDeferredChildren.load(std::memory_order_acquire);
+}
+
+/*!
+ * \brief Returns whether the serialized children are cached because they have not been modified since the last time
+ *        they have been serialized (or parsed lazily).
+ * \sa EntrySerializationFlags::CacheSubtrees
+ */
+inline bool NodeEntry::hasCachedChildren() const
+{
+    const auto lock = std::lock_guard<std::mutex>(m_mutex);
+    return m_cachedChildren != nullptr;
+}
+
 inline bool NodeEntry::isExpandedByDefault() const
 {
     return m_expandedByDefault;
@@ -155,6 +237,7 @@ inline bool NodeEntry::isExpandedByDefault() const
 inline void NodeEntry::setExpandedByDefault(bool expandedByDefault)
 {
     m_expandedByDefault = expandedByDefault;
+    markAsModified();
 }
 
 inline bool Entry::denotesNodeEntry(std::uint8_t version)
@@ -168,6 +251,9 @@ constexpr EntryType Entry::denotedEntryType(std::uint8_t version)
 }
 
 class PASSWORD_FILE_EXPORT AccountEntry : public Entry {
+    friend class NodeEntry;
+    friend class EntryParser;
+
 public:
     AccountEntry();
     AccountEntry(const std::string &label, NodeEntry *parent = nullptr);
@@ -178,11 +264,19 @@ public:
     EntryType type() const override;
     const std::vector<Field> &fields() const;
     std::vector<Field> &fields();
-    void make(std::ostream &stream) const override;
+    Field &addField(const Field &field);
+    void replaceField(std::size_t index, const Field &field);
+    void removeField(std::size_t index);
+    void make(std::ostream &stream, EntrySerializationFlags flags = EntrySerializationFlags::None) const override;
+    std::uint64_t serializedSize(EntrySerializationFlags flags = EntrySerializationFlags::None) const override;
     AccountEntry *clone() const override;
     void accumulateStatistics(EntryStatistics &stats) const override;
 
 private:
+    AccountEntry(std::istream &stream, std::vector<FieldShape> *shapes);
+    void make(std::ostream &stream, EntrySerializationFlags flags, FieldShapeIndex &shapes) const;
+    std::uint64_t serializedSize(EntrySerializationFlags flags, FieldShapeIndex &shapes) const;
+
     std::vector<Field> m_fields;
 };
 
@@ -196,10 +290,18 @@ inline const std::vector<Field> &AccountEntry::fields() const
     return m_fields;
 }
 
+/*!
+ * \brief Returns the fields for modification.
+ * \remarks Marks the account as modified (see markAsModified()) because the fields might be modified via the returned
+ *          vector. Use the const overload to only read the fields.
+ */
 inline std::vector<Field> &AccountEntry::fields()
 {
+    markAsModified();
     return m_fields;
 }
 } // namespace Io
 
+CPP_UTILITIES_MARK_FLAG_ENUM_CLASS(Io, Io::EntrySerializationFlags);
+
 #endif // PASSWORD_FILE_IO_ENTRY_H
@@ -0,0 +1,373 @@
+#include "./entryparser.h"
+#include "./entry.h"
+#include "./parsingexception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace Io {
+
+/// \brief The maximum number of elements to reserve space for based on counts read from the data.
+constexpr std::uint32_t maxReservation = 0x400;
+
+/// \brief The maximum number of different field names to share between fields.
+constexpr std::size_t maxFieldNames = 0x1000;
+
+/*!
+ * \class EntryParser
+ * \brief The EntryParser class deserializes entries from a contiguous buffer.
+ *
+ * In contrast to the constructors taking an std::istream, the parser reads directly from the buffer (only checking
+ * bounds) and the strings are constructed directly from the buffer as well. The hierarchy is built using an explicit
+ * stack instead of recursion so deeply nested entries don't exhaust the call stack.
+ *
+ * The parser can also read from an std::streambuf. Then it fills an internal window of windowSize bytes from that
+ * source whenever the data at the current position is exhausted. Reading from the source directly in chunks avoids
+ * the per-read overhead of std::istream while still only holding a fixed amount of the data in memory.
+ *
+ * Field names are shared between all fields with the same name parsed by the same parser instance.
+ *
+ * When the parser operates on a shared buffer, it defers parsing the children of node entries which denote the size of
+ * their children (NodeEntry version 0x2). Those nodes keep a reference to the buffer and their children are parsed when
+ * accessed for the first time (see NodeEntry::parseDeferredChildren()).
+ */
+
+/*!
+ * \brief Constructs a new parser for the specified \a data. The \a data must outlive the parser.
+ */
+EntryParser::EntryParser(const char *data, std::size_t size)
+    : m_pos(data)
+    , m_end(data + size)
+    , m_source(nullptr)
+{
+}
+
+/*!
+ * \brief Constructs a new parser for the specified shared \a data which parses the children of nodes lazily.
+ * \remarks Node entries for which parsing the children has been deferred keep the \a data alive.
+ */
+EntryParser::EntryParser(std::shared_ptr<const char> data, std::size_t size)
+    : m_pos(data.get())
+    , m_end(data.get() + size)
+    , m_source(nullptr)
+    , m_sharedData(std::move(data))
+{
+}
+
+/*!
+ * \brief Constructs a new parser reading from the specified \a source.
+ * \remarks The parser reads ahead so the \a source might be read further than the parsed data extends.
+ */
+EntryParser::EntryParser(std::streambuf *source)
+    : m_pos(nullptr)
+    , m_end(nullptr)
+    , m_source(source)
+{
+}
+
+/*!
+ * \brief Reads a string of the specified \a size.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+std::string EntryParser::readString(std::size_t size)
+{
+    const auto available = static_cast<std::size_t>(m_end - m_pos);
+    if (size <= available) {
+        auto res = std::string(m_pos, size);
+        m_pos += size;
+        return res;
+    }
+    if (!m_source) {
+        throw ParsingException("The file seems to be truncated.");
+    }
+
+    // copy what's left in the window and read the rest directly from the source
+    auto res = std::string(size, '\0');
+    std::memcpy(res.data(), m_pos, available);
+    m_pos = m_end;
+    const auto missing = static_cast<std::streamsize>(size - available);
+    if (m_source->sgetn(res.data() + available, missing) != missing) {
+        throw ParsingException("The file seems to be truncated.");
+    }
+    return res;
+}
+
+/*!
+ * \brief Reads a string prefixed with its length (in the format used by CppUtilities::BinaryWriter::writeLengthPrefixedString()).
+ * \throws Throws ParsingException if the data is truncated or the length denotation is invalid.
+ */
+std::string EntryParser::readLengthPrefixedString()
+{
+    static constexpr std::size_t maxPrefixLength = 4;
+    require(1);
+    const auto firstByte = static_cast<std::uint8_t>(*m_pos);
+    auto prefixLength = std::size_t(1);
+    auto mask = std::uint8_t(0x80);
+    for (; prefixLength <= maxPrefixLength && !(firstByte & mask); ++prefixLength, mask >>= 1)
+        ;
+    if (prefixLength > maxPrefixLength) {
+        throw ParsingException("Length denotation of length-prefixed string exceeds maximum.");
+    }
+    require(prefixLength);
+    auto size = static_cast<std::size_t>(static_cast<std::uint8_t>(*m_pos) ^ mask);
+    for (auto i = std::size_t(1); i != prefixLength; ++i) {
+        size = (size << 8) | static_cast<std::uint8_t>(m_pos[i]);
+    }
+    m_pos += prefixLength;
+    return readString(size);
+}
+
+/*!
+ * \brief Reads a field name and returns the name shared with previously read fields of the same name.
+ * \returns Returns the name or nullptr if it is empty.
+ * \throws Throws ParsingException if the data is truncated or the length denotation is invalid.
+ */
+std::shared_ptr<const std::string> EntryParser::readFieldName()
+{
+    auto name = readLengthPrefixedString();
+    if (name.empty()) {
+        return nullptr;
+    }
+    if (const auto i = m_fieldNames.find(name); i != m_fieldNames.end()) {
+        return i->second;
+    }
+    auto sharedName = make_shared<const std::string>(std::move(name));
+    if (m_fieldNames.size() < maxFieldNames) {
+        m_fieldNames.emplace(*sharedName, sharedName);
+    }
+    return sharedName;
+}
+
+/*!
+ * \brief Parses an entry including its descendants.
+ * \returns Returns the parsed entry. The caller takes ownership.
+ * \throws Throws ParsingException when a parsing error occurs.
+ */
+Entry *EntryParser::parseEntry()
+{
+    auto childCount = std::uint32_t();
+    auto shapes = std::vector<FieldShape>();
+    auto root = std::unique_ptr<Entry>(parseEntryWithoutChildren(childCount, shapes));
+    if (childCount) {
+        parseChildren(static_cast<NodeEntry *>(root.get()), childCount);
+    }
+    return root.release();
+}
+
+/*!
+ * \brief Parses a node entry including its descendants.
+ * \returns Returns the parsed entry. The caller takes ownership.
+ * \throws Throws ParsingException when a parsing error occurs, e.g. the entry is not a node entry.
+ */
+NodeEntry *EntryParser::parseNodeEntry()
+{
+    auto entry = std::unique_ptr<Entry>(parseEntry());
+    if (entry->type() != EntryType::Node) {
+        throw ParsingException("Node entry expected.");
+    }
+    return static_cast<NodeEntry *>(entry.release());
+}
+
+/*!
+ * \brief Parses the specified number of entries including their descendants and appends them to \a node.
+ * \remarks The \a node is supposed to have no children yet.
+ * \throws Throws ParsingException when a parsing error occurs. The children parsed so far remain attached to
+ *          \a node in this case.
+ */
+void EntryParser::parseChildren(NodeEntry *node, std::uint32_t childCount)
+{
+    struct Level {
+        NodeEntry *node;
+        std::uint32_t remainingChildren;
+        std::unordered_set<std::string_view> labels;
+        std::vector<FieldShape> shapes;
+    };
+
+    auto stack = std::vector<Level>();
+    if (childCount) {
+        stack.emplace_back(Level{ node, childCount, {}, {} });
+    }
+    while (!stack.empty()) {
+        if (!stack.back().remainingChildren) {
+            stack.pop_back();
+            continue;
+        }
+        auto &level = stack.back();
+        --level.remainingChildren;
+
+        // attach the child directly without going through Entry::setParent() which would compare the label against
+        // all siblings; labels are only made unique if they are not already
+        auto child = std::unique_ptr<Entry>(parseEntryWithoutChildren(childCount, level.shapes));
+        auto &siblings = level.node->m_children;
+        if (siblings.empty()) {
+            level.labels.reserve(std::min(level.remainingChildren + 1, maxReservation));
+        }
+        child->m_parent = level.node;
+        child->m_index = static_cast<int>(siblings.size());
+        siblings.emplace_back(child.get());
+        auto *const entry = child.release();
+        if (!level.labels.emplace(entry->m_label).second) {
+            entry->makeLabelUnique();
+            level.labels.emplace(entry->m_label);
+        }
+        if (childCount) {
+            stack.emplace_back(Level{ static_cast<NodeEntry *>(entry), childCount, {}, {} });
+        }
+    }
+}
+
+/*!
+ * \brief Returns whether all data has been consumed.
+ */
+bool EntryParser::isAtEnd()
+{
+    return m_pos == m_end && (!m_source || m_source->sgetc() == std::streambuf::traits_type::eof());
+}
+
+/*!
+ * \brief Parses a single entry.
+ *
+ * Fields of account entries are parsed as well. Children of node entries are not parsed; their number is
+ * returned via \a childCount instead. The \a shapes are the field shapes defined by previous siblings; shapes
+ * defined by the entry are appended.
+ *
+ * \returns Returns the parsed entry. The caller takes ownership.
+ */
+Entry *EntryParser::parseEntryWithoutChildren(std::uint32_t &childCount, std::vector<FieldShape> &shapes)
+{
+    auto version = readByte();
+    if (Entry::denotesNodeEntry(version)) {
+        if (version != 0x0 && version != 0x1 && version != 0x2) {
+            throw ParsingException("Entry version not supported.");
+        }
+        auto node = make_unique<NodeEntry>();
+        node->m_label = readLengthPrefixedString();
+        // read extended header for version 0x1 and 0x2
+        if (version >= 0x1) {
+            auto extendedHeaderSize = readUInt16BE();
+            if (extendedHeaderSize >= 1) {
+                node->m_expandedByDefault = readByte() & 0x80;
+                extendedHeaderSize -= 1;
+            }
+            node->m_extendedData = readString(extendedHeaderSize);
+        }
+        childCount = readUInt32BE();
+        if (version != 0x2) {
+            return node.release();
+        }
+        // defer parsing the children when operating on a shared buffer; just skip them for now
+        const auto childrenSize = readUInt64BE();
+        if (m_sharedData && childCount) {
+            if (childrenSize > static_cast<std::uint64_t>(m_end - m_pos)) {
+                throw ParsingException("The file seems to be truncated.");
+            }
+            node->m_deferredChildren = std::shared_ptr<const char>(m_sharedData, m_pos);
+            node->m_deferredSize = childrenSize;
+            node->m_deferredCount = childCount;
+            node->m_hasDeferredChildren = true;
+            m_pos += childrenSize;
+            childCount = 0;
+        }
+        return node.release();
+    }
+
+    version ^= 0x80; // set first bit to zero
+    if (version != 0x0 && version != 0x1 && version != 0x2) {
+        throw ParsingException("Entry version not supported.");
+    }
+    auto account = make_unique<AccountEntry>();
+    account->m_label = readLengthPrefixedString();
+    // read extended header for version 0x1 and 0x2
+    if (version >= 0x1) {
+        account->m_extendedData = readString(readUInt16BE());
+    }
+    childCount = 0;
+
+    // read fields referring to a shape for version 0x2
+    if (version == 0x2) {
+        const auto shapeIndex = readUInt32BE();
+        if (shapeIndex == shapes.size()) {
+            auto &shape = shapes.emplace_back();
+            const auto fieldCount = readUInt32BE();
+            shape.reserve(std::min(fieldCount, maxReservation));
+            for (auto i = std::uint32_t(); i != fieldCount; ++i) {
+                shape.emplace_back(readFieldName());
+            }
+        } else if (shapeIndex > shapes.size()) {
+            throw ParsingException("Field shape is not defined.");
+        }
+        const auto &shape = shapes[shapeIndex];
+        auto &fields = account->m_fields;
+        fields.reserve(shape.size());
+        for (const auto &name : shape) {
+            auto &field = fields.emplace_back();
+            field.m_name = name;
+            field.m_value = readLengthPrefixedString();
+            const auto typeAndFlags = readByte();
+            if (!Field::isValidType(typeAndFlags & 0x7F)) {
+                throw ParsingException("Field type is not supported.");
+            }
+            field.m_type = static_cast<FieldType>(typeAndFlags & 0x7F);
+            if (typeAndFlags & 0x80) {
+                field.m_extendedData = readString(readUInt16BE());
+            }
+            field.m_tiedAccount = account.get();
+        }
+        return account.release();
+    }
+
+    const auto fieldCount = readUInt32BE();
+    auto &fields = account->m_fields;
+    fields.reserve(std::min(fieldCount, maxReservation));
+    for (auto i = std::uint32_t(); i != fieldCount; ++i) {
+        auto &field = fields.emplace_back();
+        const auto fieldVersion = readByte();
+        if (fieldVersion != 0x0 && fieldVersion != 0x1) {
+            throw ParsingException("Field version is not supported.");
+        }
+        field.m_name = readFieldName();
+        field.m_value = readLengthPrefixedString();
+        const auto type = readByte();
+        if (!Field::isValidType(type)) {
+            throw ParsingException("Field type is not supported.");
+        }
+        field.m_type = static_cast<FieldType>(type);
+        // read extended header for version 0x1
+        if (fieldVersion == 0x1) {
+            field.m_extendedData = readString(readUInt16BE());
+        }
+        field.m_tiedAccount = account.get();
+    }
+    return account.release();
+}
+
+/*!
+ * \brief Refills the window from the source so at least \a size bytes are available.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+void EntryParser::refill(std::size_t size)
+{
+    if (!m_source) {
+        throw ParsingException("The file seems to be truncated.");
+    }
+    if (!m_window) {
+        m_window = make_unique<char[]>(windowSize);
+    }
+    const auto available = static_cast<std::size_t>(m_end - m_pos);
+    if (available) {
+        std::memmove(m_window.get(), m_pos, available);
+    }
+    const auto bytesRead = m_source->sgetn(m_window.get() + available, static_cast<std::streamsize>(windowSize - available));
+    m_pos = m_window.get();
+    m_end = m_pos + available + static_cast<std::size_t>(std::max<std::streamsize>(bytesRead, 0));
+    if (static_cast<std::size_t>(m_end - m_pos) < size) {
+        throw ParsingException("The file seems to be truncated.");
+    }
+}
+
+} // namespace Io
@@ -0,0 +1,113 @@
+#ifndef PASSWORD_FILE_IO_ENTRYPARSER_H
+#define PASSWORD_FILE_IO_ENTRYPARSER_H
+
+#include "./field.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Io {
+
+class Entry;
+class NodeEntry;
+
+class PASSWORD_FILE_EXPORT EntryParser {
+public:
+    static constexpr std::size_t windowSize = 0x10000;
+
+    explicit EntryParser(const char *data, std::size_t size);
+    explicit EntryParser(std::shared_ptr<const char> data, std::size_t size);
+    explicit EntryParser(std::streambuf *source);
+
+    std::uint8_t readByte();
+    std::uint16_t readUInt16BE();
+    std::uint32_t readUInt32BE();
+    std::uint64_t readUInt64BE();
+    std::string readString(std::size_t size);
+    std::string readLengthPrefixedString();
+    std::shared_ptr<const std::string> readFieldName();
+    Entry *parseEntry();
+    NodeEntry *parseNodeEntry();
+    void parseChildren(NodeEntry *node, std::uint32_t childCount);
+    bool isAtEnd();
+
+private:
+    void require(std::size_t size);
+    void refill(std::size_t size);
+    Entry *parseEntryWithoutChildren(std::uint32_t &childCount, std::vector<FieldShape> &shapes);
+
+    const char *m_pos;
+    const char *m_end;
+    std::streambuf *m_source;
+    std::unique_ptr<char[]> m_window;
+    std::shared_ptr<const char> m_sharedData;
+    std::unordered_map<std::string_view, std::shared_ptr<const std::string>> m_fieldNames;
+};
+
+/*!
+ * \brief Ensures at least \a size bytes are available at the current position.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+inline void EntryParser::require(std::size_t size)
+{
+    if (static_cast<std::size_t>(m_end - m_pos) < size) {
+        refill(size);
+    }
+}
+
+/*!
+ * \brief Reads a single byte.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+inline std::uint8_t EntryParser::readByte()
+{
+    require(1);
+    return static_cast<std::uint8_t>(*m_pos++);
+}
+
+/*!
+ * \brief Reads a 16-bit big-endian integer.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+inline std::uint16_t EntryParser::readUInt16BE()
+{
+    require(2);
+    const auto value = CppUtilities::BE::toUInt16(m_pos);
+    m_pos += 2;
+    return value;
+}
+
+/*!
+ * \brief Reads a 32-bit big-endian integer.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+inline std::uint32_t EntryParser::readUInt32BE()
+{
+    require(4);
+    const auto value = CppUtilities::BE::toUInt32(m_pos);
+    m_pos += 4;
+    return value;
+}
+
+/*!
+ * \brief Reads a 64-bit big-endian integer.
+ * \throws Throws ParsingException if the data is truncated.
+ */
+inline std::uint64_t EntryParser::readUInt64BE()
+{
+    require(8);
+    const auto value = CppUtilities::BE::toUInt64(m_pos);
+    m_pos += 8;
+    return value;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_ENTRYPARSER_H
@@ -1,4 +1,5 @@
 #include "./field.h"
+#include "./entry.h"
 #include "./parsingexception.h"
 
 #include <c++utilities/io/binaryreader.h>
@@ -13,6 +14,9 @@ namespace Io {
  * \class Field
  * \brief The Field class holds field information which consists of a name and a value
  *        and is able to serialize and deserialize this information.
+ *
+ * The name is held as shared string because most accounts have fields with the same names. So copies of a field
+ * share the name and fields loaded from a file share the name with other fields of the same name.
  */
 
 /*!
@@ -20,7 +24,7 @@ namespace Io {
  *        and \a value.
  */
 Field::Field(AccountEntry *tiedAccount, const string &name, const string &value)
-    : m_name(name)
+    : m_name(name.empty() ? nullptr : make_shared<const string>(name))
     , m_value(value)
     , m_type(FieldType::Normal)
     , m_tiedAccount(tiedAccount)
@@ -33,13 +37,14 @@ Field::Field(AccountEntry *tiedAccount, const string &name, const string &value)
  * \throws Throws ParsingException when an parsing error occurs.
  */
 Field::Field(AccountEntry *tiedAccount, istream &stream)
+    : m_tiedAccount(tiedAccount)
 {
     BinaryReader reader(&stream);
     const int version = reader.readByte();
     if (version != 0x0 && version != 0x1) {
         throw ParsingException("Field version is not supported.");
     }
-    m_name = reader.readLengthPrefixedString();
+    setName(reader.readLengthPrefixedString());
     m_value = reader.readLengthPrefixedString();
     std::uint8_t type = reader.readByte();
     if (!isValidType(type)) {
@@ -52,7 +57,15 @@ Field::Field(AccountEntry *tiedAccount, istream &stream)
         // currently there's nothing to read here
         m_extendedData = reader.readString(extendedHeaderSize);
     }
-    m_tiedAccount = tiedAccount;
+}
+
+/*!
+ * \brief Returns an empty string which is used as name for fields without name.
+ */
+const std::string &Field::emptyName()
+{
+    static const auto name = std::string();
+    return name;
 }
 
 /*!
@@ -62,7 +75,7 @@ void Field::make(ostream &stream) const
 {
     BinaryWriter writer(&stream);
     writer.writeByte(m_extendedData.empty() ? 0x0 : 0x1); // version
-    writer.writeLengthPrefixedString(m_name);
+    writer.writeLengthPrefixedString(name());
     writer.writeLengthPrefixedString(m_value);
     writer.writeByte(static_cast<std::uint8_t>(m_type));
     if (!m_extendedData.empty()) {
@@ -70,4 +83,25 @@ void Field::make(ostream &stream) const
         writer.writeString(m_extendedData);
     }
 }
+
+/*!
+ * \brief Returns the number of bytes make() would write.
+ */
+std::uint64_t Field::serializedSize() const
+{
+    return 1 + serializedSize(name()) + serializedSize(m_value) + 1 + (m_extendedData.empty() ? 0 : 2 + m_extendedData.size());
+}
+
+/*!
+ * \brief Returns the number of bytes BinaryWriter::writeLengthPrefixedString() would write for \a lengthPrefixedString.
+ * \remarks The length is prefixed as variable-length integer with 7 bits per byte (and at most 8 bytes).
+ */
+std::uint64_t Field::serializedSize(const std::string &lengthPrefixedString)
+{
+    auto prefixSize = std::uint64_t(1);
+    for (auto size = static_cast<std::uint64_t>(lengthPrefixedString.size()) >> 7; size && prefixSize < 8; size >>= 7) {
+        ++prefixSize;
+    }
+    return prefixSize + lengthPrefixedString.size();
+}
 } // namespace Io
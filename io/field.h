@@ -3,8 +3,11 @@
 
 #include "../global.h"
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace Io {
 
@@ -12,7 +15,14 @@ enum class FieldType : int { Normal, Password };
 
 class AccountEntry;
 
+/// \brief The names of the fields of an account in the order they appear (shared between accounts with the same field names).
+using FieldShape = std::vector<std::shared_ptr<const std::string>>;
+
 class PASSWORD_FILE_EXPORT Field {
+    friend class AccountEntry;
+    friend class EntryParser;
+    friend class PersistentEntry;
+
 public:
     Field();
     Field(AccountEntry *tiedAccount, const std::string &name = std::string(), const std::string &value = std::string());
@@ -20,17 +30,23 @@ public:
 
     bool isEmpty() const;
     const std::string &name() const;
+    const std::shared_ptr<const std::string> &sharedName() const;
     void setName(const std::string &name);
+    void setName(std::shared_ptr<const std::string> name);
     const std::string &value() const;
     void setValue(const std::string &value);
     FieldType type() const;
     void setType(FieldType type);
     AccountEntry *tiedAccount() const;
     void make(std::ostream &stream) const;
+    std::uint64_t serializedSize() const;
     static bool isValidType(int number);
+    static std::uint64_t serializedSize(const std::string &lengthPrefixedString);
 
 private:
-    std::string m_name;
+    static const std::string &emptyName();
+
+    std::shared_ptr<const std::string> m_name;
     std::string m_value;
     FieldType m_type;
     AccountEntry *m_tiedAccount;
@@ -50,13 +66,22 @@ inline Field::Field()
  */
 inline bool Field::isEmpty() const
 {
-    return m_name.empty() && m_value.empty();
+    return name().empty() && m_value.empty();
 }
 
 /*!
  * \brief Returns the name.
  */
 inline const std::string &Field::name() const
+{
+    return m_name ? *m_name : emptyName();
+}
+
+/*!
+ * \brief Returns the name as shared string (might be nullptr if the name is empty).
+ * \remarks Fields with the same name usually share the name, e.g. fields which have been copied or loaded from a file.
+ */
+inline const std::shared_ptr<const std::string> &Field::sharedName() const
 {
     return m_name;
 }
@@ -66,7 +91,16 @@ inline const std::string &Field::name() const
  */
 inline void Field::setName(const std::string &name)
 {
-    m_name = name;
+    m_name = name.empty() ? nullptr : std::make_shared<const std::string>(name);
+}
+
+/*!
+ * \brief Sets the name to the specified shared string.
+ * \remarks Use this overload to share the name with other fields (see sharedName()).
+ */
+inline void Field::setName(std::shared_ptr<const std::string> name)
+{
+    m_name = std::move(name);
 }
 
 /*!
@@ -0,0 +1,123 @@
+#include "./flatpasswordstore.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class FlatPasswordStore
+ * \brief The FlatPasswordStore class is an immutable, read-optimized snapshot of an entry hierarchy.
+ *
+ * Instead of individually allocated objects linked via pointers, the entries are stored as a struct of arrays: the
+ * type, label, parent and the range of children/fields of each entry are kept in separate arrays indexed by the entry
+ * index. Labels, field names and field values are stored in one string pool and referred to via offsets. Equal field
+ * names are only stored once within the pool.
+ *
+ * Entries are numbered in breadth-first order so the children of a node have consecutive indices. The root entry has
+ * the index rootIndex. Fields are numbered in the order of the accounts they belong to so the fields of an account have
+ * consecutive indices as well.
+ *
+ * Looking up children by label uses binary search over a per-node index of the children sorted by label. None of the
+ * query functions allocates memory.
+ *
+ * \remarks The snapshot does not reflect modifications of the entries it has been created from.
+ */
+
+/*!
+ * \brief Constructs an empty store.
+ */
+FlatPasswordStore::FlatPasswordStore()
+{
+}
+
+/*!
+ * \brief Constructs a snapshot of \a root and all of its descendants.
+ * \remarks Children which have been deferred when loading lazily are parsed when creating the snapshot.
+ * \throws Throws ParsingException if deferred children can not be parsed.
+ * \throws Throws std::length_error if the hierarchy exceeds the supported size.
+ */
+FlatPasswordStore::FlatPasswordStore(const NodeEntry &root)
+{
+    constexpr auto maxIndex = static_cast<std::size_t>(invalidIndex);
+    unordered_map<string_view, StringRef> fieldNames;
+    const auto addString = [this](const string &str) {
+        if (m_strings.size() + str.size() >= maxIndex) {
+            throw length_error("The strings of the entries exceed the maximum size of a flat password store.");
+        }
+        const auto ref = StringRef{ static_cast<std::uint32_t>(m_strings.size()), static_cast<std::uint32_t>(str.size()) };
+        m_strings.append(str);
+        return ref;
+    };
+
+    // add the entries in breadth-first order so the children of each node have consecutive indices
+    auto entries = vector<const Entry *>{ &root };
+    m_parents.emplace_back(invalidIndex);
+    for (std::size_t index = 0; index != entries.size(); ++index) {
+        const auto *const entry = entries[index];
+        m_types.emplace_back(entry->type());
+        m_labels.emplace_back(addString(entry->label()));
+        switch (entry->type()) {
+        case EntryType::Node: {
+            const auto &children = static_cast<const NodeEntry *>(entry)->children();
+            if (entries.size() + children.size() >= maxIndex) {
+                throw length_error("The number of entries exceeds the maximum size of a flat password store.");
+            }
+            m_rangeBegins.emplace_back(static_cast<Index>(entries.size()));
+            entries.insert(entries.end(), children.cbegin(), children.cend());
+            m_rangeEnds.emplace_back(static_cast<Index>(entries.size()));
+            m_parents.insert(m_parents.end(), children.size(), static_cast<Index>(index));
+            break;
+        }
+        case EntryType::Account: {
+            const auto &fields = static_cast<const AccountEntry *>(entry)->fields();
+            if (m_fieldTypes.size() + fields.size() >= maxIndex) {
+                throw length_error("The number of fields exceeds the maximum size of a flat password store.");
+            }
+            m_rangeBegins.emplace_back(static_cast<Index>(m_fieldTypes.size()));
+            for (const auto &field : fields) {
+                auto name = fieldNames.find(field.name());
+                if (name == fieldNames.end()) {
+                    name = fieldNames.emplace(field.name(), addString(field.name())).first;
+                }
+                m_fieldNames.emplace_back(name->second);
+                m_fieldValues.emplace_back(addString(field.value()));
+                m_fieldTypes.emplace_back(field.type());
+            }
+            m_rangeEnds.emplace_back(static_cast<Index>(m_fieldTypes.size()));
+            break;
+        }
+        }
+    }
+
+    // index the children of each node by label to allow binary search
+    m_childrenByLabel.resize(entries.size());
+    for (Index index = 0, count = entryCount(); index != count; ++index) {
+        m_childrenByLabel[index] = index;
+    }
+    for (Index node = 0, count = entryCount(); node != count; ++node) {
+        if (m_types[node] != EntryType::Node) {
+            continue;
+        }
+        stable_sort(m_childrenByLabel.begin() + m_rangeBegins[node], m_childrenByLabel.begin() + m_rangeEnds[node],
+            [this](Index lhs, Index rhs) { return label(lhs) < label(rhs); });
+    }
+
+    m_strings.shrink_to_fit();
+}
+
+/*!
+ * \brief Returns the child of the specified \a node with the specified \a label.
+ * \returns Returns the entry index or invalidIndex if there's no such child.
+ */
+FlatPasswordStore::Index FlatPasswordStore::childByLabel(Index node, std::string_view label) const
+{
+    const auto begin = m_childrenByLabel.cbegin() + childrenBegin(node), end = m_childrenByLabel.cbegin() + childrenEnd(node);
+    const auto child = lower_bound(begin, end, label, [this](Index lhs, std::string_view rhs) { return this->label(lhs) < rhs; });
+    return child != end && this->label(*child) == label ? *child : invalidIndex;
+}
+
+} // namespace Io
@@ -0,0 +1,215 @@
+#ifndef PASSWORD_FILE_IO_FLATPASSWORDSTORE_H
+#define PASSWORD_FILE_IO_FLATPASSWORDSTORE_H
+
+#include "./entry.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT FlatPasswordStore {
+public:
+    using Index = std::uint32_t;
+    static constexpr Index invalidIndex = std::numeric_limits<Index>::max();
+    static constexpr Index rootIndex = 0;
+
+    explicit FlatPasswordStore();
+    explicit FlatPasswordStore(const NodeEntry &root);
+
+    bool isEmpty() const;
+    Index entryCount() const;
+    Index fieldCount() const;
+    EntryType type(Index entry) const;
+    std::string_view label(Index entry) const;
+    Index parent(Index entry) const;
+    Index childrenBegin(Index node) const;
+    Index childrenEnd(Index node) const;
+    Index fieldsBegin(Index account) const;
+    Index fieldsEnd(Index account) const;
+    std::string_view fieldName(Index field) const;
+    std::string_view fieldValue(Index field) const;
+    FieldType fieldType(Index field) const;
+    Index childByLabel(Index node, std::string_view label) const;
+    template <typename Iterator> Index entryByPath(Iterator begin, Iterator end) const;
+    Index entryByPath(std::initializer_list<std::string_view> path) const;
+    Index entryByPath(const std::list<std::string> &path) const;
+
+private:
+    struct StringRef {
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+
+    std::string_view stringView(StringRef ref) const;
+
+    std::string m_strings;
+    std::vector<EntryType> m_types;
+    std::vector<StringRef> m_labels;
+    std::vector<Index> m_parents;
+    std::vector<Index> m_rangeBegins;
+    std::vector<Index> m_rangeEnds;
+    std::vector<Index> m_childrenByLabel;
+    std::vector<StringRef> m_fieldNames;
+    std::vector<StringRef> m_fieldValues;
+    std::vector<FieldType> m_fieldTypes;
+};
+
+/*!
+ * \brief Returns whether the store contains no entries (not even a root entry).
+ */
+inline bool FlatPasswordStore::isEmpty() const
+{
+    return m_types.empty();
+}
+
+/*!
+ * \brief Returns the number of entries (including the root entry).
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::entryCount() const
+{
+    return static_cast<Index>(m_types.size());
+}
+
+/*!
+ * \brief Returns the number of fields of all accounts.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::fieldCount() const
+{
+    return static_cast<Index>(m_fieldTypes.size());
+}
+
+/*!
+ * \brief Returns the type of the specified \a entry.
+ */
+inline EntryType FlatPasswordStore::type(Index entry) const
+{
+    return m_types[entry];
+}
+
+/*!
+ * \brief Returns the string for the specified \a ref.
+ */
+inline std::string_view FlatPasswordStore::stringView(StringRef ref) const
+{
+    return std::string_view(m_strings.data() + ref.offset, ref.size);
+}
+
+/*!
+ * \brief Returns the label of the specified \a entry.
+ */
+inline std::string_view FlatPasswordStore::label(Index entry) const
+{
+    return stringView(m_labels[entry]);
+}
+
+/*!
+ * \brief Returns the parent of the specified \a entry or invalidIndex for the root entry.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::parent(Index entry) const
+{
+    return m_parents[entry];
+}
+
+/*!
+ * \brief Returns the index of the first child of the specified \a node.
+ * \remarks The children of a node have consecutive indices. Returns childrenEnd() for accounts.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::childrenBegin(Index node) const
+{
+    return m_types[node] == EntryType::Node ? m_rangeBegins[node] : m_rangeEnds[node];
+}
+
+/*!
+ * \brief Returns the index after the last child of the specified \a node.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::childrenEnd(Index node) const
+{
+    return m_rangeEnds[node];
+}
+
+/*!
+ * \brief Returns the index of the first field of the specified \a account.
+ * \remarks The fields of an account have consecutive indices. Returns fieldsEnd() for nodes.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::fieldsBegin(Index account) const
+{
+    return m_types[account] == EntryType::Account ? m_rangeBegins[account] : m_rangeEnds[account];
+}
+
+/*!
+ * \brief Returns the index after the last field of the specified \a account.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::fieldsEnd(Index account) const
+{
+    return m_rangeEnds[account];
+}
+
+/*!
+ * \brief Returns the name of the specified \a field.
+ */
+inline std::string_view FlatPasswordStore::fieldName(Index field) const
+{
+    return stringView(m_fieldNames[field]);
+}
+
+/*!
+ * \brief Returns the value of the specified \a field.
+ */
+inline std::string_view FlatPasswordStore::fieldValue(Index field) const
+{
+    return stringView(m_fieldValues[field]);
+}
+
+/*!
+ * \brief Returns the type of the specified \a field.
+ */
+inline FieldType FlatPasswordStore::fieldType(Index field) const
+{
+    return m_fieldTypes[field];
+}
+
+/*!
+ * \brief Returns the entry specified by the labels within the range from \a begin to \a end.
+ * \remarks The first label refers to the root entry (like NodeEntry::entryByPath() with includeThis set).
+ * \returns Returns the entry index or invalidIndex if there's no such entry.
+ */
+template <typename Iterator> FlatPasswordStore::Index FlatPasswordStore::entryByPath(Iterator begin, Iterator end) const
+{
+    if (begin == end || isEmpty() || label(rootIndex) != std::string_view(*begin)) {
+        return invalidIndex;
+    }
+    auto entry = rootIndex;
+    for (++begin; begin != end && entry != invalidIndex; ++begin) {
+        entry = childByLabel(entry, std::string_view(*begin));
+    }
+    return entry;
+}
+
+/*!
+ * \brief Returns the entry specified by the labels of the \a path.
+ * \remarks The first label refers to the root entry (like NodeEntry::entryByPath() with includeThis set).
+ * \returns Returns the entry index or invalidIndex if there's no such entry.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::entryByPath(std::initializer_list<std::string_view> path) const
+{
+    return entryByPath(path.begin(), path.end());
+}
+
+/*!
+ * \brief Returns the entry specified by the labels of the \a path.
+ * \remarks The first label refers to the root entry (like NodeEntry::entryByPath() with includeThis set).
+ * \returns Returns the entry index or invalidIndex if there's no such entry.
+ */
+inline FlatPasswordStore::Index FlatPasswordStore::entryByPath(const std::list<std::string> &path) const
+{
+    return entryByPath(path.begin(), path.end());
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_FLATPASSWORDSTORE_H
@@ -0,0 +1,418 @@
+#include "./keyderivation.h"
+#include "./cryptoexception.h"
+#include "./derivedkeycache.h"
+
+#include "../util/concurrency.h"
+#include "../util/openssl.h"
+#include "../util/opensslrandomdevice.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#include <openssl/kdf.h>
+#include <openssl/params.h>
+#include <openssl/thread.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace Io {
+
+/// \brief The size of the derived keys.
+constexpr auto keySize = DerivedKeyCache::keySize;
+
+/*!
+ * \brief Returns parameters for the specified \a function and cost parameters using a new random salt.
+ * \remarks See KeyDerivationParameters for the meaning of the cost parameters.
+ * \throws Throws CryptoException when no random salt can be generated.
+ */
+KeyDerivationParameters KeyDerivationParameters::create(
+    KeyDerivationFunction function, std::uint32_t iterations, std::uint32_t memoryCost, std::uint32_t parallelism)
+{
+    auto parameters = KeyDerivationParameters();
+    parameters.function = function;
+    parameters.iterations = iterations;
+    parameters.memoryCost = memoryCost;
+    parameters.parallelism = parallelism;
+    if (function != KeyDerivationFunction::Sha256Iterations) {
+        Util::OpenSslRandomDevice().generate(parameters.salt.data(), saltSize);
+    }
+    return parameters;
+}
+
+/*!
+ * \brief Returns whether the cost parameters do not exceed the maxima (see KeyDerivationParameters).
+ * \remarks This only checks the upper limits. Whether the parameters are valid for the function is only checked when
+ *          deriving a key.
+ */
+bool KeyDerivationParameters::isWithinLimits() const
+{
+    const auto lanes = std::uint64_t(std::max<std::uint32_t>(parallelism, 1));
+    switch (function) {
+    case KeyDerivationFunction::Sha256Iterations:
+        return iterations <= maxIterations;
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+        return parallelism <= maxParallelism && iterations * lanes <= maxIterations;
+    case KeyDerivationFunction::Scrypt:
+        return parallelism <= maxParallelism && memoryCost * lanes <= maxMemoryCost;
+    case KeyDerivationFunction::Argon2id:
+        return parallelism <= maxParallelism && iterations <= maxPasses && memoryCost <= maxMemoryCost;
+    }
+    return false;
+}
+
+/*!
+ * \brief Returns whether \a other equals the current instance.
+ */
+bool KeyDerivationParameters::operator==(const KeyDerivationParameters &other) const
+{
+    return function == other.function && iterations == other.iterations && memoryCost == other.memoryCost && parallelism == other.parallelism
+        && salt == other.salt;
+}
+
+/*!
+ * \brief Returns the name of the specified \a function.
+ */
+const char *keyDerivationFunctionName(KeyDerivationFunction function)
+{
+    switch (function) {
+    case KeyDerivationFunction::Sha256Iterations:
+        return "SHA-256 iterations";
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+        return "PBKDF2-HMAC-SHA256";
+    case KeyDerivationFunction::Scrypt:
+        return "scrypt";
+    case KeyDerivationFunction::Argon2id:
+        return "Argon2id";
+    }
+    return "unknown";
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+/*!
+ * \brief The Argon2idLibraryContext struct holds the OpenSSL library context used to derive keys with Argon2id.
+ * \remarks A private context is used so allowing OpenSSL to spawn threads for computing the lanes does not change the
+ *          default context of the whole process. The context is intentionally never freed because freeing it on exit
+ *          might happen after OpenSSL has already been cleaned up.
+ */
+struct Argon2idLibraryContext {
+    Argon2idLibraryContext()
+        : context(OSSL_LIB_CTX_new())
+        , maxThreads(1)
+    {
+        if (context && OSSL_set_max_threads(context, KeyDerivationParameters::maxParallelism) == 1) {
+            maxThreads = KeyDerivationParameters::maxParallelism;
+        }
+    }
+
+    OSSL_LIB_CTX *context;
+    std::uint32_t maxThreads;
+};
+
+/*!
+ * \brief Returns the library context used to derive keys with Argon2id; it is created on the first call.
+ */
+static const Argon2idLibraryContext &argon2idLibraryContext()
+{
+    static const auto context = Argon2idLibraryContext();
+    return context;
+}
+#endif
+
+/*!
+ * \brief Returns whether the specified \a function is supported by the OpenSSL version the library has been built with.
+ */
+bool isKeyDerivationFunctionSupported(KeyDerivationFunction function)
+{
+    switch (function) {
+    case KeyDerivationFunction::Sha256Iterations:
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+    case KeyDerivationFunction::Scrypt:
+        return true;
+    case KeyDerivationFunction::Argon2id:
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+    {
+        auto *const libraryContext = argon2idLibraryContext().context;
+        if (!libraryContext) {
+            return false;
+        }
+        ERR_set_mark();
+        auto *const kdf = EVP_KDF_fetch(libraryContext, "ARGON2ID", nullptr);
+        ERR_pop_to_mark();
+        EVP_KDF_free(kdf);
+        return kdf != nullptr;
+    }
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/*!
+ * \brief Throws a CryptoException if the specified \a parameters are invalid.
+ */
+static void validateParameters(const KeyDerivationParameters &parameters)
+{
+    const auto fail = [&parameters](const char *reason) {
+        throw CryptoException(argsToString("Invalid parameters for ", keyDerivationFunctionName(parameters.function), ": ", reason));
+    };
+    switch (parameters.function) {
+    case KeyDerivationFunction::Sha256Iterations:
+        if (!parameters.isWithinLimits()) {
+            fail("The number of iterations exceeds the supported maximum.");
+        }
+        return;
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+        if (!parameters.iterations) {
+            fail("The number of iterations must not be zero.");
+        }
+        break;
+    case KeyDerivationFunction::Scrypt:
+        if (parameters.memoryCost < 2 || (parameters.memoryCost & (parameters.memoryCost - 1))) {
+            fail("The memory cost must be a power of two.");
+        }
+        break;
+    case KeyDerivationFunction::Argon2id:
+        if (!parameters.iterations) {
+            fail("The number of passes must not be zero.");
+        }
+        if (parameters.memoryCost < 8 * static_cast<std::uint64_t>(parameters.parallelism)) {
+            fail("The memory cost must be at least 8 KiB per lane.");
+        }
+        break;
+    default:
+        throw CryptoException(argsToString("Key derivation function \"", static_cast<unsigned int>(parameters.function), "\" is unknown."));
+    }
+    if (!parameters.parallelism) {
+        fail("The number of lanes must not be zero.");
+    }
+    if (!parameters.isWithinLimits()) {
+        fail("The cost exceeds the supported maximum.");
+    }
+    if (!isKeyDerivationFunctionSupported(parameters.function)) {
+        throw CryptoException(argsToString("The key derivation function ", keyDerivationFunctionName(parameters.function),
+            " is not supported by the OpenSSL version the library has been built with."));
+    }
+}
+
+/*!
+ * \brief Derives the key of the lane with the specified \a index using PBKDF2 or scrypt.
+ */
+static void deriveLaneKey(const std::string &password, const KeyDerivationParameters &parameters, std::uint32_t index, unsigned char *key)
+{
+    static const auto *const sha256 = Util::OpenSsl::fetchDigest("SHA256");
+    unsigned char salt[KeyDerivationParameters::saltSize + 4];
+    auto saltSize = KeyDerivationParameters::saltSize;
+    std::memcpy(salt, parameters.salt.data(), saltSize);
+    if (parameters.parallelism > 1) {
+        BE::getBytes(index, reinterpret_cast<char *>(salt + saltSize));
+        saltSize += 4;
+    }
+    auto result = 0;
+    if (parameters.function == KeyDerivationFunction::Pbkdf2HmacSha256) {
+        result = PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()), salt, static_cast<int>(saltSize),
+            static_cast<int>(parameters.iterations), sha256, static_cast<int>(keySize), key);
+    } else {
+        // note: The memory required by scrypt is 128 * r * N bytes for the vector (plus 128 * r * p bytes for the block)
+        //       which is the memory cost in KiB when r = 8.
+        constexpr auto r = std::uint64_t(8), p = std::uint64_t(1);
+        const auto maxMemory = 128 * r * (parameters.memoryCost + 2) + 128 * r * p + 0x10000;
+        result = EVP_PBE_scrypt(password.data(), password.size(), salt, saltSize, parameters.memoryCost, r, p, maxMemory, key, keySize);
+    }
+    if (result != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+}
+
+/*!
+ * \brief Derives the key using Argon2id.
+ */
+static void deriveArgon2idKey(const std::string &password, const KeyDerivationParameters &parameters, unsigned char *key, std::size_t threadCount)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+    const auto &libraryContext = argon2idLibraryContext();
+    auto *const kdf = libraryContext.context ? EVP_KDF_fetch(libraryContext.context, "ARGON2ID", nullptr) : nullptr;
+    auto *const context = kdf ? EVP_KDF_CTX_new(kdf) : nullptr;
+    EVP_KDF_free(kdf);
+    if (!context) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+
+    // compute the lanes concurrently (within the limit of the private library context)
+    auto threads = static_cast<std::uint32_t>(std::min<std::size_t>(
+        std::min(parameters.parallelism, libraryContext.maxThreads), std::max<std::size_t>(threadCount, 1)));
+
+    auto iterations = parameters.iterations, memoryCost = parameters.memoryCost, lanes = parameters.parallelism;
+    OSSL_PARAM osslParameters[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, const_cast<char *>(password.data()), password.size()),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, const_cast<unsigned char *>(parameters.salt.data()), parameters.salt.size()),
+        OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ITER, &iterations),
+        OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_MEMCOST, &memoryCost),
+        OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ARGON2_LANES, &lanes),
+        OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_THREADS, &threads),
+        OSSL_PARAM_construct_end(),
+    };
+    const auto result = EVP_KDF_derive(context, key, keySize, osslParameters);
+    EVP_KDF_CTX_free(context);
+    if (result != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+#else
+    (void)password;
+    (void)parameters;
+    (void)key;
+    (void)threadCount;
+#endif
+}
+
+/*!
+ * \brief Derives the key (DerivedKeyCache::keySize bytes) for the specified \a password using the specified \a parameters.
+ * \param threadCount Specifies the number of threads to use for computing the lanes concurrently (at least one).
+ * \throws Throws CryptoException when the parameters are invalid, the function is not supported or OpenSSL is unable
+ *         to derive the key.
+ */
+void deriveKey(const std::string &password, const KeyDerivationParameters &parameters, unsigned char *key, std::size_t threadCount)
+{
+    validateParameters(parameters);
+    switch (parameters.function) {
+    case KeyDerivationFunction::Sha256Iterations: {
+        // hash the password the specified number of times; use it directly (as in versions prior to 6) if zero
+        auto hash = Util::OpenSsl::Sha256Sum();
+        if (parameters.iterations) {
+            hash = Util::OpenSsl::computeSha256Sum(reinterpret_cast<unsigned const char *>(password.data()), password.size());
+            for (auto i = std::uint32_t(1); i < parameters.iterations; ++i) {
+                hash = Util::OpenSsl::computeSha256Sum(hash.data, Util::OpenSsl::Sha256Sum::size);
+            }
+        } else {
+            password.copy(reinterpret_cast<char *>(hash.data), Util::OpenSsl::Sha256Sum::size);
+        }
+        std::memcpy(key, hash.data, keySize);
+        OPENSSL_cleanse(hash.data, Util::OpenSsl::Sha256Sum::size);
+        break;
+    }
+    case KeyDerivationFunction::Argon2id:
+        deriveArgon2idKey(password, parameters, key, threadCount);
+        break;
+    default: {
+        // derive the keys of the lanes concurrently and combine them
+        auto laneKeys = std::vector<unsigned char>(parameters.parallelism * keySize);
+        try {
+            Util::runConcurrently(parameters.parallelism, std::max<std::size_t>(threadCount, 1),
+                [&](std::size_t lane) { deriveLaneKey(password, parameters, static_cast<std::uint32_t>(lane), laneKeys.data() + lane * keySize); });
+        } catch (...) {
+            OPENSSL_cleanse(laneKeys.data(), laneKeys.size());
+            throw;
+        }
+        std::memset(key, 0, keySize);
+        for (auto lane = std::size_t(); lane != parameters.parallelism; ++lane) {
+            for (auto i = std::size_t(); i != keySize; ++i) {
+                key[i] ^= laneKeys[lane * keySize + i];
+            }
+        }
+        OPENSSL_cleanse(laneKeys.data(), laneKeys.size());
+    }
+    }
+}
+
+/*!
+ * \brief Returns parameters for the function of the specified \a parameters which take about the specified \a duration to
+ *        derive a key on the current machine.
+ * \param parameters Specifies the function and the parameters which are not calibrated. These are the number of lanes
+ *                   and, for Argon2id, the memory cost (64 MiB are used if zero).
+ * \param threadCount Specifies the number of threads which will be used for deriving the key (see deriveKey()).
+ * \returns Returns the calibrated parameters with a new random salt.
+ * \remarks
+ * - The cost which grows linearly with the duration is calibrated. That is the number of iterations/passes for all
+ *   functions except scrypt and the memory cost for scrypt (which is rounded down to a power of two).
+ * - The cost is doubled until deriving a key takes at least an eighth of the specified \a duration and then scaled
+ *   to the \a duration. So the benchmark itself takes roughly a quarter of the \a duration.
+ * - The cost does not exceed the maxima (see KeyDerivationParameters) even if that is faster than \a duration.
+ * \throws Throws CryptoException when the parameters are invalid or the function is not supported.
+ */
+KeyDerivationParameters calibrateKeyDerivation(const KeyDerivationParameters &parameters, std::chrono::milliseconds duration, std::size_t threadCount)
+{
+    using Clock = std::chrono::steady_clock;
+    auto calibrated = KeyDerivationParameters::create(parameters.function, 1, parameters.memoryCost, parameters.parallelism);
+    auto &cost = parameters.function == KeyDerivationFunction::Scrypt ? calibrated.memoryCost : calibrated.iterations;
+    const auto lanes = std::max<std::uint32_t>(parameters.parallelism, 1);
+    auto maxCost = std::uint64_t(KeyDerivationParameters::maxIterations);
+    switch (parameters.function) {
+    case KeyDerivationFunction::Sha256Iterations:
+        cost = 1000;
+        break;
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+        cost = 1000;
+        maxCost /= lanes;
+        break;
+    case KeyDerivationFunction::Scrypt:
+        cost = 1024;
+        maxCost = KeyDerivationParameters::maxMemoryCost / lanes;
+        break;
+    case KeyDerivationFunction::Argon2id:
+        if (!calibrated.memoryCost) {
+            calibrated.memoryCost = 0x10000;
+        }
+        maxCost = KeyDerivationParameters::maxPasses;
+        break;
+    }
+
+    // measure until the duration is long enough to extrapolate
+    const auto password = std::string("calibration");
+    const auto minDuration = std::max<Clock::duration>(duration / 8, std::chrono::milliseconds(1));
+    unsigned char key[keySize];
+    auto elapsed = Clock::duration();
+    for (;;) {
+        const auto start = Clock::now();
+        deriveKey(password, calibrated, key, threadCount);
+        elapsed = std::max<Clock::duration>(Clock::now() - start, Clock::duration(1));
+        if (elapsed >= minDuration || cost * 2 > maxCost) {
+            break;
+        }
+        cost *= 2;
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+
+    // scale the cost to the duration
+    const auto factor = std::chrono::duration<double>(duration) / elapsed;
+    const auto scaledCost = std::clamp(static_cast<double>(cost) * factor, 1.0, static_cast<double>(maxCost));
+    if (parameters.function == KeyDerivationFunction::Scrypt) {
+        cost = std::max(std::uint32_t(2), std::uint32_t(1) << static_cast<unsigned int>(std::floor(std::log2(scaledCost))));
+    } else {
+        cost = static_cast<std::uint32_t>(scaledCost);
+    }
+    return calibrated;
+}
+
+/*!
+ * \brief Returns a human-readable description of the specified \a parameters (not including the salt).
+ */
+std::string keyDerivationParametersToString(const KeyDerivationParameters &parameters)
+{
+    const auto *const name = keyDerivationFunctionName(parameters.function);
+    switch (parameters.function) {
+    case KeyDerivationFunction::Sha256Iterations:
+        return argsToString(name, " (", parameters.iterations, " iterations)");
+    case KeyDerivationFunction::Pbkdf2HmacSha256:
+        return argsToString(name, " (", parameters.iterations, " iterations, ", parameters.parallelism, " lanes)");
+    case KeyDerivationFunction::Scrypt:
+        return argsToString(name, " (", parameters.memoryCost, " KiB, ", parameters.parallelism, " lanes)");
+    case KeyDerivationFunction::Argon2id:
+        return argsToString(name, " (", parameters.iterations, " passes, ", parameters.memoryCost, " KiB, ", parameters.parallelism, " lanes)");
+    }
+    return name;
+}
+
+} // namespace Io
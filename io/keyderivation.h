@@ -0,0 +1,91 @@
+#ifndef PASSWORD_FILE_IO_KEYDERIVATION_H
+#define PASSWORD_FILE_IO_KEYDERIVATION_H
+
+#include "../global.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Io {
+
+/*!
+ * \brief The KeyDerivationFunction enum specifies how the key is derived from the password.
+ * \remarks The values are stored in the file header (as of version 13) so they must not be changed.
+ */
+enum class KeyDerivationFunction : std::uint8_t {
+    Sha256Iterations = 0, /**< the password is hashed KeyDerivationParameters::iterations times with SHA-256 without salt (the only
+                               function supported before version 13) */
+    Pbkdf2HmacSha256 = 1, /**< PBKDF2 with HMAC-SHA256 */
+    Scrypt = 2, /**< scrypt (with r = 8) */
+    Argon2id = 3, /**< Argon2id (requires OpenSSL 3.2 or newer) */
+};
+
+/*!
+ * \brief The KeyDerivationParameters struct holds the parameters to derive a key from a password.
+ *
+ * The meaning of the cost parameters depends on the function:
+ * - KeyDerivationFunction::Sha256Iterations: \a iterations specifies how often the password is hashed; if zero, the
+ *   password is used as key directly (padded with zeros). The other parameters and the salt are not used.
+ * - KeyDerivationFunction::Pbkdf2HmacSha256: \a iterations specifies the number of PBKDF2 iterations per lane.
+ * - KeyDerivationFunction::Scrypt: \a memoryCost specifies the memory required per lane in KiB which equals the
+ *   scrypt parameter N (so it must be a power of two).
+ * - KeyDerivationFunction::Argon2id: \a iterations, \a memoryCost (in KiB) and \a parallelism map directly to the
+ *   passes, the memory and the lanes of Argon2id.
+ *
+ * For PBKDF2 and scrypt, \a parallelism specifies the number of independent lanes. Each lane derives a key from the
+ * password and the salt followed by the lane index (as 32-bit big-endian integer) and the key is the XOR of the keys of
+ * all lanes. So the lanes can be computed concurrently. With only one lane, the salt is used as-is so the key equals the
+ * one of the standard function.
+ *
+ * The parameters are read from the file header before the password can be verified so the cost is limited to keep a
+ * crafted file from exhausting the CPU or memory (see isWithinLimits()):
+ * - \a parallelism must not exceed maxParallelism.
+ * - For KeyDerivationFunction::Sha256Iterations, \a iterations must not exceed maxIterations. For
+ *   KeyDerivationFunction::Pbkdf2HmacSha256, this applies to the iterations of all lanes together.
+ * - For KeyDerivationFunction::Scrypt, the memory cost of all lanes together must not exceed maxMemoryCost. So the
+ *   memory required stays within that limit no matter how many lanes are computed concurrently.
+ * - For KeyDerivationFunction::Argon2id, \a iterations must not exceed maxPasses and \a memoryCost must not exceed
+ *   maxMemoryCost.
+ */
+struct PASSWORD_FILE_EXPORT KeyDerivationParameters {
+    static constexpr std::size_t saltSize = 16;
+    static constexpr std::uint32_t maxParallelism = 16;
+    static constexpr std::uint32_t maxIterations = 0x1000000;
+    static constexpr std::uint32_t maxPasses = 64;
+    static constexpr std::uint32_t maxMemoryCost = 0x100000;
+
+    static KeyDerivationParameters create(
+        KeyDerivationFunction function, std::uint32_t iterations, std::uint32_t memoryCost = 0, std::uint32_t parallelism = 1);
+    bool isWithinLimits() const;
+    bool operator==(const KeyDerivationParameters &other) const;
+    bool operator!=(const KeyDerivationParameters &other) const;
+
+    KeyDerivationFunction function = KeyDerivationFunction::Sha256Iterations; /**< the function used to derive the key */
+    std::uint32_t iterations = 0; /**< the number of iterations/passes (see above) */
+    std::uint32_t memoryCost = 0; /**< the memory required in KiB (see above) */
+    std::uint32_t parallelism = 1; /**< the number of lanes (see above) */
+    std::array<unsigned char, saltSize> salt = {}; /**< the salt (not used by KeyDerivationFunction::Sha256Iterations) */
+};
+
+/*!
+ * \brief Returns whether \a other differs from the current instance.
+ */
+inline bool KeyDerivationParameters::operator!=(const KeyDerivationParameters &other) const
+{
+    return !(*this == other);
+}
+
+PASSWORD_FILE_EXPORT const char *keyDerivationFunctionName(KeyDerivationFunction function);
+PASSWORD_FILE_EXPORT bool isKeyDerivationFunctionSupported(KeyDerivationFunction function);
+PASSWORD_FILE_EXPORT void deriveKey(const std::string &password, const KeyDerivationParameters &parameters, unsigned char *key,
+    std::size_t threadCount = 1);
+PASSWORD_FILE_EXPORT KeyDerivationParameters calibrateKeyDerivation(
+    const KeyDerivationParameters &parameters, std::chrono::milliseconds duration, std::size_t threadCount = 1);
+PASSWORD_FILE_EXPORT std::string keyDerivationParametersToString(const KeyDerivationParameters &parameters);
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_KEYDERIVATION_H
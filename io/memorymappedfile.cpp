@@ -0,0 +1,91 @@
+#include "./memorymappedfile.h"
+
+#ifdef PLATFORM_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#else
+#include <c++utilities/io/nativefilestream.h>
+#endif
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <ios>
+
+using namespace std;
+using namespace CppUtilities;
+
+namespace Io {
+
+/*!
+ * \class MemoryMappedFile
+ * \brief The MemoryMappedFile class maps a file read-only into memory.
+ *
+ * The kernel is advised that the mapping will be read sequentially so it can read ahead aggressively.
+ *
+ * \remarks On platforms without mmap() the file is read into a buffer instead.
+ */
+
+/*!
+ * \brief Maps the file under the specified \a path into memory.
+ * \throws Throws std::ios_base::failure when the file can not be opened or mapped.
+ */
+MemoryMappedFile::MemoryMappedFile(const std::string &path)
+    : m_data(nullptr)
+    , m_size(0)
+{
+#ifdef PLATFORM_UNIX
+    const auto fd = ::open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::ios_base::failure(argsToString("Unable to open \"", path, "\": ", std::strerror(errno)));
+    }
+    struct stat fileInfo;
+    if (::fstat(fd, &fileInfo) != 0) {
+        const auto error = errno;
+        ::close(fd);
+        throw std::ios_base::failure(argsToString("Unable to determine size of \"", path, "\": ", std::strerror(error)));
+    }
+    if (!(m_size = static_cast<std::size_t>(fileInfo.st_size))) {
+        ::close(fd);
+        return;
+    }
+    auto *const mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const auto error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::ios_base::failure(argsToString("Unable to map \"", path, "\" into memory: ", std::strerror(error)));
+    }
+    m_data = static_cast<const char *>(mapping);
+    // the advice is only a hint so errors are ignored
+    ::madvise(mapping, m_size, MADV_SEQUENTIAL);
+    ::madvise(mapping, m_size, MADV_WILLNEED);
+#else
+    NativeFileStream file;
+    file.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    file.open(path, std::ios_base::in | std::ios_base::binary);
+    file.seekg(0, std::ios_base::end);
+    m_size = static_cast<std::size_t>(file.tellg());
+    file.seekg(0);
+    m_buffer = make_unique<char[]>(m_size);
+    file.read(m_buffer.get(), static_cast<std::streamsize>(m_size));
+    m_data = m_buffer.get();
+#endif
+}
+
+/*!
+ * \brief Unmaps the file.
+ */
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef PLATFORM_UNIX
+    if (m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+}
+
+} // namespace Io
@@ -0,0 +1,48 @@
+#ifndef PASSWORD_FILE_IO_MEMORYMAPPEDFILE_H
+#define PASSWORD_FILE_IO_MEMORYMAPPEDFILE_H
+
+#include "../global.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT MemoryMappedFile {
+public:
+    explicit MemoryMappedFile(const std::string &path);
+    MemoryMappedFile(const MemoryMappedFile &) = delete;
+    ~MemoryMappedFile();
+    MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+
+    const char *data() const;
+    std::size_t size() const;
+
+private:
+    const char *m_data;
+    std::size_t m_size;
+#ifndef PLATFORM_UNIX
+    std::unique_ptr<char[]> m_buffer;
+#endif
+};
+
+/*!
+ * \brief Returns the contents of the file.
+ */
+inline const char *MemoryMappedFile::data() const
+{
+    return m_data;
+}
+
+/*!
+ * \brief Returns the size of the file.
+ */
+inline std::size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_MEMORYMAPPEDFILE_H
@@ -0,0 +1,50 @@
+#include "./memorystreambuffer.h"
+
+namespace Io {
+
+/*!
+ * \class MemoryStreamBuffer
+ * \brief The MemoryStreamBuffer class provides a read-only stream buffer for data which is already present in memory.
+ *
+ * In contrast to std::stringbuf the data is not copied.
+ */
+
+/*!
+ * \brief Constructs a new buffer for reading the specified \a data. The \a data must outlive the buffer.
+ */
+MemoryStreamBuffer::MemoryStreamBuffer(const char *data, std::size_t size)
+{
+    auto *const begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+    switch (dir) {
+    case std::ios_base::beg:
+        break;
+    case std::ios_base::cur:
+        off += gptr() - eback();
+        break;
+    case std::ios_base::end:
+        off += egptr() - eback();
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+    if (off < 0 || off > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + off, egptr());
+    return pos_type(off);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+} // namespace Io
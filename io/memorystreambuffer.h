@@ -0,0 +1,21 @@
+#ifndef PASSWORD_FILE_IO_MEMORYSTREAMBUFFER_H
+#define PASSWORD_FILE_IO_MEMORYSTREAMBUFFER_H
+
+#include "../global.h"
+
+#include <streambuf>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT MemoryStreamBuffer : public std::streambuf {
+public:
+    explicit MemoryStreamBuffer(const char *data, std::size_t size);
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_MEMORYSTREAMBUFFER_H
@@ -1,7 +1,17 @@
 #include "./passwordfile.h"
+#include "./asyncsaveworker.h"
+#include "./chunkedcompression.h"
+#include "./compressingstreambuffer.h"
 #include "./cryptoexception.h"
+#include "./decompressingstreambuffer.h"
+#include "./decryptingstreambuffer.h"
+#include "./encryptingstreambuffer.h"
 #include "./entry.h"
+#include "./entryparser.h"
+#include "./memorymappedfile.h"
+#include "./memorystreambuffer.h"
 #include "./parsingexception.h"
+#include "./segmentedencryption.h"
 
 #include "../util/openssl.h"
 #include "../util/opensslrandomdevice.h"
@@ -10,20 +20,25 @@
 #include <c++utilities/conversion/stringconversion.h>
 #include <c++utilities/io/path.h>
 
+#ifdef PLATFORM_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <openssl/conf.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
-#include <openssl/rand.h>
-
-#include <zlib.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <filesystem>
 #include <functional>
 #include <limits>
 #include <memory>
-#include <sstream>
+#include <optional>
 #include <streambuf>
+#include <thread>
 
 using namespace std;
 using namespace CppUtilities;
@@ -31,8 +46,138 @@ using namespace CppUtilities;
 namespace Io {
 
 constexpr unsigned int aes256cbcIvSize = 16U;
-constexpr unsigned int aes256blockSize = 32U;
-constexpr unsigned int aes256additionalBufferSize = aes256blockSize * 2;
+
+/// \brief The number of bytes to read at once when reading the header (enough unless the extended header is very big).
+constexpr std::size_t headerChunkSize = 0x200;
+
+/*!
+ * \brief Returns the flags for serializing entries with the specified \a options.
+ */
+static EntrySerializationFlags entrySerializationFlags(PasswordFileSaveFlags options)
+{
+    auto serializationFlags = EntrySerializationFlags::None;
+    if (options & PasswordFileSaveFlags::SubtreeSizes) {
+        serializationFlags |= EntrySerializationFlags::SubtreeSizes;
+    }
+    if (options & PasswordFileSaveFlags::FieldShapes) {
+        serializationFlags |= EntrySerializationFlags::FieldShapes;
+    }
+    if (options & PasswordFileSaveFlags::CacheSubtrees) {
+        serializationFlags |= EntrySerializationFlags::CacheSubtrees;
+    }
+    return serializationFlags;
+}
+
+/*!
+ * \brief Decrypts the last block of AES-256-CBC encrypted data and checks its padding.
+ * \param key Specifies the 32 byte long key.
+ * \param lastBlocks Specifies the last block preceded by the block before (or the IV if there is only one block).
+ * \throws Throws Io::CryptoException if the padding is invalid which is usually the case when the key is wrong.
+ */
+static void verifyPadding(const unsigned char *key, const unsigned char *lastBlocks)
+{
+    auto ctx = Util::OpenSsl::CipherContext();
+    unsigned char decryptedData[aes256cbcIvSize * 2];
+    int outlen1, outlen2;
+    if (EVP_DecryptInit_ex(ctx.get(), evpCipher(EncryptionCipher::Aes256Cbc), nullptr, key, lastBlocks) != 1
+        || EVP_DecryptUpdate(ctx.get(), decryptedData, &outlen1, lastBlocks + aes256cbcIvSize, aes256cbcIvSize) != 1
+        || EVP_DecryptFinal_ex(ctx.get(), decryptedData + outlen1, &outlen2) != 1) {
+        throw CryptoException(Util::OpenSsl::errorMessages());
+    }
+    OPENSSL_cleanse(decryptedData, sizeof(decryptedData));
+}
+
+/*!
+ * \brief Reads and discards the remaining data of the specified decrypting \a buffer.
+ * \remarks Reaching the end makes the buffer check the padding or (when using an authenticated cipher) the tag.
+ * \throws Throws Io::CryptoException if the padding or tag is invalid.
+ */
+static void drainDecryptingBuffer(std::streambuf *buffer)
+{
+    const auto discarded = make_unique<char[]>(DecryptingStreamBuffer::bufferSize);
+    while (buffer->sgetn(discarded.get(), DecryptingStreamBuffer::bufferSize) > 0) {
+    }
+    OPENSSL_cleanse(discarded.get(), DecryptingStreamBuffer::bufferSize);
+}
+
+/*!
+ * \brief Returns the mode to open the file stream with for the specified \a options.
+ */
+static ios_base::openmode fileOpenMode(PasswordFileOpenFlags options)
+{
+    return options & PasswordFileOpenFlags::ReadOnly ? ios_base::in | ios_base::binary : ios_base::in | ios_base::out | ios_base::binary;
+}
+
+/*!
+ * \brief Returns \a path with symbolic links resolved so saving replaces the file they point to instead of the links.
+ * \remarks Returns \a path as-is if it does not exist (yet).
+ */
+static std::string resolveSymbolicLinks(const std::string &path)
+{
+#ifdef PLATFORM_UNIX
+    auto error = std::error_code();
+    auto resolvedPath = std::filesystem::canonical(path, error);
+    return error ? path : resolvedPath.string();
+#else
+    return path;
+#endif
+}
+
+/*!
+ * \brief Creates an empty file with a unique name next to the file under \a path.
+ * \returns Returns the path of the created file. Only the owner is allowed to read and write it.
+ * \throws Throws std::ios_base::failure when the file can not be created.
+ */
+static std::string createTemporaryFile(const std::string &path)
+{
+#ifdef PLATFORM_UNIX
+    auto temporaryPath = path + ".XXXXXX";
+    const auto fd = ::mkstemp(temporaryPath.data());
+    if (fd < 0) {
+        throw std::ios_base::failure(argsToString("Unable to create temporary file for \"", path, "\": ", std::strerror(errno)));
+    }
+    ::close(fd);
+    return temporaryPath;
+#else
+    for (;;) {
+        auto temporaryPath = argsToString(path, '.', Util::OpenSsl::generateRandomNumber(0, numeric_limits<std::uint32_t>::max()));
+        if (!std::filesystem::exists(makeNativePath(temporaryPath))) {
+            NativeFileStream file;
+            file.exceptions(ios_base::failbit | ios_base::badbit);
+            file.open(temporaryPath, ios_base::out | ios_base::binary);
+            return temporaryPath;
+        }
+    }
+#endif
+}
+
+/*!
+ * \brief Flushes the data of the file (or directory if \a directory is set) under \a path to the disk.
+ * \remarks Directories which can not be flushed (e.g. on some file systems) are ignored. Does nothing on platforms
+ *          not supporting fsync().
+ * \throws Throws std::ios_base::failure when a file can not be flushed.
+ */
+static void syncToDisk(const std::string &path, bool directory)
+{
+#ifdef PLATFORM_UNIX
+    const auto fd = ::open(path.data(), directory ? O_RDONLY | O_DIRECTORY | O_CLOEXEC : O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (directory) {
+            return;
+        }
+        throw std::ios_base::failure(argsToString("Unable to open \"", path, "\" for flushing: ", std::strerror(errno)));
+    }
+    const auto result = ::fsync(fd);
+    const auto error = errno;
+    ::close(fd);
+    if (result != 0 && !directory) {
+        throw std::ios_base::failure(argsToString("Unable to flush \"", path, "\": ", std::strerror(error)));
+    }
+#else
+    static_cast<void>(path);
+    static_cast<void>(directory);
+#endif
+}
 
 /*!
  * \class PasswordFile
@@ -49,6 +194,9 @@ PasswordFile::PasswordFile()
     , m_version(0)
     , m_openOptions(PasswordFileOpenFlags::None)
     , m_saveOptions(PasswordFileSaveFlags::None)
+    , m_compressionCodec(CompressionCodec::Zlib)
+    , m_encryptionCipher(EncryptionCipher::Aes256Cbc)
+    , m_keyDerivationDuration(250)
 {
     m_file.exceptions(ios_base::failbit | ios_base::badbit);
     clearPassword();
@@ -63,6 +211,9 @@ PasswordFile::PasswordFile(const string &path, const string &password)
     , m_version(0)
     , m_openOptions(PasswordFileOpenFlags::None)
     , m_saveOptions(PasswordFileSaveFlags::None)
+    , m_compressionCodec(CompressionCodec::Zlib)
+    , m_encryptionCipher(EncryptionCipher::Aes256Cbc)
+    , m_keyDerivationDuration(250)
 {
     m_file.exceptions(ios_base::failbit | ios_base::badbit);
     setPath(path);
@@ -83,6 +234,11 @@ PasswordFile::PasswordFile(const PasswordFile &other)
     , m_version(other.m_version)
     , m_openOptions(other.m_openOptions)
     , m_saveOptions(other.m_saveOptions)
+    , m_compressionCodec(other.m_compressionCodec)
+    , m_compressionLevel(other.m_compressionLevel)
+    , m_encryptionCipher(other.m_encryptionCipher)
+    , m_keyDerivation(other.m_keyDerivation)
+    , m_keyDerivationDuration(other.m_keyDerivationDuration)
 {
     m_file.exceptions(ios_base::failbit | ios_base::badbit);
 }
@@ -93,6 +249,7 @@ PasswordFile::PasswordFile(const PasswordFile &other)
 PasswordFile::PasswordFile(PasswordFile &&other)
     : m_path(std::move(other.m_path))
     , m_password(std::move(other.m_password))
+    , m_keyCache(std::move(other.m_keyCache))
     , m_rootEntry(std::move(other.m_rootEntry))
     , m_extendedHeader(std::move(other.m_extendedHeader))
     , m_encryptedExtendedHeader(std::move(other.m_encryptedExtendedHeader))
@@ -102,11 +259,19 @@ PasswordFile::PasswordFile(PasswordFile &&other)
     , m_version(other.m_version)
     , m_openOptions(other.m_openOptions)
     , m_saveOptions(other.m_saveOptions)
+    , m_compressionCodec(other.m_compressionCodec)
+    , m_compressionLevel(other.m_compressionLevel)
+    , m_encryptionCipher(other.m_encryptionCipher)
+    , m_keyDerivation(other.m_keyDerivation)
+    , m_keyDerivationDuration(other.m_keyDerivationDuration)
+    , m_asyncSaveWorker(std::move(other.m_asyncSaveWorker))
+    , m_prefetchedFile(std::move(other.m_prefetchedFile))
 {
 }
 
 /*!
  * \brief Closes the file if still opened and destroys the instance.
+ * \remarks Waits until asynchronous saves have been completed.
  */
 PasswordFile::~PasswordFile()
 {
@@ -114,6 +279,12 @@ PasswordFile::~PasswordFile()
 
 /*!
  * \brief Opens the file. Does not load the contents (see load()).
+ * \remarks
+ * - When PasswordFileOpenFlags::MemoryMapped is specified, load() maps the file into memory instead of reading it
+ *   via fileStream().
+ * - When PasswordFileOpenFlags::LazyLoading is specified, load() defers parsing the children of node entries until
+ *   they are accessed (see NodeEntry::parseDeferredChildren()). This only has an effect on files saved with
+ *   PasswordFileSaveFlags::SubtreeSizes.
  * \throws Throws ios_base::failure when an IO error occurs.
  */
 void PasswordFile::open(PasswordFileOpenFlags options)
@@ -122,8 +293,7 @@ void PasswordFile::open(PasswordFileOpenFlags options)
     if (m_path.empty()) {
         throw std::ios_base::failure("Unable to open file because path is empty.");
     }
-    m_file.open(
-        m_path, options & PasswordFileOpenFlags::ReadOnly ? ios_base::in | ios_base::binary : ios_base::in | ios_base::out | ios_base::binary);
+    m_file.open(m_path, fileOpenMode(options));
     m_openOptions = options;
     opened();
 }
@@ -167,209 +337,406 @@ void PasswordFile::create()
 }
 
 /*!
- * \brief Reads the contents of the file. Opens the file if not already opened. Replaces
- *        the current root entry with the new one constructed from the file contents.
- * \throws Throws ios_base::failure when an IO error occurs.
- * \throws Throws Io::ParsingException when a parsing error occurs.
- * \throws Throws Io::CryptoException when a decryption error occurs.
- * \throws Throws CppUtilities::ConversionException when a conversion error occurs.
+ * \brief Returns the key for the current password derived with the specified \a parameters.
+ * \param threadCount Specifies the number of threads to use for computing the lanes of the key derivation function.
+ * \remarks The key is taken from the keyCache() if present; otherwise it is derived via Io::deriveKey() and inserted
+ *          into the cache. The returned key stays valid until the cache is modified.
+ * \throws Throws Io::CryptoException if the key can not be derived.
  */
-void PasswordFile::load()
+const unsigned char *PasswordFile::deriveKey(const KeyDerivationParameters &parameters, std::size_t threadCount)
 {
-    if (!m_file.is_open()) {
-        open();
+    if (const auto *const key = m_keyCache.find(parameters)) {
+        return key;
     }
-    m_file.seekg(0);
-    m_version = 0;
-    m_saveOptions = PasswordFileSaveFlags::None;
+    unsigned char key[DerivedKeyCache::keySize];
+    Io::deriveKey(m_password, parameters, key, threadCount);
+    const auto *const cachedKey = m_keyCache.insert(parameters, key);
+    OPENSSL_cleanse(key, sizeof(key));
+    return cachedKey;
+}
+
+/*!
+ * \brief Reads the unencrypted header from the beginning of the specified \a input.
+ * \remarks Reads headerChunkSize bytes at once which covers the whole header unless the extended header is very big.
+ *          The position of \a input is unspecified afterwards.
+ * \throws Throws ios_base::failure when an IO error occurs.
+ * \throws Throws Io::ParsingException when the header is invalid or truncated or the key derivation parameters exceed
+ *         the maxima (see KeyDerivationParameters).
+ */
+static PasswordFileHeader readHeader(std::istream &input)
+{
+    auto header = PasswordFileHeader();
+    input.seekg(0, ios_base::end);
+    header.fileSize = static_cast<std::uint64_t>(input.tellg());
+    input.seekg(0);
+
+    // read the first chunk of the file and take data from it, only read further data if the chunk is exhausted
+    char chunk[headerChunkSize];
+    const auto chunkSize = static_cast<std::size_t>(std::min<std::uint64_t>(header.fileSize, headerChunkSize));
+    input.read(chunk, static_cast<std::streamsize>(chunkSize));
+    auto offset = std::size_t();
+    const auto take = [&](void *destination, std::size_t size, const char *truncationMessage) {
+        if (header.fileSize - offset < size) {
+            throw ParsingException(truncationMessage);
+        }
+        const auto sizeFromChunk = offset < chunkSize ? std::min(size, chunkSize - offset) : std::size_t();
+        if (sizeFromChunk) {
+            std::memcpy(destination, chunk + offset, sizeFromChunk);
+        }
+        if (sizeFromChunk < size) {
+            input.read(static_cast<char *>(destination) + sizeFromChunk, static_cast<std::streamsize>(size - sizeFromChunk));
+        }
+        offset += size;
+    };
+    char buffer[4];
 
     // check magic number
-    if (m_freader.readUInt32LE() != 0x7770616DU) {
+    take(buffer, 4, "Signature not present.");
+    if (LE::toUInt32(buffer) != 0x7770616DU) {
         throw ParsingException("Signature not present.");
     }
 
     // check version and flags (used in version 0x3 only)
-    m_version = m_freader.readUInt32LE();
-    if (m_version > 0x6U) {
-        throw ParsingException(argsToString("Version \"", m_version, "\" is unknown. Only versions 0 to 6 are supported."));
+    take(buffer, 4, "Version is truncated.");
+    header.version = LE::toUInt32(buffer);
+    if (header.version > 0xDU) {
+        throw ParsingException(argsToString("Version \"", header.version, "\" is unknown. Only versions 0 to 13 are supported."));
     }
-    if (m_version >= 0x6U) {
-        m_saveOptions |= PasswordFileSaveFlags::PasswordHashing;
+    if (header.version == 0x6U) {
+        header.saveOptions |= PasswordFileSaveFlags::PasswordHashing; // as of version 7 denoted by a flag
     }
-    bool decrypterUsed, ivUsed, compressionUsed;
-    if (m_version >= 0x3U) {
-        const auto flags = m_freader.readByte();
-        if ((decrypterUsed = flags & 0x80)) {
-            m_saveOptions |= PasswordFileSaveFlags::Encryption;
+    if (header.version >= 0x3U) {
+        take(buffer, 1, "Flags are truncated.");
+        const auto flags = static_cast<std::uint8_t>(buffer[0]);
+        if (flags & 0x80) {
+            header.saveOptions |= PasswordFileSaveFlags::Encryption;
+        }
+        if (flags & 0x20) {
+            header.saveOptions |= PasswordFileSaveFlags::Compression;
+        }
+        if ((flags & 0x10) && header.version >= 0xAU) {
+            header.saveOptions |= PasswordFileSaveFlags::ChunkedCompression;
+        }
+        if ((flags & 0x08) && header.version >= 0xCU) {
+            header.saveOptions |= PasswordFileSaveFlags::SegmentedEncryption;
         }
-        if ((compressionUsed = flags & 0x20)) {
-            m_saveOptions |= PasswordFileSaveFlags::Compression;
+        if ((flags & 0x04) && header.version >= 0x7U) {
+            header.saveOptions |= PasswordFileSaveFlags::PasswordHashing;
         }
-        ivUsed = flags & 0x40;
+        if ((flags & 0x02) && header.version >= 0x7U) {
+            header.saveOptions |= PasswordFileSaveFlags::SubtreeSizes;
+        }
+        if ((flags & 0x01) && header.version >= 0x8U) {
+            header.saveOptions |= PasswordFileSaveFlags::FieldShapes;
+        }
+        header.ivUsed = flags & 0x40;
     } else {
-        if ((decrypterUsed = m_version >= 0x1U)) {
-            m_saveOptions |= PasswordFileSaveFlags::Encryption;
+        if (header.version >= 0x1U) {
+            header.saveOptions |= PasswordFileSaveFlags::Encryption;
+        }
+        header.ivUsed = header.version == 0x2U;
+    }
+
+    // read compression codec
+    if (header.version >= 0x9U && (header.saveOptions & PasswordFileSaveFlags::Compression)) {
+        take(buffer, 1, "Compression codec is truncated.");
+        const auto codec = static_cast<std::uint8_t>(buffer[0]);
+        if (codec > static_cast<std::uint8_t>(CompressionCodec::Lz4)) {
+            throw ParsingException(argsToString("Compression codec \"", static_cast<unsigned int>(codec), "\" is unknown."));
         }
-        compressionUsed = false;
-        ivUsed = m_version == 0x2U;
+        header.compressionCodec = static_cast<CompressionCodec>(codec);
     }
 
-    // skip extended header
+    // read encryption cipher
+    const auto decrypterUsed = static_cast<bool>(header.saveOptions & PasswordFileSaveFlags::Encryption);
+    if (header.version >= 0xBU && decrypterUsed) {
+        take(buffer, 1, "Encryption cipher is truncated.");
+        const auto cipher = static_cast<std::uint8_t>(buffer[0]);
+        if (cipher > static_cast<std::uint8_t>(EncryptionCipher::ChaCha20Poly1305)) {
+            throw ParsingException(argsToString("Encryption cipher \"", static_cast<unsigned int>(cipher), "\" is unknown."));
+        }
+        header.encryptionCipher = static_cast<EncryptionCipher>(cipher);
+    }
+
+    // read extended header
     // (the extended header might be used in further versions to
     //  add additional information without breaking compatibility)
-    if (m_version >= 0x4U) {
-        std::uint16_t extendedHeaderSize = m_freader.readUInt16BE();
-        m_extendedHeader = m_freader.readString(extendedHeaderSize);
-    } else {
-        m_extendedHeader.clear();
+    if (header.version >= 0x4U) {
+        take(buffer, 2, "Extended header is truncated.");
+        header.extendedHeader.resize(BE::toUInt16(buffer));
+        take(header.extendedHeader.data(), header.extendedHeader.size(), "Extended header is truncated.");
     }
 
-    // get length
-    const auto headerSize = static_cast<size_t>(m_file.tellg());
-    m_file.seekg(0, ios_base::end);
-    auto remainingSize = static_cast<size_t>(m_file.tellg()) - headerSize;
-    m_file.seekg(static_cast<streamoff>(headerSize), ios_base::beg);
-
-    // read hash count
-    uint32_t hashCount = 0U;
-    if ((m_saveOptions & PasswordFileSaveFlags::PasswordHashing) && decrypterUsed) {
-        if (remainingSize < 4) {
-            throw ParsingException("Hash count truncated.");
+    // read key derivation parameters (or only the hash count in versions prior to 13)
+    if (header.version >= 0xDU && decrypterUsed) {
+        char parameters[13];
+        take(parameters, sizeof(parameters), "Key derivation parameters are truncated.");
+        const auto function = static_cast<std::uint8_t>(parameters[0]);
+        if (function > static_cast<std::uint8_t>(KeyDerivationFunction::Argon2id)) {
+            throw ParsingException(argsToString("Key derivation function \"", static_cast<unsigned int>(function), "\" is unknown."));
         }
-        hashCount = m_freader.readUInt32BE();
-        remainingSize -= 4;
+        header.keyDerivation.function = static_cast<KeyDerivationFunction>(function);
+        header.keyDerivation.iterations = BE::toUInt32(parameters + 1);
+        header.keyDerivation.memoryCost = BE::toUInt32(parameters + 5);
+        header.keyDerivation.parallelism = BE::toUInt32(parameters + 9);
+        take(header.keyDerivation.salt.data(), header.keyDerivation.salt.size(), "Salt is truncated.");
+        if (header.keyDerivation.function == KeyDerivationFunction::Sha256Iterations) {
+            header.hashCount = header.keyDerivation.iterations;
+        }
+    } else if ((header.saveOptions & PasswordFileSaveFlags::PasswordHashing) && decrypterUsed) {
+        take(buffer, 4, "Hash count truncated.");
+        header.hashCount = header.keyDerivation.iterations = BE::toUInt32(buffer);
+    }
+    if (!header.keyDerivation.isWithinLimits()) {
+        throw ParsingException(argsToString("Key derivation parameters exceed the supported maxima: ",
+            keyDerivationParametersToString(header.keyDerivation)));
     }
 
     // read IV
-    unsigned char iv[aes256cbcIvSize] = { 0 };
-    if (decrypterUsed && ivUsed) {
-        if (remainingSize < aes256cbcIvSize) {
-            throw ParsingException("Initiation vector is truncated.");
-        }
-        m_file.read(reinterpret_cast<char *>(iv), aes256cbcIvSize);
-        remainingSize -= aes256cbcIvSize;
+    if (decrypterUsed && header.ivUsed) {
+        take(header.iv.data(), encryptionCipherIvSize(header.encryptionCipher), "Initiation vector is truncated.");
     }
-    if (!remainingSize) {
-        throw ParsingException("No contents found.");
+
+    header.payloadOffset = offset;
+    header.payloadSize = header.fileSize - offset;
+    return header;
+}
+
+/*!
+ * \brief Reads the unencrypted header of the file.
+ * \remarks This only reads the first few bytes of the file and does not decrypt or parse the contents. So it does not
+ *          require the password and does not alter the state of the instance (except for the read position if the
+ *          file is already opened). If the file is not opened, it is read via a separate read-only stream and stays
+ *          closed.
+ * \throws Throws ios_base::failure when an IO error occurs.
+ * \throws Throws Io::ParsingException when the header is invalid or truncated.
+ */
+PasswordFileHeader PasswordFile::probe()
+{
+    waitForAsyncSave();
+    if (m_file.is_open()) {
+        return readHeader(m_file);
     }
+    if (m_path.empty()) {
+        throw std::ios_base::failure("Unable to probe file because path is empty.");
+    }
+    return probe(m_path);
+}
 
-    // decrypt contents
-    vector<char> rawData;
-    m_freader.read(rawData, static_cast<streamoff>(remainingSize));
-    vector<char> decryptedData;
-    if (decrypterUsed) {
-        if (remainingSize > numeric_limits<int>::max()) {
-            throw CryptoException("Size exceeds limit.");
+/*!
+ * \brief Reads the unencrypted header of the file under the specified \a path.
+ * \remarks This only reads the first few bytes of the file and does not decrypt or parse the contents.
+ * \throws Throws ios_base::failure when an IO error occurs.
+ * \throws Throws Io::ParsingException when the header is invalid or truncated.
+ */
+PasswordFileHeader PasswordFile::probe(const std::string &path)
+{
+    NativeFileStream file;
+    file.exceptions(ios_base::failbit | ios_base::badbit);
+    file.open(path, ios_base::in | ios_base::binary);
+    return readHeader(file);
+}
+
+/*!
+ * \brief Reads the remaining data from the specified \a buffer into a buffer which can be shared with node entries.
+ */
+static std::shared_ptr<std::vector<char>> readPayload(std::streambuf *buffer)
+{
+    auto payload = std::make_shared<std::vector<char>>();
+    for (auto bytesRead = std::streamsize();;) {
+        const auto currentSize = payload->size();
+        payload->resize(currentSize + EntryParser::windowSize);
+        bytesRead = buffer->sgetn(payload->data() + currentSize, static_cast<std::streamsize>(EntryParser::windowSize));
+        payload->resize(currentSize + static_cast<std::size_t>(std::max<std::streamsize>(bytesRead, 0)));
+        if (bytesRead < static_cast<std::streamsize>(EntryParser::windowSize)) {
+            return payload;
         }
+    }
+}
 
+/*!
+ * \brief Reads the contents of the file. Opens the file if not already opened. Replaces
+ *        the current root entry with the new one constructed from the file contents.
+ * \param threadCount Specifies the number of threads to use for parsing. Specify 0 to use as many threads as
+ *                    there are CPU cores. The subtrees of the root are parsed concurrently if multiple threads
+ *                    are used (see NodeEntry::parseDeferredDescendants()). This requires the file to be saved
+ *                    with PasswordFileSaveFlags::SubtreeSizes and has no effect when loading lazily. Files saved
+ *                    with PasswordFileSaveFlags::ChunkedCompression are decompressed using that many threads.
+ * \remarks The contents are read, decrypted, decompressed and parsed chunk-wise so apart from
+ *          the entries being constructed only a fixed amount of memory is required. An exception is loading
+ *          with PasswordFileOpenFlags::LazyLoading where the decompressed contents are kept in memory until
+ *          all deferred children have been parsed (or the entries have been destroyed). When parsing
+ *          concurrently, the decompressed contents are kept in memory while loading. Files encrypted with an
+ *          authenticated cipher but without PasswordFileSaveFlags::SegmentedEncryption are decrypted into memory as a
+ *          whole so the authentication tag is verified before anything is parsed.
+ * \throws Throws ios_base::failure when an IO error occurs.
+ * \throws Throws Io::ParsingException when a parsing error occurs.
+ * \throws Throws Io::CryptoException when a decryption error occurs.
+ * \throws Throws CppUtilities::ConversionException when a conversion error occurs.
+ */
+void PasswordFile::load(std::size_t threadCount)
+{
+    waitForAsyncSave();
+    if (!m_file.is_open()) {
+        open();
+    }
+    m_version = 0;
+    m_saveOptions = PasswordFileSaveFlags::None;
+
+    // map the file into memory if enabled (or use the mapping prefetched by PasswordFileBatch); otherwise read it
+    // via the file stream
+    auto mappedFile = std::move(m_prefetchedFile);
+    auto mappedFileBuffer = std::unique_ptr<MemoryStreamBuffer>();
+    if (!mappedFile && (m_openOptions & PasswordFileOpenFlags::MemoryMapped) && !m_path.empty()) {
+        mappedFile = make_unique<MemoryMappedFile>(m_path);
+    }
+    if (mappedFile) {
+        mappedFileBuffer = make_unique<MemoryStreamBuffer>(mappedFile->data(), mappedFile->size());
+    }
+    istream input(mappedFileBuffer ? static_cast<std::streambuf *>(mappedFileBuffer.get()) : m_file.rdbuf());
+    input.exceptions(ios_base::failbit | ios_base::badbit);
+
+    // read header
+    const auto header = readHeader(input);
+    m_version = header.version;
+    m_saveOptions = header.saveOptions;
+    m_extendedHeader = header.extendedHeader;
+    if (m_saveOptions & PasswordFileSaveFlags::Compression) {
+        m_compressionCodec = header.compressionCodec;
+    }
+    if (m_saveOptions & PasswordFileSaveFlags::Encryption) {
+        m_encryptionCipher = header.encryptionCipher;
+        m_keyDerivation = header.keyDerivation;
+    }
+    if (!header.payloadSize) {
+        throw ParsingException("No contents found.");
+    }
+    input.seekg(static_cast<streamoff>(header.payloadOffset), ios_base::beg);
+    const auto decrypterUsed = static_cast<bool>(m_saveOptions & PasswordFileSaveFlags::Encryption);
+    const auto compressionUsed = static_cast<bool>(m_saveOptions & PasswordFileSaveFlags::Compression);
+    const auto remainingSize = static_cast<std::size_t>(header.payloadSize);
+    const auto *const iv = header.iv.data();
+
+    // set up the pipeline "file -> decryption -> decompression -> parser"
+    // note: Each stage only holds a fixed window of the data so the contents are never buffered as a whole. When
+    //       the file is mapped into memory, the first stage reads the mapped data directly.
+    std::streambuf *payloadBuffer = input.rdbuf();
+    auto payloadOffset = static_cast<std::size_t>(header.payloadOffset);
+    if (!threadCount) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    auto decryptingBuffer = std::unique_ptr<std::streambuf>();
+    auto *segmentedDecryptingBuffer = static_cast<SegmentedDecryptingStreamBuffer *>(nullptr);
+    auto authenticatedPayload = std::shared_ptr<std::vector<char>>();
+    if (decrypterUsed) {
         // prepare password
-        Util::OpenSsl::Sha256Sum password;
-        if (hashCount) {
-            // hash the password as often as it has been hashed when writing the file
-            password = Util::OpenSsl::computeSha256Sum(reinterpret_cast<unsigned const char *>(m_password.data()), m_password.size());
-            for (uint32_t i = 1; i < hashCount; ++i) {
-                password = Util::OpenSsl::computeSha256Sum(password.data, Util::OpenSsl::Sha256Sum::size);
-            }
+        const auto *const key = deriveKey(header.keyDerivation, threadCount);
+
+        if (m_saveOptions & PasswordFileSaveFlags::SegmentedEncryption) {
+            // decrypt the segments concurrently; each segment is authenticated before its data is parsed
+            const auto *const mappedPayload = mappedFile ? mappedFile->data() + payloadOffset : nullptr;
+            auto buffer = mappedPayload
+                ? make_unique<SegmentedDecryptingStreamBuffer>(mappedPayload, remainingSize, key, iv, m_encryptionCipher, threadCount)
+                : make_unique<SegmentedDecryptingStreamBuffer>(payloadBuffer, key, iv, m_encryptionCipher, threadCount);
+            segmentedDecryptingBuffer = buffer.get();
+            decryptingBuffer = std::move(buffer);
+        } else if (isAuthenticatedCipher(m_encryptionCipher)) {
+            // decrypt the whole data before anything is parsed so the tag is verified first; the data is kept in memory
+            // for parsing so it is only decrypted once
+            auto authenticatingBuffer = mappedFile
+                ? make_unique<DecryptingStreamBuffer>(mappedFile->data() + payloadOffset, remainingSize, key, iv, m_encryptionCipher)
+                : make_unique<DecryptingStreamBuffer>(payloadBuffer, key, iv, m_encryptionCipher);
+            authenticatedPayload = readPayload(authenticatingBuffer.get());
+            decryptingBuffer = make_unique<MemoryStreamBuffer>(authenticatedPayload->data(), authenticatedPayload->size());
         } else {
-            m_password.copy(reinterpret_cast<char *>(password.data), Util::OpenSsl::Sha256Sum::size);
-        }
-
-        // initiate ctx, decrypt data
-        EVP_CIPHER_CTX *ctx = nullptr;
-        decryptedData.resize(remainingSize + aes256additionalBufferSize);
-        int outlen1, outlen2;
-        if ((ctx = EVP_CIPHER_CTX_new()) == nullptr || EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, password.data, iv) != 1
-            || EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char *>(decryptedData.data()), &outlen1,
-                   reinterpret_cast<unsigned char *>(rawData.data()), static_cast<int>(remainingSize))
-                != 1
-            || EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char *>(decryptedData.data()) + outlen1, &outlen2) != 1) {
-            // handle decryption error
-            if (ctx) {
-                EVP_CIPHER_CTX_free(ctx);
+            // decrypt the last block upfront to detect a wrong password before anything is parsed
+            // note: In CBC mode the last block only depends on the block before (or the IV) so this is cheap.
+            if (remainingSize % aes256cbcIvSize) {
+                throw CryptoException("Size of encrypted data is not a multiple of the block size.");
             }
-            string msg;
-            auto errorCode = ERR_get_error();
-            while (errorCode) {
-                if (!msg.empty()) {
-                    msg += "\n";
-                }
-                msg += ERR_error_string(errorCode, nullptr);
-                errorCode = ERR_get_error();
+            unsigned char lastBlocks[aes256cbcIvSize * 2];
+            if (remainingSize > aes256cbcIvSize) {
+                input.seekg(-static_cast<streamoff>(sizeof(lastBlocks)), ios_base::end);
+                input.read(reinterpret_cast<char *>(lastBlocks), sizeof(lastBlocks));
+            } else {
+                std::memcpy(lastBlocks, iv, aes256cbcIvSize);
+                input.read(reinterpret_cast<char *>(lastBlocks + aes256cbcIvSize), aes256cbcIvSize);
             }
-            throw CryptoException(std::move(msg));
+            input.seekg(static_cast<streamoff>(payloadOffset), ios_base::beg);
+            verifyPadding(key, lastBlocks);
         }
 
-        if (ctx) {
-            EVP_CIPHER_CTX_free(ctx);
-        }
-        const auto decryptedSize = outlen1 + outlen2;
-        if (decryptedSize < 0) {
-            throw CryptoException("Decrypted size is negative.");
+        if (!decryptingBuffer) {
+            decryptingBuffer = mappedFile
+                ? make_unique<DecryptingStreamBuffer>(mappedFile->data() + payloadOffset, remainingSize, key, iv, m_encryptionCipher)
+                : make_unique<DecryptingStreamBuffer>(payloadBuffer, key, iv, m_encryptionCipher);
         }
-        remainingSize = static_cast<size_t>(decryptedSize);
-        if (!remainingSize) {
-            throw ParsingException("Decrypted buffer is empty.");
-        }
-
-    } else {
-        // use raw data directly if not encrypted
-        decryptedData.swap(rawData);
+        payloadBuffer = decryptingBuffer.get();
     }
 
-    // decompress
+    // parse contents
+    auto decompressingBuffer = std::unique_ptr<std::streambuf>();
+    if (decrypterUsed && payloadBuffer->sgetc() == std::streambuf::traits_type::eof()) {
+        throw ParsingException("Decrypted buffer is empty.");
+    }
     if (compressionUsed) {
-        if (remainingSize < 8) {
+        char decompressedSize[8];
+        if (payloadBuffer->sgetn(decompressedSize, sizeof(decompressedSize)) != sizeof(decompressedSize)) {
             throw ParsingException("File is truncated (decompressed size expected).");
         }
-        if (remainingSize > numeric_limits<uLongf>::max()) {
-            throw CryptoException("Size exceeds limit.");
-        }
-        const auto rawDecompressedSize = LE::toUInt64(decryptedData.data());
-        if (rawDecompressedSize > numeric_limits<uLongf>::max()) {
-            throw ParsingException("Decompressed size exceeds limit.");
+        payloadOffset += sizeof(decompressedSize);
+        const auto announcedSize = LE::toUInt64(decompressedSize);
+        const auto *const mappedPayload = mappedFile && !decryptingBuffer ? mappedFile->data() + payloadOffset : nullptr;
+        const auto mappedPayloadSize = mappedPayload ? mappedFile->size() - payloadOffset : std::size_t();
+        if (m_saveOptions & PasswordFileSaveFlags::ChunkedCompression) {
+            decompressingBuffer = mappedPayload
+                ? make_unique<ChunkedDecompressingStreamBuffer>(m_compressionCodec, mappedPayload, mappedPayloadSize, announcedSize, threadCount)
+                : make_unique<ChunkedDecompressingStreamBuffer>(m_compressionCodec, payloadBuffer, announcedSize, threadCount);
+        } else {
+            decompressingBuffer = mappedPayload
+                ? DecompressingStreamBuffer::create(m_compressionCodec, mappedPayload, mappedPayloadSize, announcedSize)
+                : DecompressingStreamBuffer::create(m_compressionCodec, payloadBuffer, announcedSize);
         }
-        auto decompressedSize = static_cast<uLongf>(rawDecompressedSize);
-        rawData.resize(decompressedSize);
-        switch (uncompress(reinterpret_cast<Bytef *>(rawData.data()), &decompressedSize, reinterpret_cast<Bytef *>(decryptedData.data() + 8),
-            static_cast<uLongf>(remainingSize - 8))) {
-        case Z_MEM_ERROR:
-            throw ParsingException("Decompressing failed. The source buffer was too small.");
-        case Z_BUF_ERROR:
-            throw ParsingException("Decompressing failed. The destination buffer was too small.");
-        case Z_DATA_ERROR:
-            throw ParsingException("Decompressing failed. The input data was corrupted or incomplete.");
-        case Z_OK:
-            decryptedData.swap(rawData);
-            remainingSize = decompressedSize;
+        payloadBuffer = decompressingBuffer.get();
+        if (payloadBuffer->sgetc() == std::streambuf::traits_type::eof()) {
+            throw ParsingException("Decompressed buffer is empty.");
         }
     }
-    if (!remainingSize) {
-        throw ParsingException("Decompressed buffer is empty.");
+    // note: The parser reads the mapped data directly if no decryption/decompression is required. For lazy loading
+    //       and concurrent parsing the parser needs a buffer which can be shared with the node entries so their
+    //       children can be parsed later/separately.
+    const auto lazy = static_cast<bool>(m_openOptions & PasswordFileOpenFlags::LazyLoading);
+    const auto concurrent = !lazy && threadCount > 1 && (m_saveOptions & PasswordFileSaveFlags::SubtreeSizes);
+    auto parser = std::optional<EntryParser>();
+    if ((lazy || concurrent) && mappedFile && !decryptingBuffer && !decompressingBuffer) {
+        const auto sharedMapping = std::shared_ptr<MemoryMappedFile>(std::move(mappedFile));
+        parser.emplace(std::shared_ptr<const char>(sharedMapping, sharedMapping->data() + payloadOffset), sharedMapping->size() - payloadOffset);
+    } else if ((lazy || concurrent) && authenticatedPayload && !decompressingBuffer) {
+        parser.emplace(std::shared_ptr<const char>(authenticatedPayload, authenticatedPayload->data()), authenticatedPayload->size());
+    } else if (lazy || concurrent) {
+        const auto payload = readPayload(payloadBuffer);
+        parser.emplace(std::shared_ptr<const char>(payload, payload->data()), payload->size());
+    } else if (mappedFile && !decryptingBuffer && !decompressingBuffer) {
+        parser.emplace(mappedFile->data() + payloadOffset, mappedFile->size() - payloadOffset);
+    } else {
+        parser.emplace(payloadBuffer);
+    }
+    if (m_version >= 0x5u) {
+        const auto extendedHeaderSize = parser->readUInt16BE();
+        m_encryptedExtendedHeader = parser->readString(extendedHeaderSize);
+    } else {
+        m_encryptedExtendedHeader.clear();
     }
-
-    // parse contents
-    stringstream decryptedStream(stringstream::in | stringstream::out | stringstream::binary);
-    decryptedStream.exceptions(ios_base::failbit | ios_base::badbit);
-    try {
-#if defined(__GLIBCXX__) && !defined(_LIBCPP_VERSION)
-        decryptedStream.rdbuf()->pubsetbuf(decryptedData.data(), static_cast<streamsize>(remainingSize));
-#else
-        decryptedStream.write(decryptedData.data(), static_cast<streamsize>(remainingSize));
-#endif
-        if (m_version >= 0x5u) {
-            BinaryReader reader(&decryptedStream);
-            const auto extendedHeaderSize = reader.readUInt16BE();
-            m_encryptedExtendedHeader = reader.readString(extendedHeaderSize);
-        } else {
-            m_encryptedExtendedHeader.clear();
-        }
-        m_rootEntry.reset(new NodeEntry(decryptedStream));
-    } catch (const std::ios_base::failure &failure) {
-        if (decryptedStream.eof()) {
-            throw ParsingException("The file seems to be truncated.");
-        }
-        throw ParsingException(argsToString("An IO error occurred when reading internal buffer: ", failure.what()));
+    auto rootEntry = std::unique_ptr<NodeEntry>(parser->parseNodeEntry());
+    if (segmentedDecryptingBuffer) {
+        segmentedDecryptingBuffer->finish(); // detect whether the data has been truncated at a segment boundary
+    } else if (decryptingBuffer && !authenticatedPayload) {
+        drainDecryptingBuffer(decryptingBuffer.get()); // check the padding
+    }
+    if (concurrent) {
+        rootEntry->parseDeferredDescendants(threadCount);
     }
+    m_rootEntry = std::move(rootEntry);
 }
 
 /*!
@@ -378,7 +745,23 @@ void PasswordFile::load()
  */
 std::uint32_t PasswordFile::mininumVersion(PasswordFileSaveFlags options) const
 {
-    if (options & PasswordFileSaveFlags::PasswordHashing) {
+    if ((options & PasswordFileSaveFlags::Encryption) && (options & PasswordFileSaveFlags::PasswordHashing)
+        && m_keyDerivation.function != KeyDerivationFunction::Sha256Iterations) {
+        return 0xDU; // storing the key derivation parameters requires at least version 13
+    } else if ((options & PasswordFileSaveFlags::Encryption) && (options & PasswordFileSaveFlags::SegmentedEncryption)
+        && isAuthenticatedCipher(m_encryptionCipher)) {
+        return 0xCU; // storing independently encrypted segments requires at least version 12
+    } else if ((options & PasswordFileSaveFlags::Encryption) && m_encryptionCipher != EncryptionCipher::Aes256Cbc) {
+        return 0xBU; // storing the encryption cipher requires at least version 11
+    } else if ((options & PasswordFileSaveFlags::Compression) && (options & PasswordFileSaveFlags::ChunkedCompression)) {
+        return 0xAU; // storing independently compressed blocks requires at least version 10
+    } else if ((options & PasswordFileSaveFlags::Compression) && m_compressionCodec != CompressionCodec::Zlib) {
+        return 0x9U; // storing the compression codec requires at least version 9
+    } else if (options & PasswordFileSaveFlags::FieldShapes) {
+        return 0x8U; // storing field shapes requires at least version 8
+    } else if (options & PasswordFileSaveFlags::SubtreeSizes) {
+        return 0x7U; // storing the size of subtrees requires at least version 7
+    } else if (options & PasswordFileSaveFlags::PasswordHashing) {
         return 0x6U; // password hashing requires at least version 6
     } else if (!m_encryptedExtendedHeader.empty()) {
         return 0x5U; // encrypted extended header requires at least version 5
@@ -391,194 +774,371 @@ std::uint32_t PasswordFile::mininumVersion(PasswordFileSaveFlags options) const
 /*!
  * \brief Writes the current root entry to the file under path() replacing its previous contents.
  * \param options Specify the features (like encryption and compression) to be used.
+ * \param threadCount Specifies the number of threads to use for compressing and encrypting when
+ *                    PasswordFileSaveFlags::ChunkedCompression and PasswordFileSaveFlags::SegmentedEncryption are used.
+ *                    Specify 0 to use as many threads as there are CPU cores.
+ * \remarks
+ * - Waits until asynchronous saves have been completed first (see saveAsync()).
+ * - The contents are written to a temporary file with a unique name next to the file. It is flushed to the disk and
+ *   renamed to the file when writing succeeded. So if saving fails (or the system crashes) the previous contents are
+ *   left intact. Symbolic links are resolved first so the file they point to is replaced. Files with further hard
+ *   links are overwritten in place (with the completely written temporary file) so the links are kept; the temporary
+ *   file is kept if that fails.
+ * - The permissions of an existing file are kept. New files are only readable and writable by the owner.
+ * - The file is opened again afterwards (read-only if it has been opened via PasswordFileOpenFlags::ReadOnly).
  * \throws Throws std::ios_base::failure when an IO error occurs.
  * \throws Throws std::filesystem::filesystem_error when a filesystem error occurs.
  * \throws Throws Io::CryptoException when an encryption error occurs.
  * \throws Throws std::runtime_error when no root entry is present or a compression error occurs.
  */
-void PasswordFile::save(PasswordFileSaveFlags options)
+void PasswordFile::save(PasswordFileSaveFlags options, std::size_t threadCount)
 {
     if (!m_rootEntry) {
         throw runtime_error("Root entry has not been created.");
     }
+    if (m_path.empty()) {
+        throw std::ios_base::failure("Unable to save file because path is empty.");
+    }
+    waitForAsyncSave();
+
+    // check whether the file exists unless creating a new file is allowed
+    const auto targetPath = resolveSymbolicLinks(m_path);
+    const auto nativePath = std::filesystem::path(makeNativePath(targetPath));
+    const auto existingStatus = std::filesystem::status(nativePath);
+    const auto existing = std::filesystem::exists(existingStatus);
+    if (!existing && !(options & PasswordFileSaveFlags::AllowToCreateNewFile)) {
+        throw std::ios_base::failure("Unable to save file because it does not exist.");
+    }
+
+    // write entries to a temporary file
+    close();
+    const auto temporaryPath = createTemporaryFile(targetPath);
+    const auto nativeTemporaryPath = std::filesystem::path(makeNativePath(temporaryPath));
+    try {
+        m_file.open(temporaryPath, ios_base::in | ios_base::out | ios_base::trunc | ios_base::binary);
+        write(options, threadCount);
+        m_file.close();
+        syncToDisk(temporaryPath, false);
+    } catch (...) {
+        close();
+        auto error = std::error_code();
+        std::filesystem::remove(nativeTemporaryPath, error);
+        throw;
+    }
 
-    // use already opened and writable file; otherwise re-open the file
-    auto fileSize = std::size_t();
-    if (m_file.good() && m_file.is_open() && !(m_openOptions & PasswordFileOpenFlags::ReadOnly)) {
-        fileSize = size();
-        m_file.seekp(0);
+    // replace the file with the temporary file
+    if (existing && std::filesystem::hard_link_count(nativePath) > 1) {
+        NativeFileStream input, output;
+        input.exceptions(ios_base::failbit | ios_base::badbit);
+        output.exceptions(ios_base::failbit | ios_base::badbit);
+        input.open(temporaryPath, ios_base::in | ios_base::binary);
+        output.open(targetPath, ios_base::out | ios_base::trunc | ios_base::binary);
+        output << input.rdbuf();
+        output.close();
+        input.close();
+        syncToDisk(targetPath, false);
+        std::filesystem::remove(nativeTemporaryPath);
     } else {
-        m_file.clear();
-        if (m_file.is_open()) {
-            m_file.close();
-        }
-        try {
-            m_file.open(m_path, ios_base::in | ios_base::out | ios_base::trunc | ios_base::binary);
-        } catch (const ios_base::failure &) {
-            // try to create a new file if configured via \a options
-            if (!(options & PasswordFileSaveFlags::AllowToCreateNewFile)) {
-                throw;
-            }
-            m_file.open(m_path, ios_base::out | ios_base::trunc | ios_base::binary);
+        if (existing) {
+            std::filesystem::permissions(nativeTemporaryPath, existingStatus.permissions());
         }
+        std::filesystem::rename(nativeTemporaryPath, nativePath);
+        const auto directory = nativePath.parent_path();
+        syncToDisk(directory.empty() ? std::string(".") : directory.string(), true);
     }
+    m_file.open(m_path, fileOpenMode(m_openOptions));
+}
 
-    // write entries
-    write(options);
-    m_file.flush();
+/*!
+ * \brief Writes the current root entry to the file under path() on a background thread.
+ * \param options Specify the features (like encryption and compression) to be used.
+ * \returns Returns a future which is fulfilled when the file has been saved. It holds the exception save() would have
+ *          thrown if saving fails.
+ * \remarks
+ * - A snapshot of the entries, the path, the password and the headers is taken before returning so this instance can
+ *   be modified while saving. Taking the snapshot copies the entries (sharing the data of deferred and cached children,
+ *   see NodeEntry::NodeEntry(const NodeEntry &)). Everything else (key derivation, serialization, compression,
+ *   encryption and I/O) happens on the background thread.
+ * - When a save is still pending, its snapshot is replaced and the same future is returned. So back-to-back saves are
+ *   coalesced into one save of the most recent snapshot.
+ * - The snapshot is saved via its own file stream so fileStream(), version() and saveOptions() of this instance are
+ *   not affected. Saving synchronously, loading, probing, querying the size and destroying this instance waits for
+ *   asynchronous saves first. Then fileStream() is opened again because the file has been replaced (see
+ *   waitForAsyncSave()).
+ * \throws Throws std::runtime_error when no root entry is present.
+ */
+std::shared_future<void> PasswordFile::saveAsync(PasswordFileSaveFlags options)
+{
+    if (!m_rootEntry) {
+        throw runtime_error("Root entry has not been created.");
+    }
+    auto snapshot = make_unique<PasswordFile>(*this);
+    if (const auto *const mostRecentParameters = m_keyCache.mostRecentParameters()) {
+        const auto parameters = *mostRecentParameters;
+        if (const auto *const key = m_keyCache.find(parameters)) {
+            snapshot->m_keyCache.insert(parameters, key); // save the snapshot with the same parameters without deriving again
+        }
+    }
+    if (!m_asyncSaveWorker) {
+        m_asyncSaveWorker = make_unique<AsyncSaveWorker>();
+    }
+    return m_asyncSaveWorker->enqueue(std::move(snapshot), options);
+}
 
-    // truncate file if it became smaller
-    const auto newSize = static_cast<std::size_t>(m_file.tellp());
-    if (fileSize && newSize < fileSize) {
-        m_file.close();
-        std::filesystem::resize_file(makeNativePath(m_path), newSize);
+/*!
+ * \brief Waits until asynchronous saves have been completed (see saveAsync()).
+ * \remarks
+ * - Errors are not thrown; they are reported via the futures returned by saveAsync().
+ * - Saving replaces the file (see save()) so fileStream() would still refer to the replaced file. Hence the file is
+ *   opened again (in the same mode) if it is open and a snapshot has been saved.
+ * \throws Throws ios_base::failure when the file can not be opened again.
+ */
+void PasswordFile::waitForAsyncSave()
+{
+    if (!m_asyncSaveWorker || !m_asyncSaveWorker->wait() || !m_file.is_open()) {
+        return;
+    }
+    close();
+    m_file.open(m_path, fileOpenMode(m_openOptions));
+}
+
+/*!
+ * \brief Returns the number of bytes write() would produce with the specified \a options without actually serializing
+ *        the entries.
+ * \remarks The size of the compressed data can not be determined without compressing. So when compression is used,
+ *          the size of the decompressed data is taken into account instead which makes the returned size an estimation.
+ * \throws Throws std::runtime_error when no root entry is present.
+ */
+std::uint64_t PasswordFile::serializedSize(PasswordFileSaveFlags options) const
+{
+    if (!m_rootEntry) {
+        throw runtime_error("Root entry has not been created.");
+    }
+    const auto version = mininumVersion(options);
+    auto size = std::uint64_t(4 + 4 + 1); // magic number, version and flags
+    if (version >= 0x9U && (options & PasswordFileSaveFlags::Compression)) {
+        size += 1; // compression codec
+    }
+    if (version >= 0x4U) {
+        size += 2 + m_extendedHeader.size();
     }
+    auto payloadSize = serializedPayloadSize(version, entrySerializationFlags(options));
+    if (options & PasswordFileSaveFlags::Compression) {
+        if (options & PasswordFileSaveFlags::ChunkedCompression) {
+            const auto blockSize = ChunkedCompressingStreamBuffer::blockSize;
+            payloadSize += (payloadSize + blockSize - 1) / blockSize * 8; // index entries of the blocks
+        }
+        payloadSize += 8;
+    }
+    if (!(options & PasswordFileSaveFlags::Encryption)) {
+        return size + payloadSize;
+    }
+    if (version >= 0xDU) {
+        size += 1 + 4 + 4 + 4 + KeyDerivationParameters::saltSize; // key derivation parameters
+    } else if (version >= 0x6U && (options & PasswordFileSaveFlags::PasswordHashing)) {
+        size += 4; // hash count
+    }
+    if (version >= 0xBU) {
+        // note: Authenticated ciphers do not pad the data but append the authentication tag (to each segment).
+        size += 1 + encryptionCipherIvSize(m_encryptionCipher); // encryption cipher and IV
+        if (version >= 0xCU && (options & PasswordFileSaveFlags::SegmentedEncryption)) {
+            const auto segmentSize = SegmentedEncryptingStreamBuffer::segmentSize;
+            return size + payloadSize + (payloadSize / segmentSize + 1) * authenticationTagSize;
+        }
+        return size + payloadSize + authenticationTagSize;
+    }
+    // note: PKCS #7 padding always adds at least one byte and pads to a multiple of the block size (which equals the IV size)
+    return size + aes256cbcIvSize + (payloadSize / aes256cbcIvSize + 1) * aes256cbcIvSize;
+}
+
+/*!
+ * \brief Returns the size of the encrypted extended header and the entries before compression and encryption.
+ */
+std::uint64_t PasswordFile::serializedPayloadSize(std::uint32_t version, EntrySerializationFlags flags) const
+{
+    const auto entriesSize = m_rootEntry->serializedSize(flags);
+    return version >= 0x5U ? 2 + m_encryptedExtendedHeader.size() + entriesSize : entriesSize;
 }
 
 /*!
  * \brief Writes the current root entry to the file which is assumed to be opened and writeable.
  * \param options Specify the features (like encryption and compression) to be used.
+ * \param threadCount Specifies the number of threads to use for compressing and encrypting when
+ *                    PasswordFileSaveFlags::ChunkedCompression and PasswordFileSaveFlags::SegmentedEncryption are used.
+ *                    Specify 0 to use as many threads as there are CPU cores.
+ * \remarks The entries are serialized, compressed, encrypted and written chunk-wise so only a fixed amount of memory
+ *          is required. When compression is used, the size of the decompressed data is computed upfront via
+ *          Entry::serializedSize(). With PasswordFileSaveFlags::CacheSubtrees, the serialized children of node
+ *          entries are kept in memory so unmodified subtrees are copied as-is when saving again. With
+ *          PasswordFileSaveFlags::ChunkedCompression, the data is split into blocks which are compressed concurrently
+ *          (see ChunkedCompressingStreamBuffer); up to one block per thread is kept in memory then. The same goes for
+ *          PasswordFileSaveFlags::SegmentedEncryption and the encrypted segments (see SegmentedEncryptingStreamBuffer).
  * \throws Throws std::ios_base::failure when an IO error occurs.
  * \throws Throws Io::CryptoException when an encryption error occurs.
- * \throws Throws std::runtime_error when no root entry is present, a compression error occurs.
+ * \throws Throws std::runtime_error when no root entry is present, a compression error occurs or the size of the
+ *         serialized entries differs from the size computed upfront.
  */
-void PasswordFile::write(PasswordFileSaveFlags options)
+void PasswordFile::write(PasswordFileSaveFlags options, std::size_t threadCount)
 {
     if (!m_rootEntry) {
         throw runtime_error("Root entry has not been created.");
     }
+    if ((options & PasswordFileSaveFlags::Compression) && !isCompressionCodecSupported(m_compressionCodec)) {
+        throw runtime_error(argsToString("Compressing failed. The codec \"", compressionCodecName(m_compressionCodec), "\" is not supported."));
+    }
+
+    const auto version = mininumVersion(options);
+    if (version >= 0x4U && m_extendedHeader.size() > numeric_limits<std::uint16_t>::max()) {
+        throw runtime_error("Extended header exceeds maximum size.");
+    }
+    if (version >= 0x5U && m_encryptedExtendedHeader.size() > numeric_limits<std::uint16_t>::max()) {
+        throw runtime_error("Encrypted extended header exceeds maximum size.");
+    }
+    if (!threadCount) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // prepare password
+    // note: This happens before writing anything so invalid key derivation parameters do not leave a truncated file.
+    //       The hash count of the most recently used key is re-used so the key does not need to be derived again
+    //       unless the parameters are calibrated.
+    auto keyDerivation = KeyDerivationParameters();
+    const unsigned char *key = nullptr;
+    if (options & PasswordFileSaveFlags::Encryption) {
+        const auto calibrate = (options & PasswordFileSaveFlags::PasswordHashing) && (options & PasswordFileSaveFlags::CalibrateKeyDerivation);
+        if (calibrate) {
+            m_keyDerivation = calibrateKeyDerivation(m_keyDerivation, m_keyDerivationDuration, threadCount);
+        }
+        if ((options & PasswordFileSaveFlags::PasswordHashing) && (version >= 0xDU || calibrate)) {
+            keyDerivation = m_keyDerivation;
+        } else if (options & PasswordFileSaveFlags::PasswordHashing) {
+            keyDerivation.iterations = m_keyCache.mostRecentHashCount();
+            if (!keyDerivation.iterations) {
+                keyDerivation.iterations = Util::OpenSsl::generateRandomNumber(1, 100);
+            }
+        }
+        key = deriveKey(keyDerivation, threadCount);
+    }
 
     // write magic number
     m_fwriter.writeUInt32LE(0x7770616DU);
 
     // write version
-    const auto version = mininumVersion(options);
     m_fwriter.writeUInt32LE(version);
 
     // write flags
     std::uint8_t flags = 0x00;
     if (options & PasswordFileSaveFlags::Encryption) {
         flags |= 0x80 | 0x40;
+        if (version >= 0xCU && (options & PasswordFileSaveFlags::SegmentedEncryption)) {
+            flags |= 0x08;
+        }
     }
     if (options & PasswordFileSaveFlags::Compression) {
         flags |= 0x20;
+        if (version >= 0xAU && (options & PasswordFileSaveFlags::ChunkedCompression)) {
+            flags |= 0x10;
+        }
+    }
+    if (version >= 0x7U && (options & PasswordFileSaveFlags::PasswordHashing)) {
+        flags |= 0x04;
+    }
+    if (version >= 0x7U && (options & PasswordFileSaveFlags::SubtreeSizes)) {
+        flags |= 0x02;
+    }
+    if (version >= 0x8U && (options & PasswordFileSaveFlags::FieldShapes)) {
+        flags |= 0x01;
     }
     m_fwriter.writeByte(flags);
 
+    // write compression codec
+    if (version >= 0x9U && (options & PasswordFileSaveFlags::Compression)) {
+        m_fwriter.writeByte(static_cast<std::uint8_t>(m_compressionCodec));
+    }
+
+    // write encryption cipher
+    if (version >= 0xBU && (options & PasswordFileSaveFlags::Encryption)) {
+        m_fwriter.writeByte(static_cast<std::uint8_t>(m_encryptionCipher));
+    }
+
     // write extended header
     if (version >= 0x4U) {
-        if (m_extendedHeader.size() > numeric_limits<std::uint16_t>::max()) {
-            throw runtime_error("Extended header exceeds maximum size.");
-        }
         m_fwriter.writeUInt16BE(static_cast<std::uint16_t>(m_extendedHeader.size()));
         m_fwriter.writeString(m_extendedHeader);
     }
 
-    // serialize root entry and descendants
-    stringstream buffstr(stringstream::in | stringstream::out | stringstream::binary);
-    buffstr.exceptions(ios_base::failbit | ios_base::badbit);
+    // prepare serialization of the encrypted extended header, the root entry and its descendants
+    const auto serializationFlags = entrySerializationFlags(options);
+    const auto serialize = [this, version, serializationFlags](std::ostream &stream) {
+        if (version >= 0x5U) {
+            BinaryWriter writer(&stream);
+            writer.writeUInt16BE(static_cast<std::uint16_t>(m_encryptedExtendedHeader.size()));
+            writer.writeString(m_encryptedExtendedHeader);
+        }
+        m_rootEntry->make(stream, serializationFlags);
+    };
 
-    // write encrypted extended header
-    if (version >= 0x5U) {
-        if (m_encryptedExtendedHeader.size() > numeric_limits<std::uint16_t>::max()) {
-            throw runtime_error("Encrypted extended header exceeds maximum size.");
+    // set up the pipeline "serializer -> compression -> encryption -> file"
+    // note: Each stage only holds a fixed window of the data so the contents are never buffered as a whole.
+    std::streambuf *payloadBuffer = m_file.rdbuf();
+    auto encryptingBuffer = std::optional<EncryptingStreamBuffer>();
+    auto segmentedEncryptingBuffer = std::optional<SegmentedEncryptingStreamBuffer>();
+    if (options & PasswordFileSaveFlags::Encryption) {
+        // write key derivation parameters (or only the hash count) and IV
+        const auto cipher = version >= 0xBU ? m_encryptionCipher : EncryptionCipher::Aes256Cbc;
+        const auto ivSize = encryptionCipherIvSize(cipher);
+        unsigned char iv[aes256cbcIvSize];
+        Util::OpenSslRandomDevice().generate(iv, ivSize);
+        if (version >= 0xDU) {
+            m_fwriter.writeByte(static_cast<std::uint8_t>(keyDerivation.function));
+            m_fwriter.writeUInt32BE(keyDerivation.iterations);
+            m_fwriter.writeUInt32BE(keyDerivation.memoryCost);
+            m_fwriter.writeUInt32BE(keyDerivation.parallelism);
+            m_file.write(reinterpret_cast<const char *>(keyDerivation.salt.data()), static_cast<streamsize>(keyDerivation.salt.size()));
+        } else if (version >= 0x6U && (options & PasswordFileSaveFlags::PasswordHashing)) {
+            m_fwriter.writeUInt32BE(keyDerivation.iterations);
         }
-        BinaryWriter buffstrWriter(&buffstr);
-        buffstrWriter.writeUInt16BE(static_cast<std::uint16_t>(m_encryptedExtendedHeader.size()));
-        buffstrWriter.writeString(m_encryptedExtendedHeader);
-    }
-    m_rootEntry->make(buffstr);
-    buffstr.seekp(0, ios_base::end);
-    auto size = static_cast<std::size_t>(buffstr.tellp());
-    if (size > std::numeric_limits<uLong>::max()) {
-        throw std::runtime_error("File size exceeds maximum size.");
+        m_file.write(reinterpret_cast<char *>(iv), static_cast<streamsize>(ivSize));
+        payloadBuffer = version >= 0xCU && (options & PasswordFileSaveFlags::SegmentedEncryption)
+            ? static_cast<std::streambuf *>(&segmentedEncryptingBuffer.emplace(payloadBuffer, key, iv, cipher, threadCount))
+            : static_cast<std::streambuf *>(&encryptingBuffer.emplace(payloadBuffer, key, iv, cipher));
     }
-
-    // write the data to a buffer
-    buffstr.seekg(0);
-    vector<char> decryptedData(size, 0);
-    buffstr.read(decryptedData.data(), static_cast<streamoff>(size));
-    vector<char> encryptedData;
-
-    // compress data
+    auto compressingBuffer = std::unique_ptr<CompressingStreamBuffer>();
+    auto announcedSize = std::uint64_t();
     if (options & PasswordFileSaveFlags::Compression) {
-        auto compressedSize = static_cast<uLongf>(compressBound(static_cast<uLong>(size)));
-        encryptedData.resize(8 + compressedSize);
-        LE::getBytes(static_cast<std::uint64_t>(size), encryptedData.data());
-        switch (compress(reinterpret_cast<Bytef *>(encryptedData.data() + 8), &compressedSize, reinterpret_cast<Bytef *>(decryptedData.data()),
-            static_cast<uLong>(size))) {
-        case Z_MEM_ERROR:
-            throw runtime_error("Compressing failed. The source buffer was too small.");
-        case Z_BUF_ERROR:
-            throw runtime_error("Compressing failed. The destination buffer was too small.");
-        case Z_OK:
-            encryptedData.swap(decryptedData); // compression successful
-            size = 8 + compressedSize;
+        // write the size of the decompressed data (which is computed upfront without serializing)
+        char decompressedSize[8];
+        announcedSize = serializedPayloadSize(version, serializationFlags);
+        LE::getBytes(announcedSize, decompressedSize);
+        if (payloadBuffer->sputn(decompressedSize, sizeof(decompressedSize)) != sizeof(decompressedSize)) {
+            throw ios_base::failure("Unable to write decompressed size.");
         }
-    }
-
-    if (size > numeric_limits<int>::max()) {
-        throw CryptoException("size exceeds limit");
-    }
-
-    // write data without encryption
-    if (!(options & PasswordFileSaveFlags::Encryption)) {
-        // write data to file
-        m_file.write(decryptedData.data(), static_cast<streamsize>(size));
-        m_file.flush();
-        return;
-    }
-
-    // prepare password
-    Util::OpenSsl::Sha256Sum password;
-    const uint32_t hashCount = (options & PasswordFileSaveFlags::PasswordHashing) ? Util::OpenSsl::generateRandomNumber(1, 100) : 0u;
-    if (hashCount) {
-        // hash password a few times
-        password = Util::OpenSsl::computeSha256Sum(reinterpret_cast<unsigned const char *>(m_password.data()), m_password.size());
-        for (uint32_t i = 1; i < hashCount; ++i) {
-            password = Util::OpenSsl::computeSha256Sum(password.data, Util::OpenSsl::Sha256Sum::size);
+        if (options & PasswordFileSaveFlags::ChunkedCompression) {
+            compressingBuffer = make_unique<ChunkedCompressingStreamBuffer>(m_compressionCodec, payloadBuffer, m_compressionLevel, threadCount);
+        } else {
+            compressingBuffer = CompressingStreamBuffer::create(m_compressionCodec, payloadBuffer, m_compressionLevel);
         }
-    } else {
-        m_password.copy(reinterpret_cast<char *>(password.data), Util::OpenSsl::Sha256Sum::size);
+        payloadBuffer = compressingBuffer.get();
     }
 
-    // initiate ctx, encrypt data
-    EVP_CIPHER_CTX *ctx = nullptr;
-    unsigned char iv[aes256cbcIvSize];
-    int outlen1, outlen2;
-    encryptedData.resize(size + aes256additionalBufferSize);
-    if (RAND_bytes(iv, aes256cbcIvSize) != 1 || (ctx = EVP_CIPHER_CTX_new()) == nullptr
-        || EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, password.data, iv) != 1
-        || EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char *>(encryptedData.data()), &outlen1,
-               reinterpret_cast<unsigned char *>(decryptedData.data()), static_cast<int>(size))
-            != 1
-        || EVP_EncryptFinal_ex(ctx, reinterpret_cast<unsigned char *>(encryptedData.data()) + outlen1, &outlen2) != 1) {
-        // handle encryption error
-        if (ctx) {
-            EVP_CIPHER_CTX_free(ctx);
-        }
-        string msg;
-        auto errorCode = ERR_get_error();
-        while (errorCode) {
-            if (!msg.empty()) {
-                msg += "\n";
-            }
-            msg += ERR_error_string(errorCode, nullptr);
-            errorCode = ERR_get_error();
+    // serialize entries
+    ostream payloadStream(payloadBuffer);
+    payloadStream.exceptions(ios_base::failbit | ios_base::badbit);
+    serialize(payloadStream);
+    if (compressingBuffer) {
+        compressingBuffer->finish();
+        // ensure the file can be decompressed again; otherwise the entries have been modified without noticing
+        if (compressingBuffer->uncompressedSize() != announcedSize) {
+            throw runtime_error(argsToString("Compressing failed. The size of the serialized entries (",
+                compressingBuffer->uncompressedSize(), " bytes) differs from the announced size (", announcedSize, " bytes)."));
         }
-        throw CryptoException(std::move(msg));
     }
-
-    if (ctx) {
-        EVP_CIPHER_CTX_free(ctx);
+    if (encryptingBuffer) {
+        encryptingBuffer->finish();
     }
-
-    // write encrypted data to file
-    if (version >= 0x6U) {
-        m_fwriter.writeUInt32BE(hashCount);
+    if (segmentedEncryptingBuffer) {
+        segmentedEncryptingBuffer->finish();
     }
-    m_file.write(reinterpret_cast<char *>(iv), aes256cbcIvSize);
-    m_file.write(encryptedData.data(), static_cast<streamsize>(outlen1 + outlen2));
     m_file.flush();
 }
 
@@ -753,6 +1313,7 @@ bool PasswordFile::isEncryptionUsed()
  */
 size_t PasswordFile::size()
 {
+    waitForAsyncSave();
     if (!isOpen()) {
         return 0;
     }
@@ -778,6 +1339,16 @@ string PasswordFile::summary(PasswordFileSaveFlags saveOptions) const
     if (m_saveOptions != saveOptions) {
         result += argsToString("<tr><td></td><td>(on disk, after saving: ", flagsToString(saveOptions), ")</td></tr>");
     }
+    if ((m_saveOptions | saveOptions) & PasswordFileSaveFlags::Compression) {
+        result += argsToString("<tr><td>Compression codec:</td><td>", compressionCodecName(m_compressionCodec), "</td></tr>");
+    }
+    if ((m_saveOptions | saveOptions) & PasswordFileSaveFlags::Encryption) {
+        result += argsToString("<tr><td>Encryption cipher:</td><td>", encryptionCipherName(m_encryptionCipher), "</td></tr>");
+        if (((m_saveOptions | saveOptions) & PasswordFileSaveFlags::PasswordHashing)
+            && (m_keyDerivation.function != KeyDerivationFunction::Sha256Iterations || m_keyDerivation.iterations)) {
+            result += argsToString("<tr><td>Key derivation:</td><td>", keyDerivationParametersToString(m_keyDerivation), "</td></tr>");
+        }
+    }
     const auto stats = m_rootEntry ? m_rootEntry->computeStatistics() : EntryStatistics();
     result += argsToString("<tr><td>Number of categories:</td><td>", stats.nodeCount, "</td></tr><tr><td>Number of accounts:</td><td>",
         stats.accountCount, "</td></tr><tr><td>Number of fields:</td><td>", stats.fieldCount, "</td></tr></table>");
@@ -793,6 +1364,12 @@ string flagsToString(PasswordFileOpenFlags flags)
     if (flags & PasswordFileOpenFlags::ReadOnly) {
         options.emplace_back("read-only");
     }
+    if (flags & PasswordFileOpenFlags::MemoryMapped) {
+        options.emplace_back("memory-mapped");
+    }
+    if (flags & PasswordFileOpenFlags::LazyLoading) {
+        options.emplace_back("lazy loading");
+    }
     if (options.empty()) {
         options.emplace_back("none");
     }
@@ -805,7 +1382,7 @@ string flagsToString(PasswordFileOpenFlags flags)
 string flagsToString(PasswordFileSaveFlags flags)
 {
     vector<string> options;
-    options.reserve(3);
+    options.reserve(5);
     if (flags & PasswordFileSaveFlags::Encryption) {
         options.emplace_back("encryption");
     }
@@ -815,6 +1392,21 @@ string flagsToString(PasswordFileSaveFlags flags)
     if (flags & PasswordFileSaveFlags::PasswordHashing) {
         options.emplace_back("password hashing");
     }
+    if (flags & PasswordFileSaveFlags::SubtreeSizes) {
+        options.emplace_back("subtree sizes");
+    }
+    if (flags & PasswordFileSaveFlags::FieldShapes) {
+        options.emplace_back("field shapes");
+    }
+    if (flags & PasswordFileSaveFlags::CacheSubtrees) {
+        options.emplace_back("cached subtrees");
+    }
+    if (flags & PasswordFileSaveFlags::ChunkedCompression) {
+        options.emplace_back("chunked compression");
+    }
+    if (flags & PasswordFileSaveFlags::SegmentedEncryption) {
+        options.emplace_back("segmented encryption");
+    }
     if (options.empty()) {
         options.emplace_back("none");
     }
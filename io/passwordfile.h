@@ -1,6 +1,10 @@
 #ifndef PASSWORD_FILE_IO_PASSWORD_FILE_H
 #define PASSWORD_FILE_IO_PASSWORD_FILE_H
 
+#include "./compressioncodec.h"
+#include "./derivedkeycache.h"
+#include "./encryptioncipher.h"
+
 #include "../global.h"
 
 #include <c++utilities/io/binaryreader.h>
@@ -8,19 +12,27 @@
 #include <c++utilities/io/nativefilestream.h>
 #include <c++utilities/misc/flagenumclass.h>
 
+#include <array>
 #include <cstdint>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace Io {
 
+class AsyncSaveWorker;
+class MemoryMappedFile;
 class NodeEntry;
+enum class EntrySerializationFlags : std::uint64_t;
 
 enum class PasswordFileOpenFlags : std::uint64_t {
     None = 0,
     ReadOnly = 1,
+    MemoryMapped = 2,
+    LazyLoading = 4,
     Default = None,
 };
 
@@ -32,11 +44,37 @@ enum class PasswordFileSaveFlags : std::uint64_t {
     Compression = 2,
     PasswordHashing = 4,
     AllowToCreateNewFile = 8,
+    SubtreeSizes = 16,
+    FieldShapes = 32,
+    CacheSubtrees = 64,
+    ChunkedCompression = 128,
+    SegmentedEncryption = 256,
+    CalibrateKeyDerivation = 512,
     Default = Encryption | Compression | PasswordHashing | AllowToCreateNewFile,
 };
 
 PASSWORD_FILE_EXPORT std::string flagsToString(PasswordFileSaveFlags flags);
 
+/*!
+ * \brief The PasswordFileHeader struct holds the information from the unencrypted header of a file.
+ * \sa PasswordFile::probe()
+ */
+struct PASSWORD_FILE_EXPORT PasswordFileHeader {
+    std::uint32_t version = 0; /**< the file version */
+    PasswordFileSaveFlags saveOptions = PasswordFileSaveFlags::None; /**< the features the file has been saved with */
+    CompressionCodec compressionCodec = CompressionCodec::Zlib; /**< the codec used for compression (only relevant if compression is used) */
+    EncryptionCipher encryptionCipher = EncryptionCipher::Aes256Cbc; /**< the cipher used for encryption (only relevant if encryption is used) */
+    bool ivUsed = false; /**< whether an initialization vector is present (only relevant if encryption is used) */
+    std::uint32_t hashCount = 0; /**< how often the password has been hashed (only relevant if password hashing is used) */
+    KeyDerivationParameters keyDerivation; /**< how the key has been derived (only relevant if encryption is used, see hashCount for
+                                                versions prior to 13) */
+    std::array<unsigned char, 16> iv = {}; /**< the IV (only relevant if ivUsed is set, see encryptionCipherIvSize() for its size) */
+    std::string extendedHeader; /**< the unencrypted extended header */
+    std::uint64_t fileSize = 0; /**< the size of the whole file */
+    std::uint64_t payloadOffset = 0; /**< the offset of the (possibly encrypted and compressed) contents */
+    std::uint64_t payloadSize = 0; /**< the size of the (possibly encrypted and compressed) contents */
+};
+
 class PASSWORD_FILE_EXPORT PasswordFile {
 public:
     explicit PasswordFile();
@@ -50,10 +88,15 @@ public:
     void generateRootEntry();
     void create();
     void close();
-    void load();
+    PasswordFileHeader probe();
+    static PasswordFileHeader probe(const std::string &path);
+    void load(std::size_t threadCount = 1);
     std::uint32_t mininumVersion(PasswordFileSaveFlags options) const;
-    void save(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default);
-    void write(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default);
+    void save(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default, std::size_t threadCount = 0);
+    void write(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default, std::size_t threadCount = 0);
+    std::shared_future<void> saveAsync(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default);
+    void waitForAsyncSave();
+    std::uint64_t serializedSize(PasswordFileSaveFlags options = PasswordFileSaveFlags::Default) const;
     void clearEntries();
     void clear();
     void exportToTextfile(const std::string &targetPath) const;
@@ -78,11 +121,28 @@ public:
     std::uint32_t version() const;
     PasswordFileOpenFlags openOptions() const;
     PasswordFileSaveFlags saveOptions() const;
+    CompressionCodec compressionCodec() const;
+    void setCompressionCodec(CompressionCodec codec);
+    std::optional<int> compressionLevel() const;
+    void setCompressionLevel(std::optional<int> level);
+    EncryptionCipher encryptionCipher() const;
+    void setEncryptionCipher(EncryptionCipher cipher);
+    const KeyDerivationParameters &keyDerivation() const;
+    void setKeyDerivation(const KeyDerivationParameters &parameters);
+    std::chrono::milliseconds keyDerivationDuration() const;
+    void setKeyDerivationDuration(std::chrono::milliseconds duration);
     std::string summary(PasswordFileSaveFlags saveOptions) const;
+    const DerivedKeyCache &keyCache() const;
 
 private:
+    friend class PasswordFileBatch;
+
+    const unsigned char *deriveKey(const KeyDerivationParameters &parameters, std::size_t threadCount = 1);
+    std::uint64_t serializedPayloadSize(std::uint32_t version, EntrySerializationFlags flags) const;
+
     std::string m_path;
     std::string m_password;
+    DerivedKeyCache m_keyCache;
     std::unique_ptr<NodeEntry> m_rootEntry;
     std::string m_extendedHeader;
     std::string m_encryptedExtendedHeader;
@@ -92,6 +152,13 @@ private:
     std::uint32_t m_version;
     PasswordFileOpenFlags m_openOptions;
     PasswordFileSaveFlags m_saveOptions;
+    CompressionCodec m_compressionCodec;
+    std::optional<int> m_compressionLevel;
+    EncryptionCipher m_encryptionCipher;
+    KeyDerivationParameters m_keyDerivation;
+    std::chrono::milliseconds m_keyDerivationDuration;
+    std::unique_ptr<AsyncSaveWorker> m_asyncSaveWorker;
+    std::unique_ptr<MemoryMappedFile> m_prefetchedFile;
 };
 
 /*!
@@ -129,25 +196,31 @@ inline const std::string &PasswordFile::password() const
 
 /*!
  * \brief Sets the current password. It will be used when loading an encrypted file or when saving using encryption.
+ * \remarks Clears the keyCache() if the password changes.
  */
 inline void PasswordFile::setPassword(const std::string &password)
 {
-    m_password = password;
+    setPassword(password.data(), password.size());
 }
 
 /*!
  * \brief Sets the current password. It will be used when loading an encrypted file or when saving using encryption.
+ * \remarks Clears the keyCache() if the password changes.
  */
 inline void PasswordFile::setPassword(const char *password, const size_t passwordSize)
 {
-    m_password.assign(password, passwordSize);
+    if (m_password.compare(0, std::string::npos, password, passwordSize)) {
+        m_keyCache.clear();
+        m_password.assign(password, passwordSize);
+    }
 }
 
 /*!
- * \brief Clears the current password.
+ * \brief Clears the current password and the keyCache().
  */
 inline void PasswordFile::clearPassword()
 {
+    m_keyCache.clear();
     m_password.clear();
 }
 
@@ -216,6 +289,111 @@ inline PasswordFileSaveFlags PasswordFile::saveOptions() const
     return m_saveOptions;
 }
 
+/*!
+ * \brief Returns the codec used for compression.
+ * \remarks This is the codec the file has been loaded with or the codec set via setCompressionCodec(). It is only
+ *          relevant when PasswordFileSaveFlags::Compression is used.
+ */
+inline CompressionCodec PasswordFile::compressionCodec() const
+{
+    return m_compressionCodec;
+}
+
+/*!
+ * \brief Sets the codec used for compression when saving the next time.
+ * \remarks Codecs other than CompressionCodec::Zlib require at least version 9. See mininumVersion().
+ */
+inline void PasswordFile::setCompressionCodec(CompressionCodec codec)
+{
+    m_compressionCodec = codec;
+}
+
+/*!
+ * \brief Returns the compression level used when saving or an empty optional if the codec's default is used.
+ */
+inline std::optional<int> PasswordFile::compressionLevel() const
+{
+    return m_compressionLevel;
+}
+
+/*!
+ * \brief Sets the compression level used when saving.
+ * \remarks The level is not stored in the file. See CompressingStreamBuffer::create() for the meaning of the level.
+ */
+inline void PasswordFile::setCompressionLevel(std::optional<int> level)
+{
+    m_compressionLevel = level;
+}
+
+/*!
+ * \brief Returns the cipher used for encryption.
+ * \remarks This is the cipher the file has been loaded with or the cipher set via setEncryptionCipher(). It is only
+ *          relevant when PasswordFileSaveFlags::Encryption is used.
+ */
+inline EncryptionCipher PasswordFile::encryptionCipher() const
+{
+    return m_encryptionCipher;
+}
+
+/*!
+ * \brief Sets the cipher used for encryption when saving the next time.
+ * \remarks Ciphers other than EncryptionCipher::Aes256Cbc require at least version 11. See mininumVersion(). Use
+ *          preferredAuthenticatedCipher() to select the authenticated cipher which is fastest on the current CPU.
+ */
+inline void PasswordFile::setEncryptionCipher(EncryptionCipher cipher)
+{
+    m_encryptionCipher = cipher;
+}
+
+/*!
+ * \brief Returns the parameters used to derive the key from the password when using PasswordFileSaveFlags::PasswordHashing.
+ * \remarks These are the parameters the file has been loaded with or the parameters set via setKeyDerivation(). With
+ *          KeyDerivationFunction::Sha256Iterations (the default), a random number of iterations is chosen when saving
+ *          (unless a key is cached) and the iterations specified here are not used.
+ */
+inline const KeyDerivationParameters &PasswordFile::keyDerivation() const
+{
+    return m_keyDerivation;
+}
+
+/*!
+ * \brief Sets the parameters used to derive the key from the password when saving the next time.
+ * \remarks Functions other than KeyDerivationFunction::Sha256Iterations require at least version 13. See mininumVersion().
+ *          Use KeyDerivationParameters::create() to create parameters with a random salt.
+ */
+inline void PasswordFile::setKeyDerivation(const KeyDerivationParameters &parameters)
+{
+    m_keyDerivation = parameters;
+}
+
+/*!
+ * \brief Returns the duration deriving the key should take when saving with PasswordFileSaveFlags::CalibrateKeyDerivation.
+ * \remarks Defaults to 250 milliseconds.
+ */
+inline std::chrono::milliseconds PasswordFile::keyDerivationDuration() const
+{
+    return m_keyDerivationDuration;
+}
+
+/*!
+ * \brief Sets the duration deriving the key should take when saving with PasswordFileSaveFlags::CalibrateKeyDerivation.
+ * \remarks When saving with that flag, the cost parameters of the function specified via setKeyDerivation() are determined
+ *          by a short benchmark (see Io::calibrateKeyDerivation()) and replace the parameters returned by keyDerivation().
+ *          This does not apply to saveAsync() which calibrates the parameters of the snapshot only.
+ */
+inline void PasswordFile::setKeyDerivationDuration(std::chrono::milliseconds duration)
+{
+    m_keyDerivationDuration = duration;
+}
+
+/*!
+ * \brief Returns the cache for keys derived from the current password.
+ */
+inline const DerivedKeyCache &PasswordFile::keyCache() const
+{
+    return m_keyCache;
+}
+
 } // namespace Io
 
 CPP_UTILITIES_MARK_FLAG_ENUM_CLASS(Io, Io::PasswordFileOpenFlags);
@@ -0,0 +1,150 @@
+#include "./passwordfilebatch.h"
+#include "./memorymappedfile.h"
+
+#include "../util/concurrency.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class PasswordFileBatch
+ * \brief The PasswordFileBatch class loads many password files concurrently.
+ *
+ * Loading is split into two stages which run concurrently:
+ * 1. An I/O thread maps the files into memory one after another and touches their pages so the data is read from
+ *    disk before it is needed.
+ * 2. A pool of worker threads derives the keys, decrypts, decompresses and parses the prefetched files.
+ *
+ * The number of prefetched files waiting for a worker is bounded (two per worker) so only a fixed number of files is
+ * kept in memory apart from the loaded entries. Each file is loaded by one worker thread (see PasswordFile::load()
+ * with a thread count of one) because loading different files concurrently scales better than loading one file with
+ * multiple threads.
+ */
+
+/// \brief The size of the pages touched when prefetching a file.
+constexpr auto prefetchPageSize = std::size_t(4096);
+
+/*!
+ * \brief Reads the pages of the specified \a file so they are present in memory when the file is parsed.
+ */
+static void prefetch(const MemoryMappedFile &file)
+{
+    auto checksum = char();
+    for (auto offset = std::size_t(); offset < file.size(); offset += prefetchPageSize) {
+        checksum ^= file.data()[offset];
+    }
+    static_cast<void>(*static_cast<volatile char *>(&checksum));
+}
+
+/*!
+ * \brief Constructs a new batch loading files with the specified number of worker threads and \a openOptions.
+ */
+PasswordFileBatch::PasswordFileBatch(std::size_t threadCount, PasswordFileOpenFlags openOptions)
+    : m_threadCount(threadCount)
+    , m_openOptions(openOptions)
+{
+}
+
+/*!
+ * \brief Loads the files specified via \a jobs.
+ * \returns Returns a result for each job (in the same order). A result either holds the loaded file or the exception
+ *          thrown when opening, mapping or loading the file. So a file which can not be loaded does not prevent others
+ *          from being loaded.
+ * \remarks The loaded files are closed. They keep the path and the password so they can be saved again.
+ * \throws Throws std::system_error when a thread can not be started.
+ */
+std::vector<PasswordFileBatchResult> PasswordFileBatch::loadMany(const std::vector<PasswordFileBatchJob> &jobs) const
+{
+    auto results = std::vector<PasswordFileBatchResult>(jobs.size());
+    if (jobs.empty()) {
+        return results;
+    }
+    const auto threadCount = std::min<std::size_t>(m_threadCount ? m_threadCount : std::max(std::thread::hardware_concurrency(), 1u), jobs.size());
+    const auto maxPrefetchedFiles = threadCount * 2;
+
+    struct PrefetchedFile {
+        std::size_t index;
+        std::unique_ptr<MemoryMappedFile> mapping;
+    };
+    auto mutex = std::mutex();
+    auto prefetchedCondition = std::condition_variable();
+    auto consumedCondition = std::condition_variable();
+    auto prefetchedFiles = std::deque<PrefetchedFile>();
+    auto prefetchingDone = false, aborted = false;
+
+    // run the I/O stage: map and prefetch the files one after another (waiting when the workers fall behind)
+    auto ioThread = std::thread([&] {
+        for (auto index = std::size_t(); index != jobs.size(); ++index) {
+            auto mapping = std::unique_ptr<MemoryMappedFile>();
+            try {
+                mapping = std::make_unique<MemoryMappedFile>(jobs[index].path);
+                prefetch(*mapping);
+            } catch (...) {
+                results[index].error = std::current_exception();
+                continue;
+            }
+            auto lock = std::unique_lock(mutex);
+            consumedCondition.wait(lock, [&] { return prefetchedFiles.size() < maxPrefetchedFiles || aborted; });
+            if (aborted) {
+                return;
+            }
+            prefetchedFiles.emplace_back(PrefetchedFile{ index, std::move(mapping) });
+            lock.unlock();
+            prefetchedCondition.notify_one();
+        }
+        {
+            const auto lock = std::lock_guard(mutex);
+            prefetchingDone = true;
+        }
+        prefetchedCondition.notify_all();
+    });
+
+    // run the CPU stage: load the prefetched files on the worker threads
+    try {
+        Util::runConcurrently(threadCount, threadCount, [&](std::size_t) {
+            for (;;) {
+                auto lock = std::unique_lock(mutex);
+                prefetchedCondition.wait(lock, [&] { return !prefetchedFiles.empty() || prefetchingDone; });
+                if (prefetchedFiles.empty()) {
+                    return;
+                }
+                auto prefetchedFile = std::move(prefetchedFiles.front());
+                prefetchedFiles.pop_front();
+                lock.unlock();
+                consumedCondition.notify_one();
+
+                const auto &job = jobs[prefetchedFile.index];
+                auto &result = results[prefetchedFile.index];
+                try {
+                    auto file = std::make_unique<PasswordFile>(job.path, job.password);
+                    file->open(m_openOptions | PasswordFileOpenFlags::ReadOnly);
+                    file->m_prefetchedFile = std::move(prefetchedFile.mapping);
+                    file->load(1);
+                    file->close();
+                    result.file = std::move(file);
+                } catch (...) {
+                    result.error = std::current_exception();
+                }
+            }
+        });
+    } catch (...) {
+        {
+            const auto lock = std::lock_guard(mutex);
+            aborted = true;
+        }
+        consumedCondition.notify_all();
+        ioThread.join();
+        throw;
+    }
+    ioThread.join();
+    return results;
+}
+
+} // namespace Io
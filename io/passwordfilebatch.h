@@ -0,0 +1,83 @@
+#ifndef PASSWORD_FILE_IO_PASSWORDFILEBATCH_H
+#define PASSWORD_FILE_IO_PASSWORDFILEBATCH_H
+
+#include "./passwordfile.h"
+
+#include "../global.h"
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Io {
+
+/*!
+ * \brief The PasswordFileBatchJob struct specifies a file to be loaded via PasswordFileBatch::loadMany().
+ */
+struct PASSWORD_FILE_EXPORT PasswordFileBatchJob {
+    std::string path; /**< the path of the file */
+    std::string password; /**< the password of the file (may be empty if the file is not encrypted) */
+};
+
+/*!
+ * \brief The PasswordFileBatchResult struct holds the result of loading a file via PasswordFileBatch::loadMany().
+ */
+struct PASSWORD_FILE_EXPORT PasswordFileBatchResult {
+    std::unique_ptr<PasswordFile> file; /**< the loaded file (closed) or nullptr if loading failed */
+    std::exception_ptr error; /**< the exception PasswordFile::load() has thrown or nullptr if loading succeeded */
+};
+
+class PASSWORD_FILE_EXPORT PasswordFileBatch {
+public:
+    explicit PasswordFileBatch(std::size_t threadCount = 0, PasswordFileOpenFlags openOptions = PasswordFileOpenFlags::ReadOnly);
+
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    PasswordFileOpenFlags openOptions() const;
+    void setOpenOptions(PasswordFileOpenFlags openOptions);
+    std::vector<PasswordFileBatchResult> loadMany(const std::vector<PasswordFileBatchJob> &jobs) const;
+
+private:
+    std::size_t m_threadCount;
+    PasswordFileOpenFlags m_openOptions;
+};
+
+/*!
+ * \brief Returns the number of worker threads loading the files (0 means as many as there are CPU cores).
+ */
+inline std::size_t PasswordFileBatch::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of worker threads loading the files (0 means as many as there are CPU cores).
+ */
+inline void PasswordFileBatch::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+/*!
+ * \brief Returns the flags the files are opened with.
+ */
+inline PasswordFileOpenFlags PasswordFileBatch::openOptions() const
+{
+    return m_openOptions;
+}
+
+/*!
+ * \brief Sets the flags the files are opened with.
+ * \remarks PasswordFileOpenFlags::ReadOnly is always added. The files are always read from memory-mapped data (see
+ *          loadMany()) so PasswordFileOpenFlags::MemoryMapped has no effect.
+ */
+inline void PasswordFileBatch::setOpenOptions(PasswordFileOpenFlags openOptions)
+{
+    m_openOptions = openOptions;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_PASSWORDFILEBATCH_H
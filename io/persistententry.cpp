@@ -0,0 +1,286 @@
+#include "./persistententry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Io {
+
+/*!
+ * \class PersistentEntry
+ * \brief The PersistentEntry class is an immutable representation of the Entry hierarchy whose subtrees can be shared.
+ *
+ * The Entry hierarchy is mutable and each entry knows its parent and index so copying it (e.g. via NodeEntry::clone()
+ * or the copy constructor of PasswordFile) requires copying all entries. A PersistentEntry instead never changes after
+ * it has been constructed and does not know its parent. So taking a snapshot of a tree only means copying the
+ * pointer to its root.
+ *
+ * Modifications are done by the static with…() functions. They take a root and the path to the entry to be modified
+ * (as indices of the children starting from the root) and return a new root. Only the entries on the path are copied;
+ * all other subtrees are shared between the old and the new root. The old root stays valid and unchanged.
+ *
+ * Unlike the Entry hierarchy, the labels of children are not made unique. This happens when converting the tree
+ * via toEntry().
+ */
+
+/*!
+ * \brief Constructs an entry of the specified \a type with the specified \a label.
+ */
+PersistentEntry::PersistentEntry(EntryType type, const std::string &label)
+    : m_type(type)
+    , m_expandedByDefault(true)
+    , m_label(label)
+{
+}
+
+/*!
+ * \brief Returns a new node with the specified \a label and \a children.
+ */
+PersistentEntry::Pointer PersistentEntry::makeNode(const std::string &label, std::vector<Pointer> children, bool expandedByDefault)
+{
+    auto node = std::shared_ptr<PersistentEntry>(new PersistentEntry(EntryType::Node, label));
+    node->m_expandedByDefault = expandedByDefault;
+    node->m_children = std::move(children);
+    return node;
+}
+
+/*!
+ * \brief Returns a new account with the specified \a label and \a fields.
+ * \remarks The fields are untied from their account (if any).
+ */
+PersistentEntry::Pointer PersistentEntry::makeAccount(const std::string &label, std::vector<Field> fields)
+{
+    auto account = std::shared_ptr<PersistentEntry>(new PersistentEntry(EntryType::Account, label));
+    account->m_fields = std::move(fields);
+    for (auto &field : account->m_fields) {
+        field.m_tiedAccount = nullptr;
+    }
+    return account;
+}
+
+/*!
+ * \brief Returns a persistent representation of the specified \a entry and its descendants.
+ * \remarks Parses deferred children. So this might throw a ParsingException when the entry has been loaded lazily.
+ */
+PersistentEntry::Pointer PersistentEntry::fromEntry(const Entry &entry)
+{
+    auto persistentEntry = std::shared_ptr<PersistentEntry>(new PersistentEntry(entry.type(), entry.label()));
+    persistentEntry->m_extendedData = entry.m_extendedData;
+    switch (entry.type()) {
+    case EntryType::Node: {
+        const auto &node = static_cast<const NodeEntry &>(entry);
+        persistentEntry->m_expandedByDefault = node.isExpandedByDefault();
+        persistentEntry->m_children.reserve(node.children().size());
+        for (const Entry *const child : node.children()) {
+            persistentEntry->m_children.emplace_back(fromEntry(*child));
+        }
+        break;
+    }
+    case EntryType::Account:
+        persistentEntry->m_fields = static_cast<const AccountEntry &>(entry).fields();
+        for (auto &field : persistentEntry->m_fields) {
+            field.m_tiedAccount = nullptr;
+        }
+        break;
+    }
+    return persistentEntry;
+}
+
+/*!
+ * \brief Returns a new (mutable) Entry representing this entry and its descendants.
+ * \remarks The labels of children are made unique within their parent. The caller takes ownership.
+ */
+Entry *PersistentEntry::toEntry() const
+{
+    return toEntry(nullptr);
+}
+
+/*!
+ * \brief Returns a new (mutable) Entry representing this entry and its descendants which is added to \a parent.
+ */
+Entry *PersistentEntry::toEntry(NodeEntry *parent) const
+{
+    auto entry = std::unique_ptr<Entry>();
+    switch (m_type) {
+    case EntryType::Node: {
+        auto *const node = new NodeEntry(m_label);
+        entry.reset(node);
+        node->setExpandedByDefault(m_expandedByDefault);
+        for (const auto &child : m_children) {
+            child->toEntry(node);
+        }
+        break;
+    }
+    case EntryType::Account: {
+        auto *const account = new AccountEntry(m_label);
+        entry.reset(account);
+        auto &fields = account->fields();
+        fields = m_fields;
+        for (auto &field : fields) {
+            field.m_tiedAccount = account;
+        }
+        break;
+    }
+    }
+    entry->m_extendedData = m_extendedData;
+    if (parent) {
+        entry->setParent(parent);
+    }
+    return entry.release();
+}
+
+/*!
+ * \brief Returns the number of entries (including this entry and all descendants).
+ */
+std::size_t PersistentEntry::entryCount() const
+{
+    auto count = std::size_t(1);
+    for (const auto &child : m_children) {
+        count += child->entryCount();
+    }
+    return count;
+}
+
+/*!
+ * \brief Returns the entry the specified \a path (relative to this entry) refers to or nullptr if there is no such entry.
+ */
+const PersistentEntry *PersistentEntry::entryByPath(const Path &path) const
+{
+    const auto *entry = this;
+    for (const auto index : path) {
+        if (index >= entry->m_children.size()) {
+            return nullptr;
+        }
+        entry = entry->m_children[index].get();
+    }
+    return entry;
+}
+
+/*!
+ * \brief Returns a new root where the entry under the specified \a path has the specified \a label.
+ * \throws Throws std::out_of_range if \a path does not refer to an entry.
+ */
+PersistentEntry::Pointer PersistentEntry::withLabel(const Pointer &root, const Path &path, const std::string &label)
+{
+    return modify(root, path, [&label](PersistentEntry &entry) { entry.m_label = label; });
+}
+
+/*!
+ * \brief Returns a new root where the node under the specified \a path is expanded by default or not.
+ * \throws Throws std::out_of_range if \a path does not refer to an entry.
+ * \throws Throws std::invalid_argument if \a path refers to an account.
+ */
+PersistentEntry::Pointer PersistentEntry::withExpandedByDefault(const Pointer &root, const Path &path, bool expandedByDefault)
+{
+    return modify(root, path, [expandedByDefault](PersistentEntry &entry) {
+        if (entry.m_type != EntryType::Node) {
+            throw std::invalid_argument("The entry is not a node.");
+        }
+        entry.m_expandedByDefault = expandedByDefault;
+    });
+}
+
+/*!
+ * \brief Returns a new root where the account under the specified \a path has the specified \a fields.
+ * \throws Throws std::out_of_range if \a path does not refer to an entry.
+ * \throws Throws std::invalid_argument if \a path refers to a node.
+ */
+PersistentEntry::Pointer PersistentEntry::withFields(const Pointer &root, const Path &path, std::vector<Field> fields)
+{
+    for (auto &field : fields) {
+        field.m_tiedAccount = nullptr;
+    }
+    return modify(root, path, [&fields](PersistentEntry &entry) {
+        if (entry.m_type != EntryType::Account) {
+            throw std::invalid_argument("The entry is not an account.");
+        }
+        entry.m_fields = std::move(fields);
+    });
+}
+
+/*!
+ * \brief Returns a new root where the entry under the specified \a path is replaced by the specified \a entry.
+ * \remarks Returns \a entry if \a path is empty.
+ * \throws Throws std::out_of_range if \a path does not refer to an entry.
+ */
+PersistentEntry::Pointer PersistentEntry::withEntry(const Pointer &root, const Path &path, Pointer entry)
+{
+    if (path.empty()) {
+        return entry;
+    }
+    const auto index = path.back();
+    return modify(root, path.cbegin(), path.cend() - 1, [index, &entry](PersistentEntry &parent) {
+        if (index >= parent.m_children.size()) {
+            throw std::out_of_range("The path does not refer to an entry.");
+        }
+        parent.m_children[index] = std::move(entry);
+    });
+}
+
+/*!
+ * \brief Returns a new root where the specified \a child is inserted at the specified \a index into the node under
+ *        the specified \a path.
+ * \remarks The child is appended if \a index exceeds the number of children.
+ * \throws Throws std::out_of_range if \a path does not refer to an entry.
+ * \throws Throws std::invalid_argument if \a path refers to an account.
+ */
+PersistentEntry::Pointer PersistentEntry::withInsertedChild(const Pointer &root, const Path &path, std::size_t index, Pointer child)
+{
+    return modify(root, path, [index, &child](PersistentEntry &node) {
+        if (node.m_type != EntryType::Node) {
+            throw std::invalid_argument("The entry is not a node.");
+        }
+        node.m_children.insert(node.m_children.begin() + static_cast<std::ptrdiff_t>(std::min(index, node.m_children.size())), std::move(child));
+    });
+}
+
+/*!
+ * \brief Returns a new root where the child at the specified \a index of the node under the specified \a path is removed.
+ * \throws Throws std::out_of_range if \a path or \a index does not refer to an entry.
+ */
+PersistentEntry::Pointer PersistentEntry::withoutChild(const Pointer &root, const Path &path, std::size_t index)
+{
+    return modify(root, path, [index](PersistentEntry &node) {
+        if (index >= node.m_children.size()) {
+            throw std::out_of_range("The path does not refer to an entry.");
+        }
+        node.m_children.erase(node.m_children.begin() + static_cast<std::ptrdiff_t>(index));
+    });
+}
+
+/*!
+ * \brief Returns a new root where the entry under the specified \a path has been modified via \a modifier.
+ * \remarks The \a modifier is invoked on a copy of the entry. The entries on the path are copied as well; all other
+ *          entries are shared.
+ */
+PersistentEntry::Pointer PersistentEntry::modify(
+    const Pointer &root, const Path &path, const std::function<void(PersistentEntry &)> &modifier)
+{
+    return modify(root, path.cbegin(), path.cend(), modifier);
+}
+
+/*!
+ * \brief Returns a copy of \a entry where the entry under the path from \a begin to \a end has been modified via
+ *        \a modifier.
+ */
+PersistentEntry::Pointer PersistentEntry::modify(
+    const Pointer &entry, Path::const_iterator begin, Path::const_iterator end, const std::function<void(PersistentEntry &)> &modifier)
+{
+    if (!entry) {
+        throw std::out_of_range("The path does not refer to an entry.");
+    }
+    if (begin != end && *begin >= entry->m_children.size()) {
+        throw std::out_of_range("The path does not refer to an entry.");
+    }
+    auto copy = std::make_shared<PersistentEntry>(*entry);
+    if (begin == end) {
+        modifier(*copy);
+    } else {
+        auto &child = copy->m_children[*begin];
+        child = modify(child, begin + 1, end, modifier);
+    }
+    return copy;
+}
+
+} // namespace Io
@@ -0,0 +1,96 @@
+#ifndef PASSWORD_FILE_IO_PERSISTENTENTRY_H
+#define PASSWORD_FILE_IO_PERSISTENTENTRY_H
+
+#include "./entry.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT PersistentEntry {
+public:
+    using Pointer = std::shared_ptr<const PersistentEntry>;
+    using Path = std::vector<std::size_t>;
+
+    static Pointer makeNode(const std::string &label, std::vector<Pointer> children = std::vector<Pointer>(), bool expandedByDefault = true);
+    static Pointer makeAccount(const std::string &label, std::vector<Field> fields = std::vector<Field>());
+    static Pointer fromEntry(const Entry &entry);
+    Entry *toEntry() const;
+
+    EntryType type() const;
+    const std::string &label() const;
+    bool isExpandedByDefault() const;
+    const std::vector<Pointer> &children() const;
+    const std::vector<Field> &fields() const;
+    std::size_t entryCount() const;
+    const PersistentEntry *entryByPath(const Path &path) const;
+
+    static Pointer withLabel(const Pointer &root, const Path &path, const std::string &label);
+    static Pointer withExpandedByDefault(const Pointer &root, const Path &path, bool expandedByDefault);
+    static Pointer withFields(const Pointer &root, const Path &path, std::vector<Field> fields);
+    static Pointer withEntry(const Pointer &root, const Path &path, Pointer entry);
+    static Pointer withInsertedChild(const Pointer &root, const Path &path, std::size_t index, Pointer child);
+    static Pointer withoutChild(const Pointer &root, const Path &path, std::size_t index);
+
+private:
+    explicit PersistentEntry(EntryType type, const std::string &label);
+    static Pointer modify(const Pointer &root, const Path &path, const std::function<void(PersistentEntry &)> &modifier);
+    static Pointer modify(const Pointer &entry, Path::const_iterator begin, Path::const_iterator end,
+        const std::function<void(PersistentEntry &)> &modifier);
+    Entry *toEntry(NodeEntry *parent) const;
+
+    EntryType m_type;
+    bool m_expandedByDefault;
+    std::string m_label;
+    std::string m_extendedData;
+    std::vector<Pointer> m_children;
+    std::vector<Field> m_fields;
+};
+
+/*!
+ * \brief Returns the type of the entry.
+ */
+inline EntryType PersistentEntry::type() const
+{
+    return m_type;
+}
+
+/*!
+ * \brief Returns the label.
+ */
+inline const std::string &PersistentEntry::label() const
+{
+    return m_label;
+}
+
+/*!
+ * \brief Returns whether the node should be expanded by default (always true for accounts).
+ */
+inline bool PersistentEntry::isExpandedByDefault() const
+{
+    return m_expandedByDefault;
+}
+
+/*!
+ * \brief Returns the children (always empty for accounts).
+ */
+inline const std::vector<PersistentEntry::Pointer> &PersistentEntry::children() const
+{
+    return m_children;
+}
+
+/*!
+ * \brief Returns the fields (always empty for nodes).
+ * \remarks The fields are not tied to any account.
+ */
+inline const std::vector<Field> &PersistentEntry::fields() const
+{
+    return m_fields;
+}
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_PERSISTENTENTRY_H
@@ -0,0 +1,412 @@
+#include "./segmentedencryption.h"
+#include "./cryptoexception.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+#include <limits>
+
+using namespace std;
+using namespace CppUtilities;
+using namespace Util;
+
+namespace Io {
+
+/// \brief The size of a segment including its authentication tag.
+static constexpr auto storedSegmentSize = SegmentedEncryptingStreamBuffer::segmentSize + authenticationTagSize;
+
+/*!
+ * \brief Checks whether \a cipher can be used for segmented encryption.
+ */
+static void checkCipher(EncryptionCipher cipher)
+{
+    if (!isAuthenticatedCipher(cipher)) {
+        throw CryptoException(argsToString("The cipher \"", encryptionCipherName(cipher), "\" can not be used for segmented encryption."));
+    }
+}
+
+/*!
+ * \brief Derives the nonce for the segment with the specified \a index from the \a iv.
+ * \remarks The segment index is XOR-ed into the bytes 7 to 10 of the IV and the flag for the final segment into the
+ *          last byte (like the STREAM construction does). So segments can neither be reordered nor can the data be
+ *          truncated at a segment boundary without being detected.
+ */
+static void deriveNonce(const std::array<unsigned char, 12> &iv, std::uint64_t index, bool isFinal, unsigned char *nonce)
+{
+    if (index > numeric_limits<std::uint32_t>::max()) {
+        throw CryptoException("The maximum number of encrypted segments has been exceeded.");
+    }
+    char counter[4];
+    BE::getBytes(static_cast<std::uint32_t>(index), counter);
+    std::memcpy(nonce, iv.data(), iv.size());
+    for (auto i = 0; i != 4; ++i) {
+        nonce[7 + i] ^= static_cast<unsigned char>(counter[i]);
+    }
+    nonce[11] ^= isFinal ? 0x01 : 0x00;
+}
+
+/*!
+ * \brief Returns the number of segments to keep in flight when using \a threadCount threads.
+ */
+static std::size_t maxPendingSegments(std::size_t threadCount)
+{
+    return threadCount > 1 ? threadCount * 2 : 1;
+}
+
+/*!
+ * \brief Returns one cipher context per worker of \a threadPool initialized with the \a key.
+ * \remarks The contexts are taken from the pool of the calling thread (see OpenSsl::CipherContext). Only the nonce
+ *          needs to be set for each segment so the key schedule is computed just once per worker.
+ */
+static std::vector<OpenSsl::CipherContext> makeCipherContexts(
+    const ThreadPool &threadPool, EncryptionCipher cipher, const unsigned char *key, bool encrypt)
+{
+    auto contexts = std::vector<OpenSsl::CipherContext>();
+    contexts.reserve(threadPool.threadCount());
+    for (auto i = std::size_t(); i != threadPool.threadCount(); ++i) {
+        auto &context = contexts.emplace_back();
+        if (EVP_CipherInit_ex(context.get(), evpCipher(cipher), nullptr, key, nullptr, encrypt ? 1 : 0) != 1) {
+            throw CryptoException(OpenSsl::errorMessages());
+        }
+    }
+    return contexts;
+}
+
+/*!
+ * \class SegmentedEncryptingStreamBuffer
+ * \brief The SegmentedEncryptingStreamBuffer class provides a write-only stream buffer which splits the data written
+ *        to it into segments and encrypts the segments independently of each other on multiple threads.
+ *
+ * Each segment holds segmentSize bytes of the data (except the final segment which holds less) and is followed by its
+ * authentication tag. The segments are encrypted with nonces derived from the IV, the index of the segment and whether
+ * it is the final segment. So each segment can be authenticated on its own and the segments can be decrypted
+ * concurrently as well (see SegmentedDecryptingStreamBuffer).
+ *
+ * Each full segment is handed to a pool of worker threads which lives as long as the buffer. Up to two segments per
+ * thread are in flight; when that limit is reached, the oldest segment is awaited and written to the sink. Call
+ * finish() after writing all data to write the final segment.
+ *
+ * \remarks Encryption errors are reported by throwing a CryptoException and errors when writing to the sink by throwing
+ *          an std::ios_base::failure. When the buffer is used via an std::ostream, enable exceptions for
+ *          std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Constructs a new buffer writing the encrypted segments to \a sink using the specified \a key and \a iv.
+ * \param threadCount Specifies the number of threads to use for encrypting (at least one).
+ * \remarks The \a key must be 32 bytes long and the \a iv 12 bytes long. The \a iv is copied and the \a key is only
+ *          used within the constructor.
+ * \throws Throws CryptoException when \a cipher is not an authenticated cipher.
+ */
+SegmentedEncryptingStreamBuffer::SegmentedEncryptingStreamBuffer(
+    std::streambuf *sink, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount)
+    : m_sink(sink)
+    , m_maxPendingSegments(maxPendingSegments(threadCount))
+    , m_currentSegment(make_unique<Segment>())
+    , m_segmentIndex(0)
+    , m_finished(false)
+    , m_threadPool(threadCount)
+{
+    checkCipher(cipher);
+    m_contexts = makeCipherContexts(m_threadPool, cipher, key, true);
+    std::memcpy(m_iv.data(), iv, m_iv.size());
+    m_currentSegment->data = make_unique<char[]>(segmentSize);
+    m_currentSegment->encryptedData = make_unique<unsigned char[]>(storedSegmentSize);
+    setp(m_currentSegment->data.get(), m_currentSegment->data.get() + segmentSize);
+}
+
+/*!
+ * \brief Destroys the buffer.
+ * \remarks Buffered data which has not been encrypted yet is discarded; call finish() before.
+ */
+SegmentedEncryptingStreamBuffer::~SegmentedEncryptingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Encrypts the buffered data as final segment (which might be empty) and writes all segments to the sink.
+ * \remarks No further data can be written afterwards.
+ * \throws Throws CryptoException when an encryption error occurs.
+ * \throws Throws std::ios_base::failure when the encrypted data can not be written to the sink.
+ */
+void SegmentedEncryptingStreamBuffer::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    // the final segment must be smaller than the others so a full segment is followed by an empty final segment
+    if (pptr() == epptr()) {
+        encryptSegment(false);
+    }
+    encryptSegment(true);
+    m_finished = true;
+    setp(nullptr, nullptr);
+}
+
+/*!
+ * \brief Hands the full segment to the worker threads to make room for \a c.
+ */
+SegmentedEncryptingStreamBuffer::int_type SegmentedEncryptingStreamBuffer::overflow(int_type c)
+{
+    if (m_finished) {
+        return traits_type::eof();
+    }
+    encryptSegment(false);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+/*!
+ * \brief Flushes the sink.
+ * \remarks Buffered data is only encrypted once the segment is full or finish() is called because segments must not
+ *          be smaller than segmentSize (except for the final segment).
+ */
+int SegmentedEncryptingStreamBuffer::sync()
+{
+    return m_sink->pubsync();
+}
+
+/*!
+ * \brief Hands the current segment to the worker threads and writes the segments which have been encrypted.
+ * \remarks The segment is always full unless \a finish is set in which case it is encrypted as final segment and all
+ *          pending segments are written.
+ */
+void SegmentedEncryptingStreamBuffer::encryptSegment(bool finish)
+{
+    auto &segment = *m_currentSegment;
+    segment.size = static_cast<std::size_t>(pptr() - pbase());
+    segment.result = m_threadPool.post([this, &segment, index = m_segmentIndex, finish](std::size_t workerIndex) {
+        auto *const context = m_contexts[workerIndex].get();
+        const auto size = static_cast<int>(segment.size);
+        auto *const output = segment.encryptedData.get();
+        auto outputSize = 0, finalOutputSize = 0;
+        unsigned char nonce[12];
+        deriveNonce(m_iv, index, finish, nonce);
+        if (EVP_EncryptInit_ex(context, nullptr, nullptr, nullptr, nonce) != 1
+            || EVP_EncryptUpdate(context, output, &outputSize, reinterpret_cast<const unsigned char *>(segment.data.get()), size) != 1
+            || EVP_EncryptFinal_ex(context, output + outputSize, &finalOutputSize) != 1
+            || EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_GET_TAG, static_cast<int>(authenticationTagSize), output + size) != 1) {
+            throw CryptoException(OpenSsl::errorMessages());
+        }
+    });
+    m_pendingSegments.emplace_back(std::move(m_currentSegment));
+    ++m_segmentIndex;
+
+    while (!m_pendingSegments.empty() && (finish || m_pendingSegments.size() >= m_maxPendingSegments)) {
+        writeSegment();
+    }
+    if (finish) {
+        return;
+    }
+    if (m_idleSegments.empty()) {
+        m_currentSegment = make_unique<Segment>();
+        m_currentSegment->data = make_unique<char[]>(segmentSize);
+        m_currentSegment->encryptedData = make_unique<unsigned char[]>(storedSegmentSize);
+    } else {
+        m_currentSegment = std::move(m_idleSegments.back());
+        m_idleSegments.pop_back();
+    }
+    setp(m_currentSegment->data.get(), m_currentSegment->data.get() + segmentSize);
+}
+
+/*!
+ * \brief Waits for the oldest pending segment to be encrypted and writes it to the sink.
+ * \throws Rethrows the exception thrown when encrypting the segment.
+ */
+void SegmentedEncryptingStreamBuffer::writeSegment()
+{
+    auto segment = std::move(m_pendingSegments.front());
+    m_pendingSegments.pop_front();
+    segment->result.get();
+    const auto size = static_cast<std::streamsize>(segment->size + authenticationTagSize);
+    if (m_sink->sputn(reinterpret_cast<const char *>(segment->encryptedData.get()), size) != size) {
+        throw std::ios_base::failure("Unable to write encrypted data.");
+    }
+    m_idleSegments.emplace_back(std::move(segment));
+}
+
+/*!
+ * \class SegmentedDecryptingStreamBuffer
+ * \brief The SegmentedDecryptingStreamBuffer class provides a read-only stream buffer which decrypts data written by
+ *        SegmentedEncryptingStreamBuffer on multiple threads.
+ *
+ * The segments are read ahead and handed to a pool of worker threads which lives as long as the buffer. Up to two
+ * segments per thread are in flight. Each segment is authenticated before its data is returned. So unlike with
+ * DecryptingStreamBuffer, the returned data can be trusted right away. Only a truncation of the data is not detected
+ * before reaching the end; call finish() after reading the data to check for it.
+ *
+ * \remarks Decryption errors are reported by throwing a CryptoException. When the buffer is used via an std::istream,
+ *          enable exceptions for std::ios_base::badbit so the exception is propagated.
+ */
+
+/*!
+ * \brief Constructs a new buffer reading the encrypted segments from \a source using the specified \a key and \a iv.
+ * \param threadCount Specifies the number of threads to use for decrypting (at least one).
+ * \remarks The \a key must be 32 bytes long and the \a iv 12 bytes long. The \a iv is copied and the \a key is only
+ *          used within the constructor.
+ * \throws Throws CryptoException when \a cipher is not an authenticated cipher.
+ */
+SegmentedDecryptingStreamBuffer::SegmentedDecryptingStreamBuffer(
+    std::streambuf *source, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount)
+    : SegmentedDecryptingStreamBuffer(nullptr, 0, key, iv, cipher, threadCount)
+{
+    m_source = source;
+}
+
+/*!
+ * \brief Constructs a new buffer decrypting the encrypted segments from the specified \a data.
+ * \param threadCount Specifies the number of threads to use for decrypting (at least one).
+ * \remarks
+ * - The \a data is passed to OpenSSL directly without copying it first so it must outlive the buffer.
+ * - The \a key must be 32 bytes long and the \a iv 12 bytes long. The \a iv is copied and the \a key is only used
+ *   within the constructor.
+ * \throws Throws CryptoException when \a cipher is not an authenticated cipher.
+ */
+SegmentedDecryptingStreamBuffer::SegmentedDecryptingStreamBuffer(
+    const char *data, std::size_t size, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount)
+    : m_source(nullptr)
+    , m_data(data)
+    , m_dataEnd(data + size)
+    , m_maxPendingSegments(maxPendingSegments(threadCount))
+    , m_segmentIndex(0)
+    , m_finalSegmentRead(false)
+    , m_finished(false)
+    , m_threadPool(threadCount)
+{
+    checkCipher(cipher);
+    m_contexts = makeCipherContexts(m_threadPool, cipher, key, false);
+    std::memcpy(m_iv.data(), iv, m_iv.size());
+}
+
+/*!
+ * \brief Destroys the buffer.
+ * \remarks Segments which are still being decrypted are awaited.
+ */
+SegmentedDecryptingStreamBuffer::~SegmentedDecryptingStreamBuffer()
+{
+}
+
+/*!
+ * \brief Reads and authenticates the remaining segments discarding their data.
+ * \throws Throws CryptoException when the final segment is missing (because the data has been truncated) or a
+ *         segment can not be authenticated.
+ */
+void SegmentedDecryptingStreamBuffer::finish()
+{
+    while (!m_finished) {
+        setg(nullptr, nullptr, nullptr);
+        underflow();
+    }
+}
+
+/*!
+ * \brief Reads the next segments, hands them to the worker threads and provides the oldest one once authenticated.
+ * \throws Throws CryptoException when a segment can not be authenticated or the data is truncated.
+ */
+SegmentedDecryptingStreamBuffer::int_type SegmentedDecryptingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (m_finished) {
+        return traits_type::eof();
+    }
+    if (m_currentSegment) {
+        m_idleSegments.emplace_back(std::move(m_currentSegment));
+    }
+
+    // read ahead until the maximum number of segments is in flight
+    while (!m_finalSegmentRead && m_pendingSegments.size() < m_maxPendingSegments) {
+        auto segment = std::unique_ptr<Segment>();
+        if (m_idleSegments.empty()) {
+            segment = make_unique<Segment>();
+            segment->data = make_unique<char[]>(segmentSize);
+        } else {
+            segment = std::move(m_idleSegments.back());
+            m_idleSegments.pop_back();
+        }
+        if (!readSegment(*segment)) {
+            m_idleSegments.emplace_back(std::move(segment));
+            break;
+        }
+        segment->result = m_threadPool.post([this, &segment = *segment, index = m_segmentIndex](std::size_t workerIndex) {
+            auto *const context = m_contexts[workerIndex].get();
+            const auto size = segment.encryptedSize - authenticationTagSize;
+            auto *const output = reinterpret_cast<unsigned char *>(segment.data.get());
+            auto outputSize = 0, finalOutputSize = 0;
+            unsigned char nonce[12];
+            deriveNonce(m_iv, index, segment.isFinal, nonce);
+            if (EVP_DecryptInit_ex(context, nullptr, nullptr, nullptr, nonce) != 1
+                || EVP_DecryptUpdate(context, output, &outputSize, segment.encryptedData, static_cast<int>(size)) != 1
+                || EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_SET_TAG, static_cast<int>(authenticationTagSize),
+                       const_cast<unsigned char *>(segment.encryptedData + size))
+                    != 1) {
+                throw CryptoException(OpenSsl::errorMessages());
+            }
+            if (EVP_DecryptFinal_ex(context, output + outputSize, &finalOutputSize) != 1) {
+                throw CryptoException("Unable to authenticate the encrypted data. The password is wrong or the data has been modified.");
+            }
+        });
+        m_pendingSegments.emplace_back(std::move(segment));
+        ++m_segmentIndex;
+    }
+    if (m_pendingSegments.empty()) {
+        throw CryptoException("The encrypted data is truncated.");
+    }
+
+    // provide the oldest segment once it has been authenticated
+    m_currentSegment = std::move(m_pendingSegments.front());
+    m_pendingSegments.pop_front();
+    m_currentSegment->result.get();
+    m_finished = m_currentSegment->isFinal;
+    const auto outputSize = m_currentSegment->encryptedSize - authenticationTagSize;
+    setg(m_currentSegment->data.get(), m_currentSegment->data.get(), m_currentSegment->data.get() + outputSize);
+    return outputSize ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+}
+
+/*!
+ * \brief Reads the next encrypted segment into \a segment.
+ * \returns Returns whether a segment could be read; returns false if the end of the data has been reached.
+ * \remarks When reading from memory, the encrypted data is not copied. Only the final segment is smaller than the
+ *          others.
+ * \throws Throws CryptoException when the final segment is too small to hold the authentication tag.
+ */
+bool SegmentedDecryptingStreamBuffer::readSegment(Segment &segment)
+{
+    if (m_source) {
+        if (!segment.buffer) {
+            segment.buffer = make_unique<char[]>(storedSegmentSize);
+        }
+        segment.encryptedSize = 0;
+        for (std::streamsize readSize; segment.encryptedSize < storedSegmentSize; segment.encryptedSize += static_cast<std::size_t>(readSize)) {
+            readSize = m_source->sgetn(
+                segment.buffer.get() + segment.encryptedSize, static_cast<std::streamsize>(storedSegmentSize - segment.encryptedSize));
+            if (readSize <= 0) {
+                break;
+            }
+        }
+        segment.encryptedData = reinterpret_cast<const unsigned char *>(segment.buffer.get());
+    } else {
+        segment.encryptedSize = std::min(static_cast<std::size_t>(m_dataEnd - m_data), storedSegmentSize);
+        segment.encryptedData = reinterpret_cast<const unsigned char *>(m_data);
+        m_data += segment.encryptedSize;
+    }
+    if (!segment.encryptedSize) {
+        return false;
+    }
+    segment.isFinal = m_finalSegmentRead = segment.encryptedSize < storedSegmentSize;
+    if (segment.encryptedSize < authenticationTagSize) {
+        throw CryptoException("The encrypted data is truncated.");
+    }
+    return true;
+}
+
+} // namespace Io
@@ -0,0 +1,104 @@
+#ifndef PASSWORD_FILE_IO_SEGMENTEDENCRYPTION_H
+#define PASSWORD_FILE_IO_SEGMENTEDENCRYPTION_H
+
+#include "./encryptioncipher.h"
+
+#include "../util/concurrency.h"
+#include "../util/openssl.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace Io {
+
+class PASSWORD_FILE_EXPORT SegmentedEncryptingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t segmentSize = 0x10000;
+
+    explicit SegmentedEncryptingStreamBuffer(
+        std::streambuf *sink, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount);
+    SegmentedEncryptingStreamBuffer(const SegmentedEncryptingStreamBuffer &) = delete;
+    ~SegmentedEncryptingStreamBuffer() override;
+    SegmentedEncryptingStreamBuffer &operator=(const SegmentedEncryptingStreamBuffer &) = delete;
+
+    void finish();
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    struct Segment {
+        std::unique_ptr<char[]> data;
+        std::unique_ptr<unsigned char[]> encryptedData;
+        std::size_t size = 0;
+        std::future<void> result;
+    };
+
+    void encryptSegment(bool finish);
+    void writeSegment();
+
+    std::streambuf *m_sink;
+    std::array<unsigned char, 12> m_iv;
+    std::size_t m_maxPendingSegments;
+    std::vector<Util::OpenSsl::CipherContext> m_contexts;
+    std::unique_ptr<Segment> m_currentSegment;
+    std::deque<std::unique_ptr<Segment>> m_pendingSegments;
+    std::vector<std::unique_ptr<Segment>> m_idleSegments;
+    std::uint64_t m_segmentIndex;
+    bool m_finished;
+    Util::ThreadPool m_threadPool;
+};
+
+class PASSWORD_FILE_EXPORT SegmentedDecryptingStreamBuffer : public std::streambuf {
+public:
+    static constexpr std::size_t segmentSize = SegmentedEncryptingStreamBuffer::segmentSize;
+
+    explicit SegmentedDecryptingStreamBuffer(
+        std::streambuf *source, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount);
+    explicit SegmentedDecryptingStreamBuffer(
+        const char *data, std::size_t size, const unsigned char *key, const unsigned char *iv, EncryptionCipher cipher, std::size_t threadCount);
+    SegmentedDecryptingStreamBuffer(const SegmentedDecryptingStreamBuffer &) = delete;
+    ~SegmentedDecryptingStreamBuffer() override;
+    SegmentedDecryptingStreamBuffer &operator=(const SegmentedDecryptingStreamBuffer &) = delete;
+
+    void finish();
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct Segment {
+        const unsigned char *encryptedData = nullptr;
+        std::size_t encryptedSize = 0;
+        std::unique_ptr<char[]> buffer;
+        std::unique_ptr<char[]> data;
+        bool isFinal = false;
+        std::future<void> result;
+    };
+
+    bool readSegment(Segment &segment);
+
+    std::streambuf *m_source;
+    const char *m_data;
+    const char *m_dataEnd;
+    std::array<unsigned char, 12> m_iv;
+    std::size_t m_maxPendingSegments;
+    std::vector<Util::OpenSsl::CipherContext> m_contexts;
+    std::unique_ptr<Segment> m_currentSegment;
+    std::deque<std::unique_ptr<Segment>> m_pendingSegments;
+    std::vector<std::unique_ptr<Segment>> m_idleSegments;
+    std::uint64_t m_segmentIndex;
+    bool m_finalSegmentRead;
+    bool m_finished;
+    Util::ThreadPool m_threadPool;
+};
+
+} // namespace Io
+
+#endif // PASSWORD_FILE_IO_SEGMENTEDENCRYPTION_H
@@ -0,0 +1,168 @@
+#include "../util/concurrency.h"
+
+#include <c++utilities/tests/testutils.h>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+using namespace Util;
+using namespace CppUtilities;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The ConcurrencyTests class tests the helpers in util/concurrency.h.
+ */
+class ConcurrencyTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(ConcurrencyTests);
+    CPPUNIT_TEST(testRunningConcurrently);
+    CPPUNIT_TEST(testThreadPool);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testRunningConcurrently();
+    void testThreadPool();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ConcurrencyTests);
+
+void ConcurrencyTests::setUp()
+{
+}
+
+void ConcurrencyTests::tearDown()
+{
+}
+
+/*!
+ * \brief Tests runConcurrently().
+ */
+void ConcurrencyTests::testRunningConcurrently()
+{
+    auto results = vector<size_t>(100);
+    runConcurrently(results.size(), 4, [&results](size_t i) { results[i] = i * i; });
+    for (auto i = 0_st; i != results.size(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(i * i, results[i]);
+    }
+    CPPUNIT_ASSERT_THROW(runConcurrently(10, 4, [](size_t i) {
+        if (i == 7) {
+            throw runtime_error("task failed");
+        }
+    }),
+        runtime_error);
+}
+
+/*!
+ * \brief Tests the ThreadPool class.
+ */
+void ConcurrencyTests::testThreadPool()
+{
+    // tasks run on the workers and are passed a valid worker index
+    {
+        auto pool = ThreadPool(3);
+        CPPUNIT_ASSERT_EQUAL(3_st, pool.threadCount());
+        auto results = vector<size_t>(50);
+        auto futures = vector<future<void>>();
+        for (auto i = 0_st; i != results.size(); ++i) {
+            futures.emplace_back(pool.post([&results, &pool, i](size_t workerIndex) {
+                CPPUNIT_ASSERT(workerIndex < pool.threadCount());
+                results[i] = i + 1;
+            }));
+        }
+        for (auto i = 0_st; i != results.size(); ++i) {
+            futures[i].get();
+            CPPUNIT_ASSERT_EQUAL(i + 1, results[i]);
+        }
+    }
+
+    // exceptions are propagated via the future
+    {
+        auto pool = ThreadPool(2);
+        auto future = pool.post([](size_t) { throw runtime_error("task failed"); });
+        CPPUNIT_ASSERT_THROW(future.get(), runtime_error);
+        CPPUNIT_ASSERT_NO_THROW(pool.post([](size_t) {}).get());
+    }
+
+    // with only one thread, tasks are run immediately on the calling thread
+    {
+        auto pool = ThreadPool(0);
+        CPPUNIT_ASSERT_EQUAL(1_st, pool.threadCount());
+        auto threadId = thread::id();
+        auto future = pool.post([&threadId](size_t workerIndex) {
+            CPPUNIT_ASSERT_EQUAL(0_st, workerIndex);
+            threadId = this_thread::get_id();
+        });
+        CPPUNIT_ASSERT(future.wait_for(chrono::seconds(0)) == future_status::ready);
+        CPPUNIT_ASSERT(threadId == this_thread::get_id());
+    }
+
+    // the queue is bounded
+    {
+        auto release = promise<void>();
+        auto released = release.get_future().share();
+        auto started = atomic<size_t>();
+        auto posted = atomic<bool>();
+        auto pool = ThreadPool(2, 1);
+        const auto blockingTask = [&started, released](size_t) {
+            ++started;
+            released.wait();
+        };
+        auto runningTasks = vector<future<void>>();
+        runningTasks.emplace_back(pool.post(blockingTask));
+        runningTasks.emplace_back(pool.post(blockingTask));
+        while (started != 2) {
+            this_thread::yield();
+        }
+        auto queuedTask = pool.post([](size_t) {});
+        auto poster = thread([&pool, &posted] {
+            pool.post([](size_t) {}).get();
+            posted = true;
+        });
+        this_thread::sleep_for(chrono::milliseconds(50));
+        CPPUNIT_ASSERT(!posted);
+        release.set_value();
+        poster.join();
+        CPPUNIT_ASSERT(posted);
+        queuedTask.get();
+    }
+
+    // tasks which have not been started are discarded on destruction
+    auto discardedTask = future<void>();
+    auto release = promise<void>();
+    auto releaser = thread();
+    {
+        auto released = release.get_future().share();
+        auto started = atomic<size_t>();
+        auto pool = ThreadPool(2);
+        for (auto i = 0; i != 2; ++i) {
+            pool.post([&started, released](size_t) {
+                ++started;
+                released.wait();
+            });
+        }
+        while (started != 2) {
+            this_thread::yield();
+        }
+        discardedTask = pool.post([](size_t) {});
+        releaser = thread([&release] {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            release.set_value();
+        });
+    }
+    releaser.join();
+    try {
+        discardedTask.get();
+        CPPUNIT_FAIL("task not discarded");
+    } catch (const future_error &error) {
+        CPPUNIT_ASSERT(error.code() == future_errc::broken_promise);
+    }
+}
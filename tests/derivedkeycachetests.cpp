@@ -0,0 +1,128 @@
+#include "../io/derivedkeycache.h"
+
+#include "./utils.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The DerivedKeyCacheTests class tests the Io::DerivedKeyCache class.
+ */
+class DerivedKeyCacheTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(DerivedKeyCacheTests);
+    CPPUNIT_TEST(testInsertionAndLookup);
+    CPPUNIT_TEST(testEviction);
+    CPPUNIT_TEST(testClearingAndMoving);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testInsertionAndLookup();
+    void testEviction();
+    void testClearingAndMoving();
+
+private:
+    unsigned char m_key1[DerivedKeyCache::keySize];
+    unsigned char m_key2[DerivedKeyCache::keySize];
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DerivedKeyCacheTests);
+
+void DerivedKeyCacheTests::setUp()
+{
+    std::memset(m_key1, 1, sizeof(m_key1));
+    std::memset(m_key2, 2, sizeof(m_key2));
+}
+
+void DerivedKeyCacheTests::tearDown()
+{
+}
+
+void DerivedKeyCacheTests::testInsertionAndLookup()
+{
+    DerivedKeyCache cache;
+    CPPUNIT_ASSERT(cache.isEmpty());
+    CPPUNIT_ASSERT(!cache.find(1));
+    CPPUNIT_ASSERT_EQUAL(0u, cache.mostRecentHashCount());
+
+    const auto *key = cache.insert(1, m_key1);
+    CPPUNIT_ASSERT(key != m_key1);
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(key, m_key1, DerivedKeyCache::keySize));
+    CPPUNIT_ASSERT_EQUAL(1_st, cache.size());
+    CPPUNIT_ASSERT_EQUAL(1u, cache.mostRecentHashCount());
+
+    cache.insert(2, m_key2);
+    CPPUNIT_ASSERT_EQUAL(2_st, cache.size());
+    CPPUNIT_ASSERT_EQUAL(2u, cache.mostRecentHashCount());
+    CPPUNIT_ASSERT(!cache.find(3));
+    key = cache.find(1);
+    CPPUNIT_ASSERT(key);
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(key, m_key1, DerivedKeyCache::keySize));
+    CPPUNIT_ASSERT_EQUAL(1u, cache.mostRecentHashCount());
+    key = cache.find(2);
+    CPPUNIT_ASSERT(key);
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(key, m_key2, DerivedKeyCache::keySize));
+
+    // inserting a key with the same parameters replaces the existing one
+    cache.insert(1, m_key2);
+    CPPUNIT_ASSERT_EQUAL(2_st, cache.size());
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(cache.find(1), m_key2, DerivedKeyCache::keySize));
+
+    // keys derived via other functions are distinguished by all parameters including the salt
+    auto parameters = KeyDerivationParameters();
+    parameters.function = KeyDerivationFunction::Pbkdf2HmacSha256;
+    parameters.iterations = 1;
+    cache.insert(parameters, m_key1);
+    CPPUNIT_ASSERT_EQUAL(0u, cache.mostRecentHashCount());
+    CPPUNIT_ASSERT(cache.mostRecentParameters());
+    CPPUNIT_ASSERT(parameters == *cache.mostRecentParameters());
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(cache.find(parameters), m_key1, DerivedKeyCache::keySize));
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(cache.find(1), m_key2, DerivedKeyCache::keySize));
+    parameters.salt[0] = 1;
+    CPPUNIT_ASSERT(!cache.find(parameters));
+}
+
+void DerivedKeyCacheTests::testEviction()
+{
+    DerivedKeyCache cache;
+    for (std::uint32_t hashCount = 1; hashCount <= DerivedKeyCache::maxEntries; ++hashCount) {
+        cache.insert(hashCount, m_key1);
+    }
+    CPPUNIT_ASSERT_EQUAL(DerivedKeyCache::maxEntries, cache.size());
+
+    // mark the first key as recently used so the second one is evicted
+    CPPUNIT_ASSERT(cache.find(1));
+    cache.insert(100, m_key2);
+    CPPUNIT_ASSERT_EQUAL(DerivedKeyCache::maxEntries, cache.size());
+    CPPUNIT_ASSERT(cache.find(1));
+    CPPUNIT_ASSERT(!cache.find(2));
+    CPPUNIT_ASSERT(cache.find(3));
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(cache.find(100), m_key2, DerivedKeyCache::keySize));
+}
+
+void DerivedKeyCacheTests::testClearingAndMoving()
+{
+    DerivedKeyCache cache;
+    cache.insert(1, m_key1);
+    DerivedKeyCache movedCache(std::move(cache));
+    CPPUNIT_ASSERT(cache.isEmpty());
+    CPPUNIT_ASSERT(!cache.find(1));
+    CPPUNIT_ASSERT_EQUAL(1_st, movedCache.size());
+
+    const auto *const key = movedCache.find(1);
+    CPPUNIT_ASSERT(key);
+    movedCache.clear();
+    CPPUNIT_ASSERT(movedCache.isEmpty());
+    CPPUNIT_ASSERT(!movedCache.find(1));
+    CPPUNIT_ASSERT_EQUAL(0, std::memcmp(key, std::string(DerivedKeyCache::keySize, '\0').data(), DerivedKeyCache::keySize));
+}
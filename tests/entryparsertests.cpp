@@ -0,0 +1,400 @@
+#include "../io/entry.h"
+#include "../io/entryparser.h"
+#include "../io/parsingexception.h"
+
+#include "./utils.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The EntryParserTests class tests the Io::EntryParser class.
+ */
+class EntryParserTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(EntryParserTests);
+    CPPUNIT_TEST(testParsingBuffer);
+    CPPUNIT_TEST(testParsingStreamBuffer);
+    CPPUNIT_TEST(testDeepNesting);
+    CPPUNIT_TEST(testTruncatedData);
+    CPPUNIT_TEST(testDeferredParsing);
+    CPPUNIT_TEST(testConcurrentParsing);
+    CPPUNIT_TEST(testConcurrentReading);
+    CPPUNIT_TEST(testFieldShapes);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testParsingBuffer();
+    void testParsingStreamBuffer();
+    void testDeepNesting();
+    void testTruncatedData();
+    void testDeferredParsing();
+    void testConcurrentParsing();
+    void testConcurrentReading();
+    void testFieldShapes();
+
+private:
+    string m_serializedTree;
+    string m_serializedTreeWithSubtreeSizes;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(EntryParserTests);
+
+void EntryParserTests::setUp()
+{
+    NodeEntry root("root");
+    auto *const account = new AccountEntry("account", &root);
+    account->fields().emplace_back(account, "user", "foo");
+    account->fields().emplace_back(account, "password", "bar");
+    account->fields().back().setType(FieldType::Password);
+    account->fields().emplace_back(account, "notes", string(300, 'n'));
+    auto *const node = new NodeEntry("node", &root);
+    node->setExpandedByDefault(false);
+    new AccountEntry("nested account", node);
+    new NodeEntry("empty node", &root);
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    root.make(stream);
+    m_serializedTree = stream.str();
+    stream.str(string());
+    root.make(stream, EntrySerializationFlags::SubtreeSizes);
+    m_serializedTreeWithSubtreeSizes = stream.str();
+}
+
+void EntryParserTests::tearDown()
+{
+}
+
+static void checkTree(const Entry *entry)
+{
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, entry->type());
+    const auto *const root = static_cast<const NodeEntry *>(entry);
+    CPPUNIT_ASSERT_EQUAL("root"s, root->label());
+    CPPUNIT_ASSERT_EQUAL(3_st, root->children().size());
+
+    const auto *const account = static_cast<const AccountEntry *>(root->children()[0]);
+    CPPUNIT_ASSERT_EQUAL(EntryType::Account, account->type());
+    CPPUNIT_ASSERT_EQUAL("account"s, account->label());
+    CPPUNIT_ASSERT_EQUAL(0, account->index());
+    CPPUNIT_ASSERT(account->parent() == root);
+    CPPUNIT_ASSERT_EQUAL(3_st, account->fields().size());
+    CPPUNIT_ASSERT_EQUAL("password"s, account->fields()[1].name());
+    CPPUNIT_ASSERT_EQUAL("bar"s, account->fields()[1].value());
+    CPPUNIT_ASSERT_EQUAL(FieldType::Password, account->fields()[1].type());
+    CPPUNIT_ASSERT_EQUAL(string(300, 'n'), account->fields()[2].value());
+    CPPUNIT_ASSERT(account->fields()[2].tiedAccount() == account);
+
+    const auto *const node = static_cast<const NodeEntry *>(root->children()[1]);
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, node->type());
+    CPPUNIT_ASSERT_EQUAL(1, node->index());
+    CPPUNIT_ASSERT(!node->isExpandedByDefault());
+    CPPUNIT_ASSERT_EQUAL(1_st, node->children().size());
+    CPPUNIT_ASSERT_EQUAL(list<string>{ "root" CPP_UTILITIES_PP_COMMA "node" CPP_UTILITIES_PP_COMMA "nested account" },
+        node->children()[0]->path());
+    CPPUNIT_ASSERT_EQUAL("empty node"s, root->children()[2]->label());
+}
+
+/*!
+ * \brief Tests parsing from a contiguous buffer.
+ */
+void EntryParserTests::testParsingBuffer()
+{
+    EntryParser parser(m_serializedTree.data(), m_serializedTree.size());
+    const auto root = unique_ptr<NodeEntry>(parser.parseNodeEntry());
+    checkTree(root.get());
+}
+
+/*!
+ * \brief Tests parsing from a stream buffer (so the window needs to be refilled).
+ */
+void EntryParserTests::testParsingStreamBuffer()
+{
+    stringbuf buffer(m_serializedTree, ios_base::in | ios_base::binary);
+    EntryParser parser(&buffer);
+    const auto root = unique_ptr<Entry>(parser.parseEntry());
+    checkTree(root.get());
+}
+
+/*!
+ * \brief Tests parsing deeply nested entries (which would be problematic with a recursive parser).
+ */
+void EntryParserTests::testDeepNesting()
+{
+    // serialize nodes nested 100000 levels deep manually as NodeEntry::make() is recursive
+    string data;
+    for (auto i = 0; i != 100000; ++i) {
+        data += string("\x00\x81n\x00\x00\x00\x01", 7);
+    }
+    data += string("\x80\x81""a\x00\x00\x00\x00", 7);
+    EntryParser parser(data.data(), data.size());
+    auto *entry = parser.parseEntry();
+    auto depth = 0;
+    for (const Entry *i = entry; i->type() == EntryType::Node; i = static_cast<const NodeEntry *>(i)->children().front(), ++depth)
+        ;
+    CPPUNIT_ASSERT_EQUAL(100000, depth);
+
+    // delete the entries bottom-up as the destructor of NodeEntry is recursive
+    while (entry->type() == EntryType::Node) {
+        auto *const node = static_cast<NodeEntry *>(entry);
+        entry = node->children().front();
+        entry->setParent(nullptr);
+        delete node;
+    }
+    delete entry;
+}
+
+/*!
+ * \brief Tests whether truncated data is detected.
+ */
+void EntryParserTests::testTruncatedData()
+{
+    for (auto size = 0_st; size != m_serializedTree.size(); ++size) {
+        EntryParser parser(m_serializedTree.data(), size);
+        CPPUNIT_ASSERT_THROW(parser.parseEntry(), ParsingException);
+
+        stringbuf buffer(m_serializedTree.substr(0, size), ios_base::in | ios_base::binary);
+        EntryParser streamParser(&buffer);
+        CPPUNIT_ASSERT_THROW(streamParser.parseEntry(), ParsingException);
+    }
+}
+
+/*!
+ * \brief Tests parsing children lazily when the size of subtrees is stored (NodeEntry version 0x2).
+ */
+void EntryParserTests::testDeferredParsing()
+{
+    const auto &data = m_serializedTreeWithSubtreeSizes;
+    CPPUNIT_ASSERT_GREATER(m_serializedTree.size(), data.size());
+
+    // parse eagerly
+    EntryParser eagerParser(data.data(), data.size());
+    const auto eagerRoot = unique_ptr<NodeEntry>(eagerParser.parseNodeEntry());
+    CPPUNIT_ASSERT(!eagerRoot->hasDeferredChildren());
+    checkTree(eagerRoot.get());
+    stringstream stream(data, ios_base::in | ios_base::out | ios_base::binary);
+    const auto streamRoot = unique_ptr<Entry>(Entry::parse(stream));
+    checkTree(streamRoot.get());
+
+    // parse lazily
+    const auto sharedData = make_shared<string>(data);
+    EntryParser lazyParser(shared_ptr<const char>(sharedData, sharedData->data()), sharedData->size());
+    const auto lazyRoot = unique_ptr<NodeEntry>(lazyParser.parseNodeEntry());
+    CPPUNIT_ASSERT(lazyParser.isAtEnd());
+    CPPUNIT_ASSERT_MESSAGE("children of root deferred", lazyRoot->hasDeferredChildren());
+    const auto lazyRootCopy = unique_ptr<NodeEntry>(lazyRoot->clone());
+    CPPUNIT_ASSERT_MESSAGE("copy shares deferred children", lazyRootCopy->hasDeferredChildren());
+    const auto *const node = static_cast<const NodeEntry *>(lazyRoot->children()[1]);
+    CPPUNIT_ASSERT_MESSAGE("children of root parsed on access", !lazyRoot->hasDeferredChildren());
+    CPPUNIT_ASSERT_MESSAGE("data of parsed children kept", lazyRoot->hasCachedChildren());
+    CPPUNIT_ASSERT_MESSAGE("children of nested node still deferred", node->hasDeferredChildren());
+    CPPUNIT_ASSERT_MESSAGE("nothing to defer for empty node", !static_cast<const NodeEntry *>(lazyRoot->children()[2])->hasDeferredChildren());
+    checkTree(lazyRoot.get());
+    CPPUNIT_ASSERT(!node->hasDeferredChildren());
+
+    // serialize deferred children as-is or parse them when serializing without subtree sizes
+    stream.str(string());
+    lazyRootCopy->make(stream, EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes);
+    CPPUNIT_ASSERT_MESSAGE("deferred children copied as-is", lazyRootCopy->hasDeferredChildren());
+    CPPUNIT_ASSERT_EQUAL(data, stream.str());
+    stream.str(string());
+    lazyRootCopy->make(stream);
+    CPPUNIT_ASSERT_MESSAGE("deferred children parsed", !lazyRootCopy->hasDeferredChildren());
+    CPPUNIT_ASSERT_EQUAL(m_serializedTree, stream.str());
+
+    // modify lazily loaded tree
+    const auto lazyRoot2 = unique_ptr<NodeEntry>(EntryParser(shared_ptr<const char>(sharedData, sharedData->data()), data.size()).parseNodeEntry());
+    auto *const newAccount = new AccountEntry("account", lazyRoot2.get());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("deferred children parsed before appending new one", 3, newAccount->index());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("label made unique", "account 2"s, newAccount->label());
+    CPPUNIT_ASSERT_MESSAGE("data of parsed children discarded after appending new one", !lazyRoot2->hasCachedChildren());
+
+    // denote a size which is too small for the children of the root
+    auto corruptedData = make_shared<string>(data);
+    // note: The size of the children of the root starts at offset 13 (after version, label, extended header and child count).
+    CppUtilities::BE::getBytes(CppUtilities::BE::toUInt64(corruptedData->data() + 13) - 1, corruptedData->data() + 13);
+    const auto corruptedRoot
+        = unique_ptr<NodeEntry>(EntryParser(shared_ptr<const char>(corruptedData, corruptedData->data()), data.size()).parseNodeEntry());
+    CPPUNIT_ASSERT_THROW(corruptedRoot->children(), ParsingException);
+    CPPUNIT_ASSERT_MESSAGE("children still deferred after parsing error", corruptedRoot->hasDeferredChildren());
+}
+
+/*!
+ * \brief Tests parsing deferred children concurrently.
+ */
+void EntryParserTests::testConcurrentParsing()
+{
+    // create nodes of different sizes nested in different ways
+    NodeEntry root("root");
+    for (auto i = 0; i != 20; ++i) {
+        auto *const node = new NodeEntry(argsToString("node ", i), &root);
+        auto *const nestedNode = new NodeEntry("nested node", node);
+        for (auto j = 0; j != i * 10; ++j) {
+            new AccountEntry(argsToString("account ", j), j % 2 ? node : nestedNode);
+        }
+        new AccountEntry("account", &root);
+    }
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    root.make(stream, EntrySerializationFlags::SubtreeSizes);
+    const auto data = make_shared<string>(stream.str());
+
+    for (const auto threadCount : { 1_st, 3_st, 8_st }) {
+        const auto lazyRoot = unique_ptr<NodeEntry>(EntryParser(shared_ptr<const char>(data, data->data()), data->size()).parseNodeEntry());
+        CPPUNIT_ASSERT(lazyRoot->hasDeferredChildren());
+        lazyRoot->parseDeferredDescendants(threadCount);
+        CPPUNIT_ASSERT(!lazyRoot->hasDeferredChildren());
+        CPPUNIT_ASSERT_EQUAL(40_st, lazyRoot->children().size());
+        for (const auto *const child : lazyRoot->children()) {
+            if (child->type() == EntryType::Node) {
+                const auto *const node = static_cast<const NodeEntry *>(child);
+                CPPUNIT_ASSERT(!node->hasDeferredChildren());
+                CPPUNIT_ASSERT(!static_cast<const NodeEntry *>(node->children().front())->hasDeferredChildren());
+            }
+        }
+        const auto stats = lazyRoot->computeStatistics();
+        CPPUNIT_ASSERT_EQUAL(41_st, stats.nodeCount);
+        CPPUNIT_ASSERT_EQUAL(1920_st, stats.accountCount);
+        CPPUNIT_ASSERT_EQUAL(list<string>{ "root" CPP_UTILITIES_PP_COMMA "node 19" CPP_UTILITIES_PP_COMMA "nested node" },
+            static_cast<const NodeEntry *>(lazyRoot->children()[38])->children().front()->path());
+        stream.str(string());
+        lazyRoot->make(stream, EntrySerializationFlags::SubtreeSizes);
+        CPPUNIT_ASSERT_EQUAL(*data, stream.str());
+    }
+
+    // check whether a parsing error within one of the subtrees is propagated (the size of the children of the last
+    // nested node follows its label, the extended header and the child count)
+    const auto corruptedData = make_shared<string>(*data);
+    const auto sizeOffset = corruptedData->rfind("nested node") + 11 + 3 + 4;
+    CppUtilities::BE::getBytes(CppUtilities::BE::toUInt64(corruptedData->data() + sizeOffset) - 1, corruptedData->data() + sizeOffset);
+    const auto corruptedRoot = unique_ptr<NodeEntry>(
+        EntryParser(shared_ptr<const char>(corruptedData, corruptedData->data()), corruptedData->size()).parseNodeEntry());
+    CPPUNIT_ASSERT_THROW(corruptedRoot->parseDeferredDescendants(8), ParsingException);
+}
+
+/*!
+ * \brief Tests reading a lazily parsed tree from multiple threads at the same time via const methods.
+ */
+void EntryParserTests::testConcurrentReading()
+{
+    NodeEntry root("root");
+    for (auto i = 0; i != 10; ++i) {
+        auto *const node = new NodeEntry(argsToString("node ", i), &root);
+        for (auto j = 0; j != 10; ++j) {
+            new AccountEntry(argsToString("account ", j), new NodeEntry(argsToString("nested node ", j), node));
+        }
+    }
+    const auto flags = EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes;
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    root.make(stream, flags);
+    const auto data = make_shared<string>(stream.str());
+    stream.str(string());
+    root.make(stream);
+    const auto dataWithoutSubtreeSizes = stream.str();
+
+    for (auto iteration = 0; iteration != 10; ++iteration) {
+        const auto lazyRoot = unique_ptr<NodeEntry>(EntryParser(shared_ptr<const char>(data, data->data()), data->size()).parseNodeEntry());
+        auto readers = vector<thread>();
+        auto results = vector<string>(8);
+        auto stats = vector<EntryStatistics>(results.size());
+        for (auto i = 0_st; i != results.size(); ++i) {
+            readers.emplace_back([&, i] {
+                auto readerStream = stringstream(ios_base::in | ios_base::out | ios_base::binary);
+                switch (i % 4) {
+                case 0:
+                    lazyRoot->make(readerStream, flags | EntrySerializationFlags::CacheSubtrees);
+                    break;
+                case 1:
+                    lazyRoot->make(readerStream);
+                    break;
+                case 2:
+                    unique_ptr<NodeEntry>(lazyRoot->clone())->make(readerStream, flags);
+                    break;
+                default:
+                    lazyRoot->parseDeferredDescendants(2);
+                    lazyRoot->make(readerStream, flags);
+                }
+                stats[i] = lazyRoot->computeStatistics();
+                results[i] = readerStream.str();
+            });
+        }
+        for (auto &reader : readers) {
+            reader.join();
+        }
+        for (auto i = 0_st; i != results.size(); ++i) {
+            CPPUNIT_ASSERT_EQUAL(i % 4 == 1 ? dataWithoutSubtreeSizes : *data, results[i]);
+            CPPUNIT_ASSERT_EQUAL(111_st, stats[i].nodeCount);
+            CPPUNIT_ASSERT_EQUAL(100_st, stats[i].accountCount);
+        }
+        CPPUNIT_ASSERT(!lazyRoot->hasDeferredChildren());
+    }
+}
+
+/*!
+ * \brief Tests serializing and parsing accounts referring to field shapes (AccountEntry version 0x2).
+ */
+void EntryParserTests::testFieldShapes()
+{
+    // add accounts with the same field names to the tree from setUp()
+    const auto root = unique_ptr<NodeEntry>(EntryParser(m_serializedTree.data(), m_serializedTree.size()).parseNodeEntry());
+    for (auto i = 0; i != 10; ++i) {
+        auto *const account = new AccountEntry(argsToString("similar account ", i), root.get());
+        account->fields().emplace_back(account, "user", argsToString("user ", i));
+        account->fields().emplace_back(account, "password", argsToString("password ", i));
+        account->fields().back().setType(FieldType::Password);
+    }
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    root->make(stream);
+    const auto withoutShapes = stream.str();
+    stream.str(string());
+    root->make(stream, EntrySerializationFlags::FieldShapes);
+    const auto withShapes = stream.str();
+    CPPUNIT_ASSERT_LESS(withoutShapes.size(), withShapes.size());
+
+    // parse via EntryParser and via the constructors taking an std::istream
+    const auto parsedRoot = unique_ptr<NodeEntry>(EntryParser(withShapes.data(), withShapes.size()).parseNodeEntry());
+    stream.seekg(0);
+    const auto parsedRootFromStream = unique_ptr<Entry>(Entry::parse(stream));
+    for (const auto *const entry : { static_cast<const Entry *>(parsedRoot.get()), static_cast<const Entry *>(parsedRootFromStream.get()) }) {
+        const auto &children = static_cast<const NodeEntry *>(entry)->children();
+        CPPUNIT_ASSERT_EQUAL(13_st, children.size());
+        CPPUNIT_ASSERT_EQUAL(string(300, 'n'), static_cast<const AccountEntry *>(children[0])->fields()[2].value());
+        CPPUNIT_ASSERT_EQUAL(1_st, static_cast<const NodeEntry *>(children[1])->children().size());
+        const auto &firstFields = static_cast<const AccountEntry *>(children[3])->fields();
+        const auto &lastFields = static_cast<const AccountEntry *>(children[12])->fields();
+        CPPUNIT_ASSERT_EQUAL("similar account 9"s, children[12]->label());
+        CPPUNIT_ASSERT_EQUAL(2_st, lastFields.size());
+        CPPUNIT_ASSERT_EQUAL("password"s, lastFields[1].name());
+        CPPUNIT_ASSERT_EQUAL("password 9"s, lastFields[1].value());
+        CPPUNIT_ASSERT_EQUAL(FieldType::Password, lastFields[1].type());
+        CPPUNIT_ASSERT(lastFields[1].tiedAccount() == children[12]);
+        CPPUNIT_ASSERT_MESSAGE("names shared between accounts", firstFields[1].sharedName() == lastFields[1].sharedName());
+    }
+    stream.str(string());
+    parsedRoot->make(stream);
+    CPPUNIT_ASSERT_EQUAL(withoutShapes, stream.str());
+
+    // check whether names are shared when parsing accounts without shapes as well
+    const auto parsedRootWithoutShapes = unique_ptr<NodeEntry>(EntryParser(withoutShapes.data(), withoutShapes.size()).parseNodeEntry());
+    const auto &children = parsedRootWithoutShapes->children();
+    CPPUNIT_ASSERT(static_cast<const AccountEntry *>(children[0])->fields()[1].sharedName()
+        == static_cast<const AccountEntry *>(children[12])->fields()[1].sharedName());
+
+    // check whether undefined shapes are detected
+    auto invalidShape = withShapes;
+    const auto shapeIndexOffset = invalidShape.find("account") + 7 + 2;
+    CppUtilities::BE::getBytes(static_cast<std::uint32_t>(1), invalidShape.data() + shapeIndexOffset);
+    CPPUNIT_ASSERT_THROW(EntryParser(invalidShape.data(), invalidShape.size()).parseEntry(), ParsingException);
+}
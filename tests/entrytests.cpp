@@ -2,6 +2,9 @@
 
 #include "./utils.h"
 
+#include <sstream>
+#include <utility>
+
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
 
@@ -20,6 +23,8 @@ class EntryTests : public TestFixture {
     CPPUNIT_TEST(testNesting);
     CPPUNIT_TEST(testEntryByPath);
     CPPUNIT_TEST(testUniqueLabels);
+    CPPUNIT_TEST(testSubtreeCaching);
+    CPPUNIT_TEST(testSerializedSize);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -30,6 +35,8 @@ public:
     void testNesting();
     void testEntryByPath();
     void testUniqueLabels();
+    void testSubtreeCaching();
+    void testSerializedSize();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(EntryTests);
@@ -193,3 +200,167 @@ void EntryTests::testUniqueLabels()
     const auto *const foo3Entry = new AccountEntry("foo", &root);
     CPPUNIT_ASSERT_EQUAL_MESSAGE("3rd foo renamed to foo 3", "foo 3"s, foo3Entry->label());
 }
+
+/*!
+ * \brief Tests caching the serialized children of node entries and discarding the cache when entries are modified.
+ */
+void EntryTests::testSubtreeCaching()
+{
+    constexpr auto flags = EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes;
+    NodeEntry root("root");
+    auto *const node = new NodeEntry("node", &root);
+    auto *const nestedNode = new NodeEntry("nested node", node);
+    auto *const account = new AccountEntry("account", nestedNode);
+    account->fields().emplace_back(account, "user", "foo");
+    auto *const otherNode = new NodeEntry("other node", &root);
+    new AccountEntry("other account", otherNode);
+    const auto make = [&root](EntrySerializationFlags makeFlags) {
+        stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+        root.make(stream, makeFlags);
+        return stream.str();
+    };
+    const auto checkCached = [&](bool rootCached, bool nodeCached, bool nestedNodeCached, bool otherNodeCached) {
+        CPPUNIT_ASSERT_EQUAL(rootCached, root.hasCachedChildren());
+        CPPUNIT_ASSERT_EQUAL(nodeCached, node->hasCachedChildren());
+        CPPUNIT_ASSERT_EQUAL(nestedNodeCached, nestedNode->hasCachedChildren());
+        CPPUNIT_ASSERT_EQUAL(otherNodeCached, otherNode->hasCachedChildren());
+    };
+
+    // serializing without CacheSubtrees does not populate the cache
+    auto expected = make(flags);
+    checkCached(false, false, false, false);
+
+    // serializing with CacheSubtrees yields the same data and populates the cache
+    CPPUNIT_ASSERT_EQUAL(expected, make(flags | EntrySerializationFlags::CacheSubtrees));
+    checkCached(true, true, true, true);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("cached data used", expected, make(flags));
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(
+        "cached data not used for different flags", make(EntrySerializationFlags::None), make(EntrySerializationFlags::None));
+    checkCached(true, true, true, true);
+
+    // modifying a field discards the cache of the ancestors only
+    account->fields().front().setValue("bar");
+    checkCached(false, false, false, true);
+    expected = make(flags);
+    CPPUNIT_ASSERT_EQUAL(expected, make(flags | EntrySerializationFlags::CacheSubtrees));
+    checkCached(true, true, true, true);
+    const auto copy = unique_ptr<NodeEntry>(root.clone());
+    stringstream copyStream(ios_base::in | ios_base::out | ios_base::binary);
+    copy->make(copyStream, flags);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("copy shares cached data", expected, copyStream.str());
+    CPPUNIT_ASSERT(copy->hasCachedChildren());
+
+    // modifying entries discards the cache of the affected nodes and their ancestors
+    otherNode->setLabel("renamed node");
+    checkCached(false, true, true, true);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    otherNode->setExpandedByDefault(false);
+    checkCached(false, true, true, true);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    account->setParent(otherNode);
+    checkCached(false, false, false, false);
+    CPPUNIT_ASSERT_EQUAL(make(flags), make(flags | EntrySerializationFlags::CacheSubtrees));
+    otherNode->deleteChildren(0, 1);
+    checkCached(false, true, true, false);
+    expected = make(flags);
+    CPPUNIT_ASSERT_EQUAL(expected, make(flags | EntrySerializationFlags::CacheSubtrees));
+    checkCached(true, true, true, true);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("cached children remain valid after re-serializing", expected, make(flags));
+    CPPUNIT_ASSERT_MESSAGE("copy unaffected by modifications", copyStream.str() != expected);
+    stringstream copyStream2(ios_base::in | ios_base::out | ios_base::binary);
+    copy->make(copyStream2, flags);
+    CPPUNIT_ASSERT_EQUAL(copyStream.str(), copyStream2.str());
+
+    // reading fields via the const overload does not discard the cache but accessing them for modification does
+    CPPUNIT_ASSERT_EQUAL("bar"s, as_const(*account).fields().front().value());
+    checkCached(true, true, true, true);
+    account->fields().emplace_back(account, "email", "foo@bar");
+    checkCached(false, true, true, false);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    checkCached(true, true, true, true);
+    account->removeField(1);
+
+    // adding, replacing and removing fields discards the cache as well
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    checkCached(true, true, true, true);
+    CPPUNIT_ASSERT(account->addField(Field(nullptr, "password", "secret")).tiedAccount() == account);
+    checkCached(false, true, true, false);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    account->replaceField(1, Field(nullptr, "pin", "1234"));
+    CPPUNIT_ASSERT(account->fields().back().tiedAccount() == account);
+    checkCached(false, true, true, false);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    account->removeField(0);
+    checkCached(false, true, true, false);
+    CPPUNIT_ASSERT_EQUAL(1_st, account->fields().size());
+    CPPUNIT_ASSERT_EQUAL("pin"s, account->fields().front().name());
+
+    // fields of a cloned account are tied to the clone so modifying them discards the cache of the clone's ancestors
+    auto *const clonedAccount = account->clone();
+    clonedAccount->setLabel("cloned account");
+    clonedAccount->setParent(nestedNode);
+    auto copiedField = as_const(*account).fields().front();
+    delete account;
+    copiedField.setValue("copied field outlives its account");
+    CPPUNIT_ASSERT(clonedAccount->fields().front().tiedAccount() == clonedAccount);
+    make(flags | EntrySerializationFlags::CacheSubtrees);
+    checkCached(true, true, true, true);
+    clonedAccount->fields().front().setValue("4321");
+    checkCached(false, false, false, true);
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    root.make(stream, flags | EntrySerializationFlags::CacheSubtrees);
+    stream.seekg(0);
+    const auto parsedRoot = unique_ptr<Entry>(Entry::parse(stream));
+    auto path = list<string>{ "root", "node", "nested node", "cloned account" };
+    const auto *const parsedAccount = static_cast<NodeEntry *>(parsedRoot.get())->entryByPath(path);
+    CPPUNIT_ASSERT(parsedAccount && parsedAccount->type() == EntryType::Account);
+    CPPUNIT_ASSERT_EQUAL("4321"s, static_cast<const AccountEntry *>(parsedAccount)->fields().front().value());
+}
+
+/*!
+ * \brief Tests whether the sizes computed by Entry::serializedSize() and Field::serializedSize() match the serialized data.
+ */
+void EntryTests::testSerializedSize()
+{
+    NodeEntry root("root");
+    root.setExpandedByDefault(false);
+    auto *const node = new NodeEntry(string(200, 'n'), &root);
+    for (auto i = 0; i != 3; ++i) {
+        auto *const account = new AccountEntry("account", i == 2 ? &root : node);
+        account->fields().emplace_back(account, "user", "foo");
+        account->fields().emplace_back(account, i ? "password" : "pin", string(0x4000, 'p'));
+    }
+    new NodeEntry("empty node", node);
+
+    const auto serialize = [](const auto &serializable, auto... flags) {
+        stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+        serializable.make(stream, flags...);
+        return static_cast<std::uint64_t>(stream.str().size());
+    };
+    const auto *const field = &static_cast<const AccountEntry *>(node->children().front())->fields().back();
+    CPPUNIT_ASSERT_EQUAL(serialize(*field), field->serializedSize());
+    CPPUNIT_ASSERT_EQUAL(3_st + 0x4000, Field::serializedSize(string(0x4000, 'p')));
+    CPPUNIT_ASSERT_EQUAL(1_st, Field::serializedSize(string()));
+
+    for (const auto flags : { EntrySerializationFlags::None, EntrySerializationFlags::SubtreeSizes, EntrySerializationFlags::FieldShapes,
+             EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes,
+             EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes | EntrySerializationFlags::CacheSubtrees }) {
+        CPPUNIT_ASSERT_EQUAL(serialize(root, flags), root.serializedSize(flags));
+        CPPUNIT_ASSERT_EQUAL(serialize(*node, flags), node->serializedSize(flags));
+        CPPUNIT_ASSERT_EQUAL(serialize(*root.children().back(), flags), root.children().back()->serializedSize(flags));
+    }
+
+    // the cached size is discarded when modifying entries
+    constexpr auto flags = EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes;
+    const auto size = root.serializedSize(flags);
+    auto *const account = static_cast<AccountEntry *>(node->children().front());
+    account->fields().back().setName("password");
+    // note: The shape is now shared with the next account saving the field count and names but the new name is 5 bytes longer.
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("field shape shared with sibling", size - 4 - (1 + 4) - (1 + 8) + 5, root.serializedSize(flags));
+    CPPUNIT_ASSERT_EQUAL(serialize(root, flags), root.serializedSize(flags));
+    account->setParent(nullptr);
+    CPPUNIT_ASSERT_EQUAL(serialize(root, flags), root.serializedSize(flags));
+    delete account;
+    node->setLabel("node");
+    CPPUNIT_ASSERT_EQUAL(serialize(root, flags), root.serializedSize(flags));
+}
@@ -66,4 +66,16 @@ void FieldTests::testMutation()
     CPPUNIT_ASSERT_EQUAL("bar"s, field.name());
     CPPUNIT_ASSERT_EQUAL("foo"s, field.value());
     CPPUNIT_ASSERT_EQUAL(FieldType::Password, field.type());
+
+    // copies share the name until it is changed
+    Field copy(field);
+    CPPUNIT_ASSERT(copy.sharedName() == field.sharedName());
+    copy.setName("foo");
+    CPPUNIT_ASSERT_EQUAL("foo"s, copy.name());
+    CPPUNIT_ASSERT_EQUAL("bar"s, field.name());
+    copy.setName(field.sharedName());
+    CPPUNIT_ASSERT_EQUAL("bar"s, copy.name());
+    copy.setName(string());
+    CPPUNIT_ASSERT(!copy.sharedName());
+    CPPUNIT_ASSERT_EQUAL(string(), copy.name());
 }
@@ -0,0 +1,173 @@
+#include "../io/entry.h"
+#include "../io/flatpasswordstore.h"
+#include "../io/passwordfile.h"
+
+#include "./utils.h"
+
+#include <c++utilities/tests/testutils.h>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The FlatPasswordStoreTests class tests the Io::FlatPasswordStore class.
+ */
+class FlatPasswordStoreTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(FlatPasswordStoreTests);
+    CPPUNIT_TEST(testEmptyStore);
+    CPPUNIT_TEST(testLayout);
+    CPPUNIT_TEST(testEntryByPath);
+    CPPUNIT_TEST(testLoadedFile);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testEmptyStore();
+    void testLayout();
+    void testEntryByPath();
+    void testLoadedFile();
+
+private:
+    NodeEntry m_root;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlatPasswordStoreTests);
+
+void FlatPasswordStoreTests::setUp()
+{
+    m_root.setLabel("root");
+    auto *const account1 = new AccountEntry("zaccount", &m_root);
+    account1->fields().emplace_back(account1, "user", "foo");
+    account1->fields().emplace_back(account1, "password", "bar");
+    account1->fields().back().setType(FieldType::Password);
+    auto *const category = new NodeEntry("category", &m_root);
+    auto *const account2 = new AccountEntry("account", category);
+    account2->fields().emplace_back(account2, "user", "baz");
+    new NodeEntry("empty", category);
+    new AccountEntry("maccount", &m_root);
+}
+
+void FlatPasswordStoreTests::tearDown()
+{
+    m_root.deleteChildren(0, static_cast<int>(m_root.children().size()));
+}
+
+void FlatPasswordStoreTests::testEmptyStore()
+{
+    const FlatPasswordStore store;
+    CPPUNIT_ASSERT(store.isEmpty());
+    CPPUNIT_ASSERT_EQUAL(0u, store.entryCount());
+    CPPUNIT_ASSERT_EQUAL(0u, store.fieldCount());
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({ "root" }));
+}
+
+/*!
+ * \brief Tests whether entries are stored in breadth-first order and fields/strings are referenced correctly.
+ */
+void FlatPasswordStoreTests::testLayout()
+{
+    const FlatPasswordStore store(m_root);
+    CPPUNIT_ASSERT(!store.isEmpty());
+    CPPUNIT_ASSERT_EQUAL(6u, store.entryCount());
+    CPPUNIT_ASSERT_EQUAL(3u, store.fieldCount());
+
+    // root entry and its children have consecutive indices
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, store.type(FlatPasswordStore::rootIndex));
+    CPPUNIT_ASSERT_EQUAL("root"s, string(store.label(FlatPasswordStore::rootIndex)));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.parent(FlatPasswordStore::rootIndex));
+    CPPUNIT_ASSERT_EQUAL(1u, store.childrenBegin(FlatPasswordStore::rootIndex));
+    CPPUNIT_ASSERT_EQUAL(4u, store.childrenEnd(FlatPasswordStore::rootIndex));
+    CPPUNIT_ASSERT_EQUAL(store.fieldsEnd(FlatPasswordStore::rootIndex), store.fieldsBegin(FlatPasswordStore::rootIndex));
+    CPPUNIT_ASSERT_EQUAL("zaccount"s, string(store.label(1)));
+    CPPUNIT_ASSERT_EQUAL("category"s, string(store.label(2)));
+    CPPUNIT_ASSERT_EQUAL("maccount"s, string(store.label(3)));
+    for (auto child = store.childrenBegin(FlatPasswordStore::rootIndex); child != store.childrenEnd(FlatPasswordStore::rootIndex); ++child) {
+        CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::rootIndex, store.parent(child));
+    }
+
+    // children of the nested category follow
+    CPPUNIT_ASSERT_EQUAL(4u, store.childrenBegin(2));
+    CPPUNIT_ASSERT_EQUAL(6u, store.childrenEnd(2));
+    CPPUNIT_ASSERT_EQUAL("account"s, string(store.label(4)));
+    CPPUNIT_ASSERT_EQUAL(2u, store.parent(4));
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, store.type(5));
+    CPPUNIT_ASSERT_EQUAL(store.childrenEnd(5), store.childrenBegin(5));
+
+    // fields
+    CPPUNIT_ASSERT_EQUAL(EntryType::Account, store.type(1));
+    CPPUNIT_ASSERT_EQUAL(store.childrenEnd(1), store.childrenBegin(1));
+    CPPUNIT_ASSERT_EQUAL(0u, store.fieldsBegin(1));
+    CPPUNIT_ASSERT_EQUAL(2u, store.fieldsEnd(1));
+    CPPUNIT_ASSERT_EQUAL("user"s, string(store.fieldName(0)));
+    CPPUNIT_ASSERT_EQUAL("foo"s, string(store.fieldValue(0)));
+    CPPUNIT_ASSERT_EQUAL(FieldType::Normal, store.fieldType(0));
+    CPPUNIT_ASSERT_EQUAL("password"s, string(store.fieldName(1)));
+    CPPUNIT_ASSERT_EQUAL("bar"s, string(store.fieldValue(1)));
+    CPPUNIT_ASSERT_EQUAL(FieldType::Password, store.fieldType(1));
+    CPPUNIT_ASSERT_EQUAL(store.fieldsEnd(3), store.fieldsBegin(3));
+    CPPUNIT_ASSERT_EQUAL(2u, store.fieldsBegin(4));
+    CPPUNIT_ASSERT_EQUAL(3u, store.fieldsEnd(4));
+    CPPUNIT_ASSERT_EQUAL("baz"s, string(store.fieldValue(2)));
+
+    // equal field names are stored only once
+    CPPUNIT_ASSERT_EQUAL(store.fieldName(0).data(), store.fieldName(2).data());
+
+    // the snapshot is not affected by modifications of the tree
+    m_root.children()[0]->setLabel("modified");
+    CPPUNIT_ASSERT_EQUAL("zaccount"s, string(store.label(1)));
+}
+
+void FlatPasswordStoreTests::testEntryByPath()
+{
+    const FlatPasswordStore store(m_root);
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::rootIndex, store.entryByPath({ "root" }));
+    CPPUNIT_ASSERT_EQUAL(1u, store.entryByPath({ "root", "zaccount" }));
+    CPPUNIT_ASSERT_EQUAL(3u, store.entryByPath({ "root", "maccount" }));
+    CPPUNIT_ASSERT_EQUAL(4u, store.entryByPath({ "root", "category", "account" }));
+    CPPUNIT_ASSERT_EQUAL(5u, store.entryByPath(list<string>{ "root", "category", "empty" }));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({}));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({ "foo" }));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({ "root", "account" }));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({ "root", "zaccount", "foo" }));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.entryByPath({ "root", "category", "empty", "foo" }));
+    CPPUNIT_ASSERT_EQUAL(2u, store.childByLabel(FlatPasswordStore::rootIndex, "category"));
+    CPPUNIT_ASSERT_EQUAL(FlatPasswordStore::invalidIndex, store.childByLabel(1, "category"));
+}
+
+/*!
+ * \brief Tests creating a snapshot of a loaded file, including one loaded lazily.
+ */
+void FlatPasswordStoreTests::testLoadedFile()
+{
+    for (const auto openFlags : { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::LazyLoading }) {
+        PasswordFile file(testFilePath("testfile1.pwmgr"), "123456");
+        file.open(openFlags);
+        file.load();
+
+        const FlatPasswordStore store(*file.rootEntry());
+        const auto stats = file.rootEntry()->computeStatistics();
+        CPPUNIT_ASSERT_EQUAL(stats.nodeCount + stats.accountCount, static_cast<std::size_t>(store.entryCount()));
+        CPPUNIT_ASSERT_EQUAL(stats.fieldCount, static_cast<std::size_t>(store.fieldCount()));
+
+        const auto account = store.entryByPath({ "testfile1", "testaccount1" });
+        CPPUNIT_ASSERT(account != FlatPasswordStore::invalidIndex);
+        CPPUNIT_ASSERT_EQUAL(EntryType::Account, store.type(account));
+        CPPUNIT_ASSERT_EQUAL(2u, store.fieldsEnd(account) - store.fieldsBegin(account));
+        CPPUNIT_ASSERT_EQUAL("pin"s, string(store.fieldName(store.fieldsBegin(account))));
+        CPPUNIT_ASSERT_EQUAL("123456"s, string(store.fieldValue(store.fieldsBegin(account))));
+        CPPUNIT_ASSERT_EQUAL(FieldType::Password, store.fieldType(store.fieldsBegin(account)));
+
+        const auto category = store.entryByPath({ "testfile1", "testcategory1" });
+        CPPUNIT_ASSERT(category != FlatPasswordStore::invalidIndex);
+        CPPUNIT_ASSERT_EQUAL(3u, store.childrenEnd(category) - store.childrenBegin(category));
+    }
+}
@@ -0,0 +1,191 @@
+#include "../io/cryptoexception.h"
+#include "../io/derivedkeycache.h"
+#include "../io/keyderivation.h"
+
+#include "./utils.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <openssl/evp.h>
+
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The KeyDerivationTests class tests the key derivation functions in the Io namespace.
+ */
+class KeyDerivationTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(KeyDerivationTests);
+    CPPUNIT_TEST(testLegacyHashing);
+    CPPUNIT_TEST(testStandardFunctions);
+    CPPUNIT_TEST(testLanes);
+    CPPUNIT_TEST(testInvalidParameters);
+    CPPUNIT_TEST(testCalibration);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testLegacyHashing();
+    void testStandardFunctions();
+    void testLanes();
+    void testInvalidParameters();
+    void testCalibration();
+
+private:
+    const std::string m_password = "secret";
+    unsigned char m_key[DerivedKeyCache::keySize];
+    unsigned char m_expectedKey[DerivedKeyCache::keySize];
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(KeyDerivationTests);
+
+void KeyDerivationTests::setUp()
+{
+}
+
+void KeyDerivationTests::tearDown()
+{
+}
+
+void KeyDerivationTests::testLegacyHashing()
+{
+    auto parameters = KeyDerivationParameters();
+    deriveKey(m_password, parameters, m_key);
+    std::memset(m_expectedKey, 0, sizeof(m_expectedKey));
+    std::memcpy(m_expectedKey, m_password.data(), m_password.size());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("password used directly without iterations", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+
+    parameters.iterations = 2;
+    deriveKey(m_password, parameters, m_key);
+    auto length = 0u;
+    EVP_Digest(m_password.data(), m_password.size(), m_expectedKey, &length, EVP_sha256(), nullptr);
+    EVP_Digest(m_expectedKey, sizeof(m_expectedKey), m_expectedKey, &length, EVP_sha256(), nullptr);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("password hashed twice", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+}
+
+void KeyDerivationTests::testStandardFunctions()
+{
+    // one lane equals the standard function
+    auto parameters = KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1000);
+    deriveKey(m_password, parameters, m_key);
+    PKCS5_PBKDF2_HMAC(m_password.data(), static_cast<int>(m_password.size()), parameters.salt.data(), static_cast<int>(parameters.salt.size()),
+        1000, EVP_sha256(), static_cast<int>(sizeof(m_expectedKey)), m_expectedKey);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("PBKDF2", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+
+    parameters = KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1024);
+    deriveKey(m_password, parameters, m_key);
+    EVP_PBE_scrypt(m_password.data(), m_password.size(), parameters.salt.data(), parameters.salt.size(), 1024, 8, 1, 0, m_expectedKey,
+        sizeof(m_expectedKey));
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("scrypt", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+
+    // new salts are generated
+    CPPUNIT_ASSERT(parameters != KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1024));
+
+    if (isKeyDerivationFunctionSupported(KeyDerivationFunction::Argon2id)) {
+        parameters = KeyDerivationParameters::create(KeyDerivationFunction::Argon2id, 2, 1024, 4);
+        deriveKey(m_password, parameters, m_key, 1);
+        deriveKey(m_password, parameters, m_expectedKey, 4);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("Argon2id independent of threads", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+    }
+}
+
+void KeyDerivationTests::testLanes()
+{
+    for (const auto function : { KeyDerivationFunction::Pbkdf2HmacSha256, KeyDerivationFunction::Scrypt }) {
+        auto parameters = KeyDerivationParameters::create(function, 100, 256, 5);
+        deriveKey(m_password, parameters, m_expectedKey, 1);
+        deriveKey(m_password, parameters, m_key, 3);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE("independent of threads", 0, std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+
+        parameters.parallelism = 4;
+        deriveKey(m_password, parameters, m_key, 4);
+        CPPUNIT_ASSERT_MESSAGE("number of lanes matters", std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+        parameters.parallelism = 5;
+        parameters.salt[0] ^= 1;
+        deriveKey(m_password, parameters, m_key, 4);
+        CPPUNIT_ASSERT_MESSAGE("salt matters", std::memcmp(m_key, m_expectedKey, sizeof(m_key)));
+    }
+}
+
+void KeyDerivationTests::testInvalidParameters()
+{
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 0), m_key),
+        CryptoException);
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1000), m_key), CryptoException);
+    CPPUNIT_ASSERT_THROW(
+        deriveKey(m_password, KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1, 0, 0), m_key), CryptoException);
+    const auto tooManyLanes = KeyDerivationParameters::maxParallelism + 1;
+    CPPUNIT_ASSERT_THROW(
+        deriveKey(m_password, KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1, 0, tooManyLanes), m_key), CryptoException);
+
+    // the cost is limited (for PBKDF2 and scrypt the cost of all lanes together)
+    auto parameters = KeyDerivationParameters::create(KeyDerivationFunction::Sha256Iterations, KeyDerivationParameters::maxIterations);
+    CPPUNIT_ASSERT(parameters.isWithinLimits());
+    ++parameters.iterations;
+    CPPUNIT_ASSERT(!parameters.isWithinLimits());
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, parameters, m_key), CryptoException);
+    parameters = KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, KeyDerivationParameters::maxIterations / 4, 0, 4);
+    CPPUNIT_ASSERT(parameters.isWithinLimits());
+    parameters.parallelism = 5;
+    CPPUNIT_ASSERT(!parameters.isWithinLimits());
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, parameters, m_key), CryptoException);
+    parameters = KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, KeyDerivationParameters::maxMemoryCost, 1);
+    CPPUNIT_ASSERT(parameters.isWithinLimits());
+    parameters.parallelism = 2;
+    CPPUNIT_ASSERT(!parameters.isWithinLimits());
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, parameters, m_key), CryptoException);
+    parameters = KeyDerivationParameters::create(KeyDerivationFunction::Argon2id, KeyDerivationParameters::maxPasses, 1024, 16);
+    CPPUNIT_ASSERT(parameters.isWithinLimits());
+    parameters.iterations = KeyDerivationParameters::maxPasses + 1;
+    CPPUNIT_ASSERT(!parameters.isWithinLimits());
+    parameters.iterations = 1;
+    parameters.memoryCost = KeyDerivationParameters::maxMemoryCost + 1;
+    CPPUNIT_ASSERT(!parameters.isWithinLimits());
+    CPPUNIT_ASSERT_THROW(deriveKey(m_password, parameters, m_key), CryptoException);
+    if (!isKeyDerivationFunctionSupported(KeyDerivationFunction::Argon2id)) {
+        CPPUNIT_ASSERT_THROW(
+            deriveKey(m_password, KeyDerivationParameters::create(KeyDerivationFunction::Argon2id, 1, 1024), m_key), CryptoException);
+    }
+}
+
+void KeyDerivationTests::testCalibration()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto duration = std::chrono::milliseconds(40);
+    for (const auto function : { KeyDerivationFunction::Sha256Iterations, KeyDerivationFunction::Pbkdf2HmacSha256, KeyDerivationFunction::Scrypt }) {
+        const auto context = keyDerivationFunctionName(function);
+        auto uncalibrated = KeyDerivationParameters();
+        uncalibrated.function = function;
+        uncalibrated.parallelism = 2;
+        const auto parameters = calibrateKeyDerivation(uncalibrated, duration, 2);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, function, parameters.function);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 2u, parameters.parallelism);
+        if (function == KeyDerivationFunction::Scrypt) {
+            CPPUNIT_ASSERT_MESSAGE(context, parameters.memoryCost >= 2u);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 0u, parameters.memoryCost & (parameters.memoryCost - 1));
+        } else {
+            CPPUNIT_ASSERT_MESSAGE(context, parameters.iterations >= 1u);
+        }
+        if (function != KeyDerivationFunction::Sha256Iterations) {
+            CPPUNIT_ASSERT_MESSAGE(context, parameters.salt != uncalibrated.salt);
+        }
+
+        // deriving a key with the calibrated parameters takes roughly the specified duration (generous bounds to avoid flakiness)
+        const auto start = Clock::now();
+        deriveKey(m_password, parameters, m_key, 2);
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        CPPUNIT_ASSERT_LESS_MESSAGE(context, (duration * 20).count(), elapsed.count());
+    }
+
+    const auto description = keyDerivationParametersToString(KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1024, 3));
+    CPPUNIT_ASSERT_EQUAL("scrypt (1024 KiB, 3 lanes)"s, description);
+}
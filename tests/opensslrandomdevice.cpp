@@ -5,7 +5,12 @@
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <algorithm>
+#include <array>
 #include <random>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace Util;
@@ -19,6 +24,9 @@ using namespace CPPUNIT_NS;
 class OpenSslRandomDeviceTests : public TestFixture {
     CPPUNIT_TEST_SUITE(OpenSslRandomDeviceTests);
     CPPUNIT_TEST(testUsageWithStandardClasses);
+    CPPUNIT_TEST(testRanges);
+    CPPUNIT_TEST(testBytes);
+    CPPUNIT_TEST(testThreads);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -26,6 +34,9 @@ public:
     void tearDown() override;
 
     void testUsageWithStandardClasses();
+    void testRanges();
+    void testBytes();
+    void testThreads();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(OpenSslRandomDeviceTests);
@@ -49,3 +60,65 @@ void OpenSslRandomDeviceTests::testUsageWithStandardClasses()
     CPPUNIT_ASSERT_GREATEREQUAL(1, val);
     CPPUNIT_ASSERT_LESSEQUAL(10, val);
 }
+
+/*!
+ * \brief Tests generating numbers within a range.
+ */
+void OpenSslRandomDeviceTests::testRanges()
+{
+    const auto random = OpenSslRandomDevice();
+    CPPUNIT_ASSERT_EQUAL(5u, random(5, 5));
+    random(0, std::numeric_limits<std::uint32_t>::max());
+
+    // all numbers of a small range occur
+    auto counts = std::array<std::size_t, 7>();
+    for (auto i = 0; i != 7000; ++i) {
+        const auto number = random(10, 16);
+        CPPUNIT_ASSERT_GREATEREQUAL(10u, number);
+        CPPUNIT_ASSERT_LESSEQUAL(16u, number);
+        ++counts[number - 10];
+    }
+    CPPUNIT_ASSERT_GREATER(500_st, *std::min_element(counts.begin(), counts.end()));
+}
+
+/*!
+ * \brief Tests generating random bytes of sizes smaller and bigger than the pool.
+ */
+void OpenSslRandomDeviceTests::testBytes()
+{
+    const auto random = OpenSslRandomDevice();
+    for (const auto size : { 0_st, 1_st, 13_st, OpenSslRandomDevice::poolSize - 1, OpenSslRandomDevice::poolSize * 3 + 7 }) {
+        auto first = std::vector<unsigned char>(size), second = std::vector<unsigned char>(size);
+        random.generate(first.data(), size);
+        random.generate(second.data(), size);
+        if (size >= 13) {
+            CPPUNIT_ASSERT_MESSAGE("bytes are not repeated", first != second);
+            CPPUNIT_ASSERT_MESSAGE("bytes are not all zero", std::any_of(first.begin(), first.end(), [](auto byte) { return byte; }));
+        }
+    }
+}
+
+/*!
+ * \brief Tests whether different threads get different numbers.
+ */
+void OpenSslRandomDeviceTests::testThreads()
+{
+    auto numbers = std::vector<std::vector<OpenSslRandomDevice::result_type>>(4);
+    auto threads = std::vector<std::thread>();
+    for (auto &threadNumbers : numbers) {
+        threads.emplace_back([&threadNumbers] {
+            const auto random = OpenSslRandomDevice();
+            for (auto i = 0; i != 2000; ++i) {
+                threadNumbers.emplace_back(random());
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto distinctNumbers = std::set<OpenSslRandomDevice::result_type>();
+    for (const auto &threadNumbers : numbers) {
+        distinctNumbers.insert(threadNumbers.begin(), threadNumbers.end());
+    }
+    CPPUNIT_ASSERT_GREATER(7900_st, distinctNumbers.size());
+}
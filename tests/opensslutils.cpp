@@ -22,6 +22,8 @@ class OpenSslUtilsTests : public TestFixture {
     CPPUNIT_TEST_SUITE(OpenSslUtilsTests);
     CPPUNIT_TEST(testComputeSha256Sum);
     CPPUNIT_TEST(testGenerateRandomNumber);
+    CPPUNIT_TEST(testFetching);
+    CPPUNIT_TEST(testCipherContextPool);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -30,6 +32,8 @@ public:
 
     void testComputeSha256Sum();
     void testGenerateRandomNumber();
+    void testFetching();
+    void testCipherContextPool();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(OpenSslUtilsTests);
@@ -62,3 +66,38 @@ void OpenSslUtilsTests::testGenerateRandomNumber()
     CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(0u), generateRandomNumber(0u, 0u));
     CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(1u), generateRandomNumber(1u, 1u));
 }
+
+void OpenSslUtilsTests::testFetching()
+{
+    const auto *const cipher = fetchCipher("AES-256-GCM");
+    CPPUNIT_ASSERT(cipher);
+    CPPUNIT_ASSERT_EQUAL(cipher, fetchCipher("AES-256-GCM"));
+    CPPUNIT_ASSERT(!fetchCipher("no such cipher"));
+    const auto *const digest = fetchDigest("SHA256");
+    CPPUNIT_ASSERT(digest);
+    CPPUNIT_ASSERT_EQUAL(digest, fetchDigest("SHA256"));
+    CPPUNIT_ASSERT(!fetchDigest("no such digest"));
+}
+
+void OpenSslUtilsTests::testCipherContextPool()
+{
+    // a released context is re-used
+    const auto *releasedContext = static_cast<const void *>(nullptr);
+    {
+        auto context = CipherContext();
+        CPPUNIT_ASSERT(context.get());
+        releasedContext = context.get();
+    }
+    auto context = CipherContext();
+    CPPUNIT_ASSERT_EQUAL(releasedContext, static_cast<const void *>(context.get()));
+
+    // contexts in use are not handed out twice
+    auto otherContext = CipherContext();
+    CPPUNIT_ASSERT(otherContext.get());
+    CPPUNIT_ASSERT(context.get() != otherContext.get());
+
+    // moving takes over the context
+    auto movedContext = CipherContext(std::move(otherContext));
+    CPPUNIT_ASSERT(movedContext.get());
+    CPPUNIT_ASSERT(!otherContext.get());
+}
@@ -0,0 +1,110 @@
+#include "../io/cryptoexception.h"
+#include "../io/entry.h"
+#include "../io/passwordfilebatch.h"
+
+#include "./utils.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities;
+using namespace CppUtilities::Literals;
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The PasswordFileBatchTests class tests the Io::PasswordFileBatch class.
+ */
+class PasswordFileBatchTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(PasswordFileBatchTests);
+    CPPUNIT_TEST(testLoadingMany);
+    CPPUNIT_TEST(testErrors);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testLoadingMany();
+    void testErrors();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PasswordFileBatchTests);
+
+void PasswordFileBatchTests::setUp()
+{
+}
+
+void PasswordFileBatchTests::tearDown()
+{
+}
+
+/*!
+ * \brief Tests loading many files saved with different features.
+ */
+void PasswordFileBatchTests::testLoadingMany()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+
+    const PasswordFileSaveFlags options[] = {
+        PasswordFileSaveFlags::Default,
+        PasswordFileSaveFlags::Compression | PasswordFileSaveFlags::AllowToCreateNewFile,
+        PasswordFileSaveFlags::Default | PasswordFileSaveFlags::ChunkedCompression,
+    };
+    auto jobs = std::vector<PasswordFileBatchJob>();
+    for (auto i = 0u; i != 24u; ++i) {
+        file.rootEntry()->setLabel(argsToString("file ", i));
+        file.setPath(argsToString(testfile, '.', i));
+        file.setPassword(argsToString("password ", i));
+        file.save(options[i % 3]);
+        jobs.emplace_back(PasswordFileBatchJob{ file.path(), file.password() });
+    }
+
+    for (const auto threadCount : { 1_st, 4_st, 0_st }) {
+        const auto results = PasswordFileBatch(threadCount).loadMany(jobs);
+        CPPUNIT_ASSERT_EQUAL(jobs.size(), results.size());
+        for (auto i = 0u; i != 24u; ++i) {
+            const auto &result = results[i];
+            CPPUNIT_ASSERT(!result.error);
+            CPPUNIT_ASSERT(result.file);
+            CPPUNIT_ASSERT(!result.file->isOpen());
+            CPPUNIT_ASSERT_EQUAL(jobs[i].path, result.file->path());
+            CPPUNIT_ASSERT_EQUAL(argsToString("file ", i), result.file->rootEntry()->label());
+            CPPUNIT_ASSERT_EQUAL(7_st, result.file->rootEntry()->computeStatistics().accountCount);
+        }
+    }
+
+    // open flags are taken into account
+    auto batch = PasswordFileBatch(2, PasswordFileOpenFlags::LazyLoading | PasswordFileOpenFlags::MemoryMapped);
+    const auto results = batch.loadMany(jobs);
+    CPPUNIT_ASSERT(results.back().file);
+    CPPUNIT_ASSERT_EQUAL(7_st, results.back().file->rootEntry()->computeStatistics().accountCount);
+    CPPUNIT_ASSERT(PasswordFileBatch().loadMany({}).empty());
+}
+
+/*!
+ * \brief Tests whether errors are reported per file.
+ */
+void PasswordFileBatchTests::testErrors()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    const auto jobs = std::vector<PasswordFileBatchJob>{
+        { testfile, "123456" },
+        { testfile + ".does-not-exist", "123456" },
+        { testfile, "654321" },
+        { testfile, "123456" },
+    };
+    const auto results = PasswordFileBatch(2).loadMany(jobs);
+    CPPUNIT_ASSERT_EQUAL(4_st, results.size());
+    CPPUNIT_ASSERT(results[0].file);
+    CPPUNIT_ASSERT(results[3].file);
+    CPPUNIT_ASSERT(!results[1].file);
+    CPPUNIT_ASSERT_THROW(std::rethrow_exception(results[1].error), std::ios_base::failure);
+    CPPUNIT_ASSERT(!results[2].file);
+    CPPUNIT_ASSERT_THROW(std::rethrow_exception(results[2].error), CryptoException);
+}
@@ -1,12 +1,21 @@
+#include "../io/chunkedcompression.h"
 #include "../io/cryptoexception.h"
 #include "../io/entry.h"
+#include "../io/parsingexception.h"
 #include "../io/passwordfile.h"
+#include "../io/segmentedencryption.h"
 
 #include "./utils.h"
 
+#include <c++utilities/conversion/stringbuilder.h>
+
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <filesystem>
+#include <iterator>
+#include <sstream>
+
 using namespace std;
 using namespace Io;
 using namespace CppUtilities;
@@ -19,8 +28,21 @@ using namespace CPPUNIT_NS;
 class PasswordFileTests : public TestFixture {
     CPPUNIT_TEST_SUITE(PasswordFileTests);
     CPPUNIT_TEST(testReading);
+    CPPUNIT_TEST(testMemoryMappedReading);
     CPPUNIT_TEST(testBasicWriting);
     CPPUNIT_TEST(testExtendedWriting);
+    CPPUNIT_TEST(testLargeFile);
+    CPPUNIT_TEST(testProbing);
+    CPPUNIT_TEST(testKeyCaching);
+    CPPUNIT_TEST(testSerializedSize);
+    CPPUNIT_TEST(testReplacingFile);
+    CPPUNIT_TEST(testAsyncSaving);
+    CPPUNIT_TEST(testCompressionCodecs);
+    CPPUNIT_TEST(testChunkedCompression);
+    CPPUNIT_TEST(testAuthenticatedEncryption);
+    CPPUNIT_TEST(testSegmentedEncryption);
+    CPPUNIT_TEST(testKeyDerivation);
+    CPPUNIT_TEST(testKeyDerivationCalibration);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -29,9 +51,23 @@ public:
 
     void testReading();
     void testReading(const string &context, const string &testfile1path, const string &testfile1password, const string &testfile2,
-        const string &testfile2password, bool testfile2Mod, bool extendedHeaderMod);
+        const string &testfile2password, bool testfile2Mod, bool extendedHeaderMod,
+        PasswordFileOpenFlags openFlags = PasswordFileOpenFlags::ReadOnly);
+    void testMemoryMappedReading();
     void testBasicWriting();
     void testExtendedWriting();
+    void testLargeFile();
+    void testProbing();
+    void testKeyCaching();
+    void testSerializedSize();
+    void testReplacingFile();
+    void testAsyncSaving();
+    void testCompressionCodecs();
+    void testChunkedCompression();
+    void testAuthenticatedEncryption();
+    void testSegmentedEncryption();
+    void testKeyDerivation();
+    void testKeyDerivationCalibration();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(PasswordFileTests);
@@ -53,13 +89,13 @@ void PasswordFileTests::testReading()
 }
 
 void PasswordFileTests::testReading(const string &context, const string &testfile1path, const string &testfile1password, const string &testfile2,
-    const string &testfile2password, bool testfilesMod, bool extendedHeaderMod)
+    const string &testfile2password, bool testfilesMod, bool extendedHeaderMod, PasswordFileOpenFlags openFlags)
 {
     PasswordFile file;
 
     // open testfile 1 ...
     file.setPath(testfile1path);
-    file.open(PasswordFileOpenFlags::ReadOnly);
+    file.open(openFlags);
 
     CPPUNIT_ASSERT_EQUAL_MESSAGE(context, !testfile1password.empty(), file.isEncryptionUsed());
     // attempt to decrypt using a wrong password
@@ -115,7 +151,7 @@ void PasswordFileTests::testReading(const string &context, const string &testfil
 
     // open testfile 2
     file.setPath(testfile2);
-    file.open(PasswordFileOpenFlags::ReadOnly);
+    file.open(openFlags);
 
     CPPUNIT_ASSERT_EQUAL_MESSAGE(context, !testfile2password.empty(), file.isEncryptionUsed());
     file.setPassword(testfile2password);
@@ -147,6 +183,15 @@ void PasswordFileTests::testReading(const string &context, const string &testfil
     }
 }
 
+/*!
+ * \brief Tests reading the testfiles testfile{1,2}.pwmgr when mapping them into memory.
+ */
+void PasswordFileTests::testMemoryMappedReading()
+{
+    testReading("memory-mapped read", testFilePath("testfile1.pwmgr"), "123456", testFilePath("testfile2.pwmgr"), string(), false, false,
+        PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped);
+}
+
 /*!
  * \brief Tests writing (and reading again) using basic features.
  */
@@ -235,3 +280,807 @@ void PasswordFileTests::testExtendedWriting()
     CPPUNIT_ASSERT(file.rootEntry());
     CPPUNIT_ASSERT(!file.rootEntry()->entryByPath(path));
 }
+
+/*!
+ * \brief Tests writing and reading a file which is too big to be read within one chunk.
+ */
+void PasswordFileTests::testLargeFile()
+{
+    const string testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.open();
+    file.load();
+
+    // add accounts with values that don't compress too well
+    auto *const category = new NodeEntry("large category", file.rootEntry());
+    for (auto i = 0u; i != 20000u; ++i) {
+        auto *const account = new AccountEntry(argsToString("account ", i), category);
+        account->fields().emplace_back(account, "username", argsToString("user", i));
+        account->fields().emplace_back(account, "password", argsToString(i * 2654435761u, '-', i * 40503u));
+    }
+
+    for (const auto options : { PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing, PasswordFileSaveFlags::Default,
+             PasswordFileSaveFlags::Compression }) {
+        file.save(options);
+        for (const auto openFlags : { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped,
+                 PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::LazyLoading,
+                 PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped | PasswordFileOpenFlags::LazyLoading }) {
+            for (const auto threadCount : { 1_st, 4_st }) {
+                const auto context = argsToString(flagsToString(options), " / ", flagsToString(openFlags), " / ", threadCount, " threads");
+                file.close();
+                file.clearEntries();
+                file.open(openFlags);
+                CPPUNIT_ASSERT_GREATER_MESSAGE(context, static_cast<std::size_t>(0x20000), file.size());
+                if (options & PasswordFileSaveFlags::Encryption) {
+                    // note: The padding might be valid by chance (see testKeyDerivation()) so the parser might fail first.
+                    file.setPassword("654321");
+                    try {
+                        file.load(threadCount);
+                        CPPUNIT_FAIL(argsToString(context, ": wrong password not detected"));
+                    } catch (const CryptoException &) {
+                    } catch (const ParsingException &) {
+                    }
+                    CPPUNIT_ASSERT_MESSAGE(context, !file.hasRootEntry());
+                    file.setPassword("123456");
+                }
+                file.load(threadCount);
+                const auto lazy = (openFlags & PasswordFileOpenFlags::LazyLoading) && (options & PasswordFileSaveFlags::SubtreeSizes);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, lazy, file.rootEntry()->hasDeferredChildren());
+
+                auto path = list<string>{ "testfile1", "large category", "account 19999" };
+                const auto *const account = file.rootEntry()->entryByPath(path);
+                CPPUNIT_ASSERT_MESSAGE(context, account);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, EntryType::Account, account->type());
+                const auto &fields = static_cast<const AccountEntry *>(account)->fields();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 2_st, fields.size());
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, "username"s, fields[0].name());
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, "user19999"s, fields[0].value());
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, argsToString(19999u * 2654435761u, '-', 19999u * 40503u), fields[1].value());
+                const auto *const otherCategory = static_cast<const NodeEntry *>(file.rootEntry()->children()[2]);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, "testcategory1"s, otherCategory->label());
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context + ": other category not parsed yet", lazy, otherCategory->hasDeferredChildren());
+                const auto stats = file.rootEntry()->computeStatistics();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 20007_st, stats.accountCount);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Tests reading only the header via PasswordFile::probe().
+ */
+void PasswordFileTests::testProbing()
+{
+    // probe testfiles which use version 3
+    auto header = PasswordFile::probe(testFilePath("testfile1.pwmgr"));
+    CPPUNIT_ASSERT_EQUAL(3u, header.version);
+    CPPUNIT_ASSERT_EQUAL("encryption, compression"s, flagsToString(header.saveOptions));
+    CPPUNIT_ASSERT(header.ivUsed);
+    CPPUNIT_ASSERT_EQUAL(0u, header.hashCount);
+    CPPUNIT_ASSERT_EQUAL(""s, header.extendedHeader);
+    CPPUNIT_ASSERT_EQUAL(169_st, static_cast<std::size_t>(header.fileSize));
+    CPPUNIT_ASSERT_EQUAL(25_st, static_cast<std::size_t>(header.payloadOffset));
+    CPPUNIT_ASSERT_EQUAL(144_st, static_cast<std::size_t>(header.payloadSize));
+    CPPUNIT_ASSERT_EQUAL(0xf1, static_cast<int>(header.iv[0]));
+    header = PasswordFile::probe(testFilePath("testfile2.pwmgr"));
+    CPPUNIT_ASSERT_EQUAL(3u, header.version);
+    CPPUNIT_ASSERT_EQUAL("compression"s, flagsToString(header.saveOptions));
+    CPPUNIT_ASSERT_EQUAL(9_st, static_cast<std::size_t>(header.payloadOffset));
+    CPPUNIT_ASSERT_EQUAL(49_st, static_cast<std::size_t>(header.payloadSize));
+
+    // probe file with extended header (big enough to exceed the first chunk read) and password hashing
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    file.extendedHeader().assign(1000, 'x');
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing);
+    const auto fileSize = file.size();
+    file.close();
+    file.open(PasswordFileOpenFlags::ReadOnly);
+    file.close();
+    header = file.probe();
+    CPPUNIT_ASSERT_MESSAGE("probing a closed file leaves it closed", !file.isOpen());
+    CPPUNIT_ASSERT_MESSAGE("probing does not alter the open options", file.openOptions() == PasswordFileOpenFlags::ReadOnly);
+    CPPUNIT_ASSERT_EQUAL(6u, header.version);
+    CPPUNIT_ASSERT_EQUAL("encryption, password hashing"s, flagsToString(header.saveOptions));
+    CPPUNIT_ASSERT(header.hashCount >= 1 && header.hashCount <= 100);
+    CPPUNIT_ASSERT_EQUAL(string(1000, 'x'), header.extendedHeader);
+    CPPUNIT_ASSERT_EQUAL(fileSize, static_cast<std::size_t>(header.fileSize));
+    CPPUNIT_ASSERT_EQUAL(4_st + 4 + 1 + 2 + 1000 + 4 + 16, static_cast<std::size_t>(header.payloadOffset));
+    CPPUNIT_ASSERT_EQUAL(header.fileSize - header.payloadOffset, header.payloadSize);
+
+    // probing does not prevent loading afterwards
+    file.clearEntries();
+    file.load();
+    CPPUNIT_ASSERT(file.rootEntry());
+    CPPUNIT_ASSERT_EQUAL("testfile1"s, file.rootEntry()->label());
+
+    // features are denoted by flags as of version 7 (and not implied by the version)
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::SubtreeSizes);
+    header = file.probe();
+    CPPUNIT_ASSERT_EQUAL(7u, header.version);
+    CPPUNIT_ASSERT_EQUAL("encryption, subtree sizes"s, flagsToString(header.saveOptions));
+    CPPUNIT_ASSERT_EQUAL(4_st + 4 + 1 + 2 + 1000 + 16, static_cast<std::size_t>(header.payloadOffset));
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing | PasswordFileSaveFlags::FieldShapes);
+    header = file.probe();
+    CPPUNIT_ASSERT_EQUAL(8u, header.version);
+    CPPUNIT_ASSERT_EQUAL("encryption, password hashing, field shapes"s, flagsToString(header.saveOptions));
+    file.clearEntries();
+    file.load(4);
+    CPPUNIT_ASSERT_EQUAL("testfile1"s, file.rootEntry()->label());
+
+    // invalid and truncated headers
+    const auto invalidFile = workingCopyPath("testfile2.pwmgr");
+    file.setPath(invalidFile);
+    file.open();
+    file.fileStream().seekp(0);
+    file.fileStream().write("mapw\x0a\0\0\0", 8);
+    file.fileStream().flush();
+    CPPUNIT_ASSERT_THROW(file.probe(), ParsingException);
+    file.close();
+    std::filesystem::resize_file(invalidFile, 6);
+    CPPUNIT_ASSERT_THROW(PasswordFile::probe(invalidFile), ParsingException);
+    file.open();
+    file.fileStream().seekp(0);
+    file.fileStream().write("foo!", 4);
+    file.fileStream().flush();
+    CPPUNIT_ASSERT_THROW(file.probe(), ParsingException);
+}
+
+/*!
+ * \brief Tests whether derived keys are cached and re-used when saving and loading again.
+ */
+void PasswordFileTests::testKeyCaching()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    CPPUNIT_ASSERT_EQUAL(1_st, file.keyCache().size());
+
+    // saving with password hashing picks a random hash count first and re-uses it afterwards
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing);
+    const auto hashCount = file.probe().hashCount;
+    CPPUNIT_ASSERT(hashCount >= 1 && hashCount <= 100);
+    CPPUNIT_ASSERT_EQUAL(2_st, file.keyCache().size());
+    CPPUNIT_ASSERT_EQUAL(hashCount, file.keyCache().mostRecentHashCount());
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing);
+    CPPUNIT_ASSERT_EQUAL(hashCount, file.probe().hashCount);
+    CPPUNIT_ASSERT_EQUAL(2_st, file.keyCache().size());
+
+    // loading again uses the cached key
+    file.clearEntries();
+    file.load();
+    CPPUNIT_ASSERT(file.rootEntry());
+    CPPUNIT_ASSERT_EQUAL(2_st, file.keyCache().size());
+
+    // setting the same password keeps the cache; setting a different one clears it
+    file.setPassword("123456");
+    CPPUNIT_ASSERT_EQUAL(2_st, file.keyCache().size());
+    file.setPassword("654321");
+    CPPUNIT_ASSERT(file.keyCache().isEmpty());
+    file.clearEntries();
+    CPPUNIT_ASSERT_THROW(file.load(), CryptoException);
+    file.setPassword("123456");
+    file.load();
+    CPPUNIT_ASSERT(file.rootEntry());
+
+    // copies start with an empty cache
+    const PasswordFile copy(file);
+    CPPUNIT_ASSERT(copy.keyCache().isEmpty());
+    file.clearPassword();
+    CPPUNIT_ASSERT(file.keyCache().isEmpty());
+}
+
+/*!
+ * \brief Tests whether the size computed by PasswordFile::serializedSize() matches the size of the file written by save().
+ */
+void PasswordFileTests::testSerializedSize()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    file.encryptedExtendedHeader() = "encrypted extended header";
+    for (const auto options : { PasswordFileSaveFlags::None, PasswordFileSaveFlags::Encryption,
+             PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing, PasswordFileSaveFlags::SubtreeSizes,
+             PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::FieldShapes | PasswordFileSaveFlags::CacheSubtrees }) {
+        const auto expectedSize = file.serializedSize(options);
+        file.save(options);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(flagsToString(options), static_cast<std::uint64_t>(file.size()), expectedSize);
+        CPPUNIT_ASSERT_EQUAL(expectedSize, file.serializedSize(options));
+    }
+
+    // fields modified directly within the vector after saving are taken into account when saving again
+    for (const auto options : { PasswordFileSaveFlags::Default,
+             PasswordFileSaveFlags::Default | PasswordFileSaveFlags::SubtreeSizes | PasswordFileSaveFlags::CacheSubtrees }) {
+        auto *const account = static_cast<AccountEntry *>(file.rootEntry()->children()[0]);
+        file.save(options);
+        account->fields().emplace_back(account, "added", flagsToString(options));
+        file.save(options);
+        PasswordFile loadedFile(testfile, "123456");
+        loadedFile.load();
+        const auto &fields = static_cast<const AccountEntry *>(loadedFile.rootEntry()->children()[0])->fields();
+        CPPUNIT_ASSERT_EQUAL(flagsToString(options), fields.back().value());
+    }
+
+    // the compressed size can only be estimated
+    CPPUNIT_ASSERT_EQUAL(file.serializedSize(PasswordFileSaveFlags::None) + 8, file.serializedSize(PasswordFileSaveFlags::Compression));
+    file.clearEntries();
+    CPPUNIT_ASSERT_THROW(file.serializedSize(), runtime_error);
+}
+
+/*!
+ * \brief Tests whether save() replaces the file without leaving temporary files behind and keeps its properties.
+ */
+void PasswordFileTests::testReplacingFile()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    const auto directory = filesystem::path(testfile).parent_path();
+    const auto countFiles = [&directory] {
+        return static_cast<std::size_t>(std::distance(filesystem::directory_iterator(directory), filesystem::directory_iterator()));
+    };
+    const auto loadLabel = [](const string &path) {
+        PasswordFile file(path, "123456");
+        file.load();
+        return file.rootEntry()->label();
+    };
+    const auto fileCount = countFiles();
+
+    // the permissions and the open mode are kept
+    const auto permissions = filesystem::perms::owner_read | filesystem::perms::owner_write | filesystem::perms::group_read;
+    filesystem::permissions(testfile, permissions);
+    PasswordFile file(testfile, "123456");
+    file.open(PasswordFileOpenFlags::ReadOnly);
+    file.load();
+    file.rootEntry()->setLabel("replaced");
+    file.save(PasswordFileSaveFlags::Encryption);
+    CPPUNIT_ASSERT(file.isOpen());
+    CPPUNIT_ASSERT_THROW(file.fileStream().write("x", 1), ios_base::failure);
+    CPPUNIT_ASSERT_MESSAGE("permissions kept", filesystem::status(testfile).permissions() == permissions);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("temporary file removed", fileCount, countFiles());
+    CPPUNIT_ASSERT_EQUAL("replaced"s, loadLabel(testfile));
+
+#ifdef PLATFORM_UNIX
+    // symbolic links are kept and the file they point to is replaced
+    const auto symbolicLink = testfile + ".symlink";
+    filesystem::remove(symbolicLink);
+    filesystem::create_symlink(testfile, symbolicLink);
+    file.setPath(symbolicLink);
+    file.rootEntry()->setLabel("saved via symbolic link");
+    file.save(PasswordFileSaveFlags::Encryption);
+    CPPUNIT_ASSERT(filesystem::is_symlink(symbolicLink));
+    CPPUNIT_ASSERT_EQUAL("saved via symbolic link"s, loadLabel(testfile));
+    filesystem::remove(symbolicLink);
+
+    // hard links are kept
+    const auto hardLink = testfile + ".hardlink";
+    filesystem::remove(hardLink);
+    filesystem::create_hard_link(testfile, hardLink);
+    file.setPath(testfile);
+    file.rootEntry()->setLabel("saved with hard link");
+    file.save(PasswordFileSaveFlags::Encryption);
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::uintmax_t>(2), filesystem::hard_link_count(testfile));
+    CPPUNIT_ASSERT_EQUAL("saved with hard link"s, loadLabel(hardLink));
+    filesystem::remove(hardLink);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("temporary files removed", fileCount, countFiles());
+#endif
+}
+
+/*!
+ * \brief Tests saving asynchronously.
+ */
+void PasswordFileTests::testAsyncSaving()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+
+    // modifying the entries after saveAsync() returned does not affect the saved snapshot
+    auto future = file.saveAsync(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::Compression);
+    new AccountEntry("unsaved account", file.rootEntry());
+    future.get();
+    PasswordFile savedFile(testfile, "123456");
+    savedFile.load();
+    CPPUNIT_ASSERT_EQUAL(4_st, savedFile.rootEntry()->children().size());
+    CPPUNIT_ASSERT_EQUAL("encryption, compression"s, flagsToString(savedFile.saveOptions()));
+
+    // the file is opened again after it has been replaced by a background save
+    CPPUNIT_ASSERT(file.isOpen());
+    file.saveAsync(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::SubtreeSizes).get();
+    CPPUNIT_ASSERT_EQUAL("encryption, subtree sizes"s, flagsToString(file.probe().saveOptions));
+    CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(filesystem::file_size(testfile)), file.size());
+
+    // back-to-back saves are coalesced so the most recent snapshot is saved eventually
+    auto futures = std::vector<std::shared_future<void>>();
+    for (auto i = 0; i != 5; ++i) {
+        file.rootEntry()->setLabel(argsToString("root ", i));
+        futures.emplace_back(file.saveAsync(PasswordFileSaveFlags::Encryption));
+    }
+    file.waitForAsyncSave();
+    for (const auto &pendingFuture : futures) {
+        CPPUNIT_ASSERT(pendingFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        pendingFuture.get();
+    }
+    savedFile.close(); // the file has been replaced so it needs to be opened again
+    savedFile.clearEntries();
+    savedFile.load();
+    CPPUNIT_ASSERT_EQUAL("root 4"s, savedFile.rootEntry()->label());
+    CPPUNIT_ASSERT_EQUAL(5_st, savedFile.rootEntry()->children().size());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("async saves don't affect the version of the instance", 3u, file.version());
+
+    // the most recently derived key is passed to the snapshot
+    file.save(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing);
+    const auto hashCount = file.probe().hashCount;
+    file.saveAsync(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing).get();
+    CPPUNIT_ASSERT_EQUAL(hashCount, PasswordFile::probe(testfile).hashCount);
+
+    // errors are reported via the future
+    file.setPath(workingCopyPath("testfile1.pwmgr") + "-non-existing-dir/file.pwmgr");
+    future = file.saveAsync();
+    CPPUNIT_ASSERT_THROW(future.get(), std::ios_base::failure);
+    file.clearEntries();
+    CPPUNIT_ASSERT_THROW(file.saveAsync(), runtime_error);
+}
+
+/*!
+ * \brief Tests saving and loading with the different compression codecs and levels.
+ * \remarks Codecs not supported by the build are only tested for being rejected.
+ */
+void PasswordFileTests::testCompressionCodecs()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    CPPUNIT_ASSERT_EQUAL(CompressionCodec::Zlib, file.compressionCodec());
+
+    // add accounts so the contents exceed the buffers of the compression stages
+    auto *const category = new NodeEntry("large category", file.rootEntry());
+    for (auto i = 0u; i != 5000u; ++i) {
+        auto *const account = new AccountEntry(argsToString("account ", i), category);
+        account->fields().emplace_back(account, "password", argsToString(i * 2654435761u, '-', i * 40503u));
+    }
+
+    for (const auto codec : { CompressionCodec::Zlib, CompressionCodec::Zstd, CompressionCodec::Lz4 }) {
+        file.setCompressionCodec(codec);
+        file.setCompressionLevel(std::nullopt);
+        if (!isCompressionCodecSupported(codec)) {
+            CPPUNIT_ASSERT_THROW_MESSAGE(compressionCodecName(codec), file.save(PasswordFileSaveFlags::Compression), runtime_error);
+            // the codec is checked before anything is written
+            const auto header = PasswordFile::probe(testfile);
+            file.open();
+            CPPUNIT_ASSERT_THROW_MESSAGE(compressionCodecName(codec), file.write(PasswordFileSaveFlags::Compression), runtime_error);
+            file.close();
+            CPPUNIT_ASSERT_EQUAL(header.version, PasswordFile::probe(testfile).version);
+            CPPUNIT_ASSERT_EQUAL(header.payloadOffset, PasswordFile::probe(testfile).payloadOffset);
+            continue;
+        }
+        for (const auto level : { std::optional<int>(), std::optional<int>(1), std::optional<int>(9) }) {
+            file.setCompressionLevel(level);
+            for (const auto options : { PasswordFileSaveFlags::Default, PasswordFileSaveFlags::Compression }) {
+                const auto context = argsToString(compressionCodecName(codec), " / level ", level.value_or(-1), " / ", flagsToString(options));
+                file.save(options);
+                const auto header = file.probe();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, codec == CompressionCodec::Zlib ? file.mininumVersion(options) : 9u, header.version);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, codec, header.compressionCodec);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, static_cast<std::uintmax_t>(header.fileSize), filesystem::file_size(testfile));
+
+                for (const auto openFlags :
+                    { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped }) {
+                    PasswordFile loadedFile(testfile, "123456");
+                    loadedFile.open(openFlags);
+                    loadedFile.load();
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(context, header.version, loadedFile.version());
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(context, codec, loadedFile.compressionCodec());
+                    auto path = list<string>{ "testfile1", "large category", "account 4999" };
+                    const auto *const account = loadedFile.rootEntry()->entryByPath(path);
+                    CPPUNIT_ASSERT_MESSAGE(context, account);
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(context, argsToString(4999u * 2654435761u, '-', 4999u * 40503u),
+                        static_cast<const AccountEntry *>(account)->fields().front().value());
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 5007_st, loadedFile.rootEntry()->computeStatistics().accountCount);
+                }
+            }
+        }
+    }
+
+    // the codec does not affect the version when compression is not used
+    file.setCompressionCodec(CompressionCodec::Lz4);
+    CPPUNIT_ASSERT_EQUAL(9u, file.mininumVersion(PasswordFileSaveFlags::Compression));
+    CPPUNIT_ASSERT_EQUAL(6u, file.mininumVersion(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing));
+}
+
+/*!
+ * \brief Tests saving and loading with PasswordFileSaveFlags::ChunkedCompression.
+ */
+void PasswordFileTests::testChunkedCompression()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+
+    // add accounts so the contents exceed multiple blocks
+    auto *const category = new NodeEntry("large category", file.rootEntry());
+    for (auto i = 0u; i != 60000u; ++i) {
+        auto *const account = new AccountEntry(argsToString("account ", i), category);
+        account->fields().emplace_back(account, "password", argsToString(i * 2654435761u, '-', i * 40503u));
+    }
+    CPPUNIT_ASSERT_GREATER(ChunkedCompressingStreamBuffer::blockSize * 2, static_cast<std::size_t>(file.serializedSize(PasswordFileSaveFlags::None)));
+
+    const auto chunked = PasswordFileSaveFlags::Compression | PasswordFileSaveFlags::ChunkedCompression;
+    for (const auto codec : { CompressionCodec::Zlib, CompressionCodec::Zstd, CompressionCodec::Lz4 }) {
+        if (!isCompressionCodecSupported(codec)) {
+            continue;
+        }
+        file.setCompressionCodec(codec);
+        for (const auto options : { chunked, chunked | PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing }) {
+            for (const auto saveThreadCount : { 1_st, 3_st }) {
+                const auto context = argsToString(compressionCodecName(codec), " / ", flagsToString(options), " / ", saveThreadCount, " threads");
+                file.save(options, saveThreadCount);
+                const auto header = file.probe();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 10u, header.version);
+                CPPUNIT_ASSERT_MESSAGE(context, header.saveOptions & PasswordFileSaveFlags::ChunkedCompression);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, codec, header.compressionCodec);
+
+                for (const auto openFlags :
+                    { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped }) {
+                    for (const auto loadThreadCount : { 1_st, 4_st }) {
+                        PasswordFile loadedFile(testfile, "123456");
+                        loadedFile.open(openFlags);
+                        loadedFile.load(loadThreadCount);
+                        CPPUNIT_ASSERT_MESSAGE(context, loadedFile.saveOptions() & PasswordFileSaveFlags::ChunkedCompression);
+                        auto path = list<string>{ "testfile1", "large category", "account 59999" };
+                        const auto *const account = loadedFile.rootEntry()->entryByPath(path);
+                        CPPUNIT_ASSERT_MESSAGE(context, account);
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, argsToString(59999u * 2654435761u, '-', 59999u * 40503u),
+                            static_cast<const AccountEntry *>(account)->fields().front().value());
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 60007_st, loadedFile.rootEntry()->computeStatistics().accountCount);
+                    }
+                }
+            }
+        }
+    }
+
+    // chunked compression has no effect without compression
+    CPPUNIT_ASSERT_EQUAL(6u, file.mininumVersion(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing
+                                 | PasswordFileSaveFlags::ChunkedCompression));
+
+    // corrupted block index
+    file.setCompressionCodec(CompressionCodec::Zlib);
+    file.save(chunked);
+    const auto payloadOffset = static_cast<streamoff>(file.probe().payloadOffset);
+    file.close();
+    file.open();
+    file.fileStream().seekp(payloadOffset + 8);
+    file.fileStream().write("\0\0\0\0", 4);
+    file.close();
+    file.clearEntries();
+    CPPUNIT_ASSERT_THROW(file.load(), ParsingException);
+}
+
+/*!
+ * \brief Tests saving and loading with the authenticated ciphers.
+ */
+void PasswordFileTests::testAuthenticatedEncryption()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    CPPUNIT_ASSERT_EQUAL(EncryptionCipher::Aes256Cbc, file.encryptionCipher());
+
+    // add accounts so the contents exceed the buffers of the decryption stage
+    auto *const category = new NodeEntry("large category", file.rootEntry());
+    for (auto i = 0u; i != 5000u; ++i) {
+        auto *const account = new AccountEntry(argsToString("account ", i), category);
+        account->fields().emplace_back(account, "password", argsToString(i * 2654435761u, '-', i * 40503u));
+    }
+
+    const auto preferredCipher = preferredAuthenticatedCipher();
+    CPPUNIT_ASSERT(isAuthenticatedCipher(preferredCipher));
+    for (const auto cipher : { EncryptionCipher::Aes256Gcm, EncryptionCipher::ChaCha20Poly1305 }) {
+        file.setEncryptionCipher(cipher);
+        for (const auto options : { PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing, PasswordFileSaveFlags::Default }) {
+            const auto context = argsToString(encryptionCipherName(cipher), " / ", flagsToString(options));
+            const auto expectedSize = file.serializedSize(options);
+            file.save(options);
+            const auto header = file.probe();
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 11u, header.version);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, cipher, header.encryptionCipher);
+            if (!(options & PasswordFileSaveFlags::Compression)) {
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, static_cast<std::size_t>(expectedSize), file.size());
+            }
+
+            for (const auto openFlags : { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped,
+                     PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::LazyLoading }) {
+                PasswordFile loadedFile(testfile, "123456");
+                loadedFile.open(openFlags);
+                loadedFile.load();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, cipher, loadedFile.encryptionCipher());
+                auto path = list<string>{ "testfile1", "large category", "account 4999" };
+                const auto *const account = loadedFile.rootEntry()->entryByPath(path);
+                CPPUNIT_ASSERT_MESSAGE(context, account);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, argsToString(4999u * 2654435761u, '-', 4999u * 40503u),
+                    static_cast<const AccountEntry *>(account)->fields().front().value());
+
+                // a wrong password is detected via the authentication tag
+                PasswordFile fileWithWrongPassword(testfile, "654321");
+                fileWithWrongPassword.open(openFlags);
+                CPPUNIT_ASSERT_THROW_MESSAGE(context, fileWithWrongPassword.load(), CryptoException);
+            }
+        }
+    }
+
+    // the cipher does not affect the version when encryption is not used
+    CPPUNIT_ASSERT_EQUAL(11u, file.mininumVersion(PasswordFileSaveFlags::Encryption));
+    CPPUNIT_ASSERT_EQUAL(6u, file.mininumVersion(PasswordFileSaveFlags::Compression | PasswordFileSaveFlags::PasswordHashing));
+    file.setEncryptionCipher(EncryptionCipher::Aes256Cbc);
+    CPPUNIT_ASSERT_EQUAL(6u, file.mininumVersion(PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing));
+
+    // modified data is detected before anything is parsed
+    file.setEncryptionCipher(EncryptionCipher::ChaCha20Poly1305);
+    file.save(PasswordFileSaveFlags::Encryption);
+    const auto fileSize = static_cast<streamoff>(file.size());
+    file.close();
+    file.open();
+    file.fileStream().seekg(fileSize - 100);
+    auto byte = static_cast<char>(file.fileStream().get());
+    file.fileStream().seekp(fileSize - 100);
+    file.fileStream().put(static_cast<char>(byte ^ 0x01));
+    file.close();
+    file.clearEntries();
+    CPPUNIT_ASSERT_THROW(file.load(), CryptoException);
+    CPPUNIT_ASSERT(!file.hasRootEntry());
+}
+
+/*!
+ * \brief Tests saving and loading with PasswordFileSaveFlags::SegmentedEncryption.
+ */
+void PasswordFileTests::testSegmentedEncryption()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+
+    // add accounts so the contents exceed multiple segments
+    auto *const category = new NodeEntry("large category", file.rootEntry());
+    for (auto i = 0u; i != 20000u; ++i) {
+        auto *const account = new AccountEntry(argsToString("account ", i), category);
+        account->fields().emplace_back(account, "password", argsToString(i * 2654435761u, '-', i * 40503u));
+    }
+    CPPUNIT_ASSERT_GREATER(
+        SegmentedEncryptingStreamBuffer::segmentSize * 8, static_cast<std::size_t>(file.serializedSize(PasswordFileSaveFlags::None)));
+
+    // segmented encryption has no effect without an authenticated cipher
+    const auto segmented = PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::SegmentedEncryption;
+    CPPUNIT_ASSERT_EQUAL(3u, file.mininumVersion(segmented));
+
+    for (const auto cipher : { EncryptionCipher::Aes256Gcm, EncryptionCipher::ChaCha20Poly1305 }) {
+        file.setEncryptionCipher(cipher);
+        for (const auto options : { segmented, segmented | PasswordFileSaveFlags::Compression | PasswordFileSaveFlags::PasswordHashing }) {
+            for (const auto saveThreadCount : { 1_st, 3_st }) {
+                const auto context = argsToString(encryptionCipherName(cipher), " / ", flagsToString(options), " / ", saveThreadCount, " threads");
+                const auto expectedSize = file.serializedSize(options);
+                file.save(options, saveThreadCount);
+                const auto header = file.probe();
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 12u, header.version);
+                CPPUNIT_ASSERT_MESSAGE(context, header.saveOptions & PasswordFileSaveFlags::SegmentedEncryption);
+                if (!(options & PasswordFileSaveFlags::Compression)) {
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(context, static_cast<std::size_t>(expectedSize), file.size());
+                }
+
+                for (const auto openFlags :
+                    { PasswordFileOpenFlags::ReadOnly, PasswordFileOpenFlags::ReadOnly | PasswordFileOpenFlags::MemoryMapped }) {
+                    for (const auto loadThreadCount : { 1_st, 4_st }) {
+                        PasswordFile loadedFile(testfile, "123456");
+                        loadedFile.open(openFlags);
+                        loadedFile.load(loadThreadCount);
+                        CPPUNIT_ASSERT_MESSAGE(context, loadedFile.saveOptions() & PasswordFileSaveFlags::SegmentedEncryption);
+                        auto path = list<string>{ "testfile1", "large category", "account 19999" };
+                        const auto *const account = loadedFile.rootEntry()->entryByPath(path);
+                        CPPUNIT_ASSERT_MESSAGE(context, account);
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, argsToString(19999u * 2654435761u, '-', 19999u * 40503u),
+                            static_cast<const AccountEntry *>(account)->fields().front().value());
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 20007_st, loadedFile.rootEntry()->computeStatistics().accountCount);
+                    }
+                }
+
+                PasswordFile fileWithWrongPassword(testfile, "654321");
+                CPPUNIT_ASSERT_THROW_MESSAGE(context, fileWithWrongPassword.load(), CryptoException);
+            }
+        }
+    }
+
+    // a modified segment is detected
+    file.setEncryptionCipher(EncryptionCipher::Aes256Gcm);
+    file.save(segmented);
+    const auto payloadOffset = static_cast<streamoff>(file.probe().payloadOffset);
+    const auto storedSegmentSize = static_cast<streamoff>(SegmentedEncryptingStreamBuffer::segmentSize + authenticationTagSize);
+    file.close();
+    file.open();
+    file.fileStream().seekg(payloadOffset + storedSegmentSize * 2 + 10);
+    const auto byte = static_cast<char>(file.fileStream().get());
+    file.fileStream().seekp(payloadOffset + storedSegmentSize * 2 + 10);
+    file.fileStream().put(static_cast<char>(byte ^ 0x01));
+    file.close();
+    PasswordFile modifiedFile(testfile, "123456");
+    CPPUNIT_ASSERT_THROW(modifiedFile.load(), CryptoException);
+
+    // truncating the data at a segment boundary is detected
+    file.save(segmented);
+    const auto fileSize = static_cast<streamoff>(file.size());
+    file.close();
+    filesystem::resize_file(testfile, static_cast<std::uintmax_t>(fileSize - (fileSize - payloadOffset) % storedSegmentSize));
+    PasswordFile truncatedFile(testfile, "123456");
+    CPPUNIT_ASSERT_THROW(truncatedFile.load(), CryptoException);
+    CPPUNIT_ASSERT(!truncatedFile.hasRootEntry());
+
+    // data filling whole segments is followed by an empty final segment
+    const unsigned char key[32] = { 1, 2, 3 }, iv[12] = { 4, 5, 6 };
+    for (const auto dataSize : { 0_st, SegmentedEncryptingStreamBuffer::segmentSize, SegmentedEncryptingStreamBuffer::segmentSize * 5 + 1 }) {
+        for (const auto threadCount : { 1_st, 3_st }) {
+            const auto context = argsToString(dataSize, " bytes / ", threadCount, " threads");
+            auto data = string(dataSize, '\0');
+            for (auto i = 0_st; i != dataSize; ++i) {
+                data[i] = static_cast<char>(i * 7);
+            }
+            auto encryptedData = stringbuf();
+            auto encryptingBuffer = SegmentedEncryptingStreamBuffer(&encryptedData, key, iv, EncryptionCipher::Aes256Gcm, threadCount);
+            encryptingBuffer.sputn(data.data(), static_cast<std::streamsize>(data.size()));
+            encryptingBuffer.finish();
+            const auto segmentCount = dataSize / SegmentedEncryptingStreamBuffer::segmentSize + 1;
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, dataSize + segmentCount * authenticationTagSize, encryptedData.str().size());
+
+            auto decryptingBuffer = SegmentedDecryptingStreamBuffer(&encryptedData, key, iv, EncryptionCipher::Aes256Gcm, threadCount);
+            auto decryptedData = string(dataSize + 1, '\0');
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, static_cast<std::streamsize>(dataSize),
+                decryptingBuffer.sgetn(decryptedData.data(), static_cast<std::streamsize>(decryptedData.size())));
+            decryptedData.resize(dataSize);
+            CPPUNIT_ASSERT_MESSAGE(context, data == decryptedData);
+            CPPUNIT_ASSERT_NO_THROW_MESSAGE(context, decryptingBuffer.finish());
+        }
+    }
+}
+
+/*!
+ * \brief Tests saving and loading with salted key derivation functions.
+ */
+void PasswordFileTests::testKeyDerivation()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    CPPUNIT_ASSERT(file.keyDerivation() == KeyDerivationParameters());
+
+    // the function does not affect the version without password hashing
+    const auto hashed = PasswordFileSaveFlags::Encryption | PasswordFileSaveFlags::PasswordHashing;
+    file.setKeyDerivation(KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1000));
+    CPPUNIT_ASSERT_EQUAL(13u, file.mininumVersion(hashed));
+    CPPUNIT_ASSERT_EQUAL(3u, file.mininumVersion(PasswordFileSaveFlags::Encryption));
+
+    for (const auto &parameters : { KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1000, 0, 4),
+             KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1024, 3) }) {
+        const auto context = keyDerivationFunctionName(parameters.function);
+        file.setKeyDerivation(parameters);
+        for (const auto options : { hashed, PasswordFileSaveFlags::Default }) {
+            const auto expectedSize = file.serializedSize(options);
+            file.save(options, 2);
+            const auto header = file.probe();
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 13u, header.version);
+            CPPUNIT_ASSERT_MESSAGE(context, parameters == header.keyDerivation);
+            if (!(options & PasswordFileSaveFlags::Compression)) {
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(context, static_cast<std::size_t>(expectedSize), file.size());
+            }
+
+            PasswordFile loadedFile(testfile, "123456");
+            loadedFile.load(2);
+            CPPUNIT_ASSERT_MESSAGE(context, parameters == loadedFile.keyDerivation());
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 7_st, loadedFile.rootEntry()->computeStatistics().accountCount);
+
+            // saving again re-uses the parameters and therefore the cached key
+            loadedFile.save(options);
+            CPPUNIT_ASSERT_MESSAGE(context, parameters == loadedFile.probe().keyDerivation);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(context, 1_st, loadedFile.keyCache().size());
+
+            // note: With AES-256-CBC a wrong key is only detected via the padding of the last block which is valid
+            //       by chance in about one of 256 cases so the parser might fail first.
+            PasswordFile fileWithWrongPassword(testfile, "654321");
+            try {
+                fileWithWrongPassword.load();
+                CPPUNIT_FAIL(argsToString(context, ": wrong password not detected"));
+            } catch (const CryptoException &) {
+            } catch (const ParsingException &) {
+            }
+        }
+    }
+
+    // unsupported or invalid parameters are rejected when saving
+    const auto directory = filesystem::path(testfile).parent_path();
+    const auto countFiles = [&directory] {
+        return static_cast<std::size_t>(std::distance(filesystem::directory_iterator(directory), filesystem::directory_iterator()));
+    };
+    const auto fileCount = countFiles();
+    if (!isKeyDerivationFunctionSupported(KeyDerivationFunction::Argon2id)) {
+        file.setKeyDerivation(KeyDerivationParameters::create(KeyDerivationFunction::Argon2id, 1, 1024));
+        CPPUNIT_ASSERT_THROW(file.save(hashed), CryptoException);
+    }
+    file.setKeyDerivation(KeyDerivationParameters::create(KeyDerivationFunction::Scrypt, 0, 1000));
+    CPPUNIT_ASSERT_THROW(file.save(hashed), CryptoException);
+
+    // the previously saved file is left intact when saving fails
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("temporary file removed", fileCount, countFiles());
+    PasswordFile intactFile(testfile, "123456");
+    intactFile.load();
+    CPPUNIT_ASSERT_EQUAL(file.rootEntry()->label(), intactFile.rootEntry()->label());
+
+    // invalid parameters are also rejected before anything is written when writing in place
+    const auto sizeBeforeWriting = filesystem::file_size(testfile);
+    file.open();
+    CPPUNIT_ASSERT_THROW(file.write(hashed), CryptoException);
+    file.close();
+    CPPUNIT_ASSERT_EQUAL(sizeBeforeWriting, filesystem::file_size(testfile));
+    PasswordFile stillIntactFile(testfile, "123456");
+    stillIntactFile.load();
+    CPPUNIT_ASSERT_EQUAL(file.rootEntry()->label(), stillIntactFile.rootEntry()->label());
+
+    // parameters exceeding the maxima are rejected when reading the header (before deriving the key)
+    file.setKeyDerivation(KeyDerivationParameters::create(KeyDerivationFunction::Pbkdf2HmacSha256, 1000, 0, 4));
+    file.save(hashed);
+    const auto parallelismOffset = static_cast<streamoff>(file.probe().payloadOffset - encryptionCipherIvSize(file.encryptionCipher())
+        - KeyDerivationParameters::saltSize - 4);
+    file.close();
+    file.open();
+    file.fileStream().seekp(parallelismOffset);
+    file.fileStream().write("\0\0\x10\0", 4);
+    file.close();
+    CPPUNIT_ASSERT_THROW(file.probe(), ParsingException);
+    PasswordFile fileWithTooManyLanes(testfile, "123456");
+    CPPUNIT_ASSERT_THROW(fileWithTooManyLanes.load(), ParsingException);
+
+    // the legacy function is still used by default
+    file.setKeyDerivation(KeyDerivationParameters());
+    file.save(hashed);
+    CPPUNIT_ASSERT_EQUAL(6u, file.probe().version);
+    PasswordFile loadedFile(testfile, "123456");
+    loadedFile.load();
+    CPPUNIT_ASSERT_EQUAL(KeyDerivationFunction::Sha256Iterations, loadedFile.keyDerivation().function);
+}
+
+/*!
+ * \brief Tests saving with PasswordFileSaveFlags::CalibrateKeyDerivation.
+ */
+void PasswordFileTests::testKeyDerivationCalibration()
+{
+    const auto testfile = workingCopyPath("testfile1.pwmgr");
+    PasswordFile file(testfile, "123456");
+    file.load();
+    CPPUNIT_ASSERT_EQUAL(std::chrono::milliseconds::rep(250), file.keyDerivationDuration().count());
+    file.setKeyDerivationDuration(std::chrono::milliseconds(40));
+
+    // the cost parameters of the legacy function are calibrated as well
+    const auto options = PasswordFileSaveFlags::Default | PasswordFileSaveFlags::CalibrateKeyDerivation;
+    file.save(options);
+    auto header = file.probe();
+    CPPUNIT_ASSERT_EQUAL(6u, header.version);
+    CPPUNIT_ASSERT_EQUAL(file.keyDerivation().iterations, header.hashCount);
+    CPPUNIT_ASSERT_GREATEREQUAL(1u, header.hashCount);
+
+    // only the cost parameters of the function are calibrated
+    auto parameters = KeyDerivationParameters();
+    parameters.function = KeyDerivationFunction::Scrypt;
+    parameters.parallelism = 2;
+    file.setKeyDerivation(parameters);
+    file.save(options, 2);
+    header = file.probe();
+    CPPUNIT_ASSERT_EQUAL(13u, header.version);
+    CPPUNIT_ASSERT(header.keyDerivation == file.keyDerivation());
+    CPPUNIT_ASSERT_EQUAL(KeyDerivationFunction::Scrypt, header.keyDerivation.function);
+    CPPUNIT_ASSERT_EQUAL(2u, header.keyDerivation.parallelism);
+    CPPUNIT_ASSERT_GREATEREQUAL(2u, header.keyDerivation.memoryCost);
+    CPPUNIT_ASSERT(header.keyDerivation.salt != parameters.salt);
+
+    // the chosen parameters are reported
+    const auto summary = file.summary(PasswordFileSaveFlags::Default);
+    CPPUNIT_ASSERT(summary.find(argsToString("<tr><td>Key derivation:</td><td>scrypt (", header.keyDerivation.memoryCost, " KiB, 2 lanes)"))
+        != std::string::npos);
+
+    PasswordFile loadedFile(testfile, "123456");
+    loadedFile.load();
+    CPPUNIT_ASSERT(header.keyDerivation == loadedFile.keyDerivation());
+}
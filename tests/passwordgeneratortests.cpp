@@ -0,0 +1,115 @@
+#include "../util/passwordgenerator.h"
+
+#include "./utils.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+using namespace Util;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The PasswordGeneratorTests class tests the Util::PasswordGenerator class.
+ */
+class PasswordGeneratorTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(PasswordGeneratorTests);
+    CPPUNIT_TEST(testAlphabet);
+    CPPUNIT_TEST(testGeneration);
+    CPPUNIT_TEST(testRequiredClasses);
+    CPPUNIT_TEST(testInvalidConfiguration);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testAlphabet();
+    void testGeneration();
+    void testRequiredClasses();
+    void testInvalidConfiguration();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PasswordGeneratorTests);
+
+void PasswordGeneratorTests::setUp()
+{
+}
+
+void PasswordGeneratorTests::tearDown()
+{
+}
+
+void PasswordGeneratorTests::testAlphabet()
+{
+    auto generator = PasswordGenerator();
+    CPPUNIT_ASSERT_EQUAL(94_st, generator.alphabet().size());
+    generator.setCharacterClasses(PasswordCharacterClasses::Digits | PasswordCharacterClasses::UpperCase);
+    CPPUNIT_ASSERT_EQUAL("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"s, generator.alphabet());
+    generator.setExcludingAmbiguousCharacters(true);
+    generator.setExcludedCharacters("XYZ");
+    CPPUNIT_ASSERT_EQUAL("ABCDEFGHJKLMNPQRSTUVW23456789"s, generator.alphabet());
+}
+
+void PasswordGeneratorTests::testGeneration()
+{
+    auto generator = PasswordGenerator(16, PasswordCharacterClasses::LowerCase | PasswordCharacterClasses::Digits);
+    generator.setExcludingAmbiguousCharacters(true);
+    const auto alphabet = generator.alphabet();
+    const auto passwords = generator.generate(5000);
+    CPPUNIT_ASSERT_EQUAL(5000_st, passwords.size());
+    auto counts = std::map<char, std::size_t>();
+    for (const auto &password : passwords) {
+        CPPUNIT_ASSERT_EQUAL(16_st, password.size());
+        for (const auto character : password) {
+            CPPUNIT_ASSERT_MESSAGE(password, alphabet.find(character) != std::string::npos);
+            ++counts[character];
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("passwords are distinct", passwords.size(), std::set<std::string>(passwords.begin(), passwords.end()).size());
+
+    // all characters are used about equally often (the expected count per character is 80000 / 32 = 2500)
+    CPPUNIT_ASSERT_EQUAL(alphabet.size(), counts.size());
+    for (const auto &[character, count] : counts) {
+        CPPUNIT_ASSERT_GREATER_MESSAGE(std::string(1, character), 2000_st, count);
+        CPPUNIT_ASSERT_LESS_MESSAGE(std::string(1, character), 3000_st, count);
+    }
+
+    CPPUNIT_ASSERT_EQUAL(16_st, generator.generate().size());
+    CPPUNIT_ASSERT(generator.generate(0).empty());
+}
+
+void PasswordGeneratorTests::testRequiredClasses()
+{
+    auto generator = PasswordGenerator(4);
+    generator.setRequiredClasses(PasswordCharacterClasses::All);
+    for (const auto &password : generator.generate(2000)) {
+        CPPUNIT_ASSERT_MESSAGE(password, std::any_of(password.begin(), password.end(), [](char c) { return c >= 'a' && c <= 'z'; }));
+        CPPUNIT_ASSERT_MESSAGE(password, std::any_of(password.begin(), password.end(), [](char c) { return c >= 'A' && c <= 'Z'; }));
+        CPPUNIT_ASSERT_MESSAGE(password, std::any_of(password.begin(), password.end(), [](char c) { return c >= '0' && c <= '9'; }));
+        CPPUNIT_ASSERT_MESSAGE(password, std::any_of(password.begin(), password.end(), [](char c) { return !std::isalnum(c); }));
+    }
+}
+
+void PasswordGeneratorTests::testInvalidConfiguration()
+{
+    auto generator = PasswordGenerator(0);
+    CPPUNIT_ASSERT_THROW(generator.generate(), std::runtime_error);
+    generator.setLength(3);
+    generator.setRequiredClasses(PasswordCharacterClasses::All);
+    CPPUNIT_ASSERT_THROW(generator.generate(), std::runtime_error);
+    generator.setLength(8);
+    generator.setExcludedCharacters("0123456789");
+    CPPUNIT_ASSERT_THROW(generator.generate(), std::runtime_error);
+    generator.setCharacterClasses(PasswordCharacterClasses::None);
+    generator.setRequiredClasses(PasswordCharacterClasses::None);
+    CPPUNIT_ASSERT_THROW(generator.generate(), std::runtime_error);
+}
@@ -0,0 +1,161 @@
+#include "../io/entry.h"
+#include "../io/persistententry.h"
+
+#include "./utils.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Io;
+using namespace CppUtilities::Literals;
+
+using namespace CPPUNIT_NS;
+
+/*!
+ * \brief The PersistentEntryTests class tests the Io::PersistentEntry class.
+ */
+class PersistentEntryTests : public TestFixture {
+    CPPUNIT_TEST_SUITE(PersistentEntryTests);
+    CPPUNIT_TEST(testConversion);
+    CPPUNIT_TEST(testPathCopying);
+    CPPUNIT_TEST(testInvalidModifications);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testConversion();
+    void testPathCopying();
+    void testInvalidModifications();
+
+private:
+    NodeEntry m_root;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PersistentEntryTests);
+
+void PersistentEntryTests::setUp()
+{
+    m_root.setLabel("root");
+    auto *const account1 = new AccountEntry("account 1", &m_root);
+    account1->fields().emplace_back(account1, "user", "foo");
+    account1->fields().emplace_back(account1, "password", "bar");
+    account1->fields().back().setType(FieldType::Password);
+    auto *const category = new NodeEntry("category", &m_root);
+    category->setExpandedByDefault(false);
+    auto *const account2 = new AccountEntry("account 2", category);
+    account2->fields().emplace_back(account2, "user", "baz");
+    new NodeEntry("empty", category);
+}
+
+void PersistentEntryTests::tearDown()
+{
+}
+
+/*!
+ * \brief Returns the serialized data of \a entry for comparing trees.
+ */
+static string serialize(const Entry &entry)
+{
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    entry.make(stream, EntrySerializationFlags::SubtreeSizes | EntrySerializationFlags::FieldShapes);
+    return stream.str();
+}
+
+/*!
+ * \brief Tests converting from and to the Entry hierarchy.
+ */
+void PersistentEntryTests::testConversion()
+{
+    const auto root = PersistentEntry::fromEntry(m_root);
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, root->type());
+    CPPUNIT_ASSERT_EQUAL("root"s, root->label());
+    CPPUNIT_ASSERT_EQUAL(5_st, root->entryCount());
+    const auto *const account1 = root->entryByPath({ 0 });
+    CPPUNIT_ASSERT(account1);
+    CPPUNIT_ASSERT_EQUAL(EntryType::Account, account1->type());
+    CPPUNIT_ASSERT_EQUAL(2_st, account1->fields().size());
+    CPPUNIT_ASSERT_EQUAL("bar"s, account1->fields().back().value());
+    CPPUNIT_ASSERT_MESSAGE("fields not tied to an account", !account1->fields().back().tiedAccount());
+    CPPUNIT_ASSERT(!root->entryByPath({ 1 })->isExpandedByDefault());
+    CPPUNIT_ASSERT(!root->entryByPath({ 1, 2 }));
+    CPPUNIT_ASSERT(!root->entryByPath({ 0, 0 }));
+
+    const auto entry = unique_ptr<Entry>(root->toEntry());
+    CPPUNIT_ASSERT_EQUAL(serialize(m_root), serialize(*entry));
+    const auto *const convertedAccount = static_cast<const AccountEntry *>(static_cast<const NodeEntry *>(entry.get())->children().front());
+    CPPUNIT_ASSERT(convertedAccount->fields().front().tiedAccount() == convertedAccount);
+}
+
+/*!
+ * \brief Tests whether modifications only copy the path to the modified entry.
+ */
+void PersistentEntryTests::testPathCopying()
+{
+    const auto root = PersistentEntry::fromEntry(m_root);
+    const auto snapshot = root;
+    const auto expectedSnapshotData = serialize(m_root);
+
+    // modify an account within the category
+    auto fields = root->entryByPath({ 1, 0 })->fields();
+    fields.front().setValue("modified");
+    const auto modifiedRoot = PersistentEntry::withFields(root, { 1, 0 }, fields);
+    CPPUNIT_ASSERT(modifiedRoot != root);
+    CPPUNIT_ASSERT_MESSAGE("unmodified sibling shared", modifiedRoot->children()[0] == root->children()[0]);
+    CPPUNIT_ASSERT_MESSAGE("parent of modified entry copied", modifiedRoot->children()[1] != root->children()[1]);
+    CPPUNIT_ASSERT_MESSAGE("unmodified nested sibling shared", modifiedRoot->children()[1]->children()[1] == root->children()[1]->children()[1]);
+    CPPUNIT_ASSERT_EQUAL("modified"s, modifiedRoot->entryByPath({ 1, 0 })->fields().front().value());
+    CPPUNIT_ASSERT_EQUAL("baz"s, root->entryByPath({ 1, 0 })->fields().front().value());
+
+    // insert, relabel, move and remove entries
+    auto newRoot = PersistentEntry::withInsertedChild(modifiedRoot, { 1 }, 1, PersistentEntry::makeAccount("account 3"));
+    newRoot = PersistentEntry::withLabel(newRoot, {}, "new root");
+    newRoot = PersistentEntry::withExpandedByDefault(newRoot, { 1 }, true);
+    newRoot = PersistentEntry::withEntry(newRoot, { 0 }, newRoot->children()[1]->children()[2]);
+    newRoot = PersistentEntry::withoutChild(newRoot, { 1 }, 2);
+    CPPUNIT_ASSERT_EQUAL("new root"s, newRoot->label());
+    CPPUNIT_ASSERT_EQUAL(EntryType::Node, newRoot->children()[0]->type());
+    CPPUNIT_ASSERT_EQUAL("empty"s, newRoot->children()[0]->label());
+    CPPUNIT_ASSERT_EQUAL(2_st, newRoot->children()[1]->children().size());
+    CPPUNIT_ASSERT_EQUAL("account 3"s, newRoot->entryByPath({ 1, 1 })->label());
+    CPPUNIT_ASSERT(newRoot->entryByPath({ 1 })->isExpandedByDefault());
+    CPPUNIT_ASSERT_EQUAL(5_st, newRoot->entryCount());
+
+    // the snapshot taken before is not affected
+    const auto snapshotEntry = unique_ptr<Entry>(snapshot->toEntry());
+    CPPUNIT_ASSERT_EQUAL(expectedSnapshotData, serialize(*snapshotEntry));
+
+    // the same modifications on the Entry hierarchy lead to the same tree
+    static_cast<AccountEntry *>(static_cast<NodeEntry *>(m_root.children()[1])->children()[0])->fields().front().setValue("modified");
+    new AccountEntry("account 3", static_cast<NodeEntry *>(m_root.children()[1]));
+    static_cast<NodeEntry *>(m_root.children()[1])->children()[1]->setParent(static_cast<NodeEntry *>(m_root.children()[1]), 2);
+    m_root.setLabel("new root");
+    static_cast<NodeEntry *>(m_root.children()[1])->setExpandedByDefault(true);
+    const auto replacedAccount = unique_ptr<Entry>(m_root.children()[0]);
+    m_root.replaceChild(0, static_cast<NodeEntry *>(m_root.children()[1])->children()[2]);
+    const auto newEntry = unique_ptr<Entry>(newRoot->toEntry());
+    CPPUNIT_ASSERT_EQUAL(serialize(m_root), serialize(*newEntry));
+}
+
+/*!
+ * \brief Tests whether invalid modifications are rejected without affecting the tree.
+ */
+void PersistentEntryTests::testInvalidModifications()
+{
+    const auto root = PersistentEntry::fromEntry(m_root);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withLabel(root, { 2 }, "foo"), std::out_of_range);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withLabel(root, { 0, 0 }, "foo"), std::out_of_range);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withLabel(nullptr, {}, "foo"), std::out_of_range);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withEntry(root, { 3 }, PersistentEntry::makeNode("foo")), std::out_of_range);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withoutChild(root, { 1 }, 2), std::out_of_range);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withInsertedChild(root, { 0 }, 0, PersistentEntry::makeNode("foo")), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withExpandedByDefault(root, { 0 }, false), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(PersistentEntry::withFields(root, { 1 }, {}), std::invalid_argument);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE("tree not affected", 5_st, root->entryCount());
+    CPPUNIT_ASSERT_EQUAL("root"s, root->label());
+}
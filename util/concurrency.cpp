@@ -0,0 +1,152 @@
+#include "./concurrency.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace Util {
+
+/*!
+ * \brief Invokes \a task for the indices from 0 to \a taskCount using up to \a threadCount threads (including the
+ *        calling thread).
+ * \remarks Rethrows the first exception thrown by a task after all threads have been joined.
+ */
+void runConcurrently(std::size_t taskCount, std::size_t threadCount, const std::function<void(std::size_t)> &task)
+{
+    auto nextTask = std::atomic<std::size_t>();
+    auto error = std::exception_ptr();
+    auto errorMutex = std::mutex();
+    const auto runTasks = [&] {
+        for (auto i = nextTask++; i < taskCount; i = nextTask++) {
+            try {
+                task(i);
+            } catch (...) {
+                const auto lock = std::lock_guard<std::mutex>(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+    auto threads = std::vector<std::thread>();
+    threads.reserve(std::min(threadCount, taskCount));
+    for (auto i = std::size_t(1); i < threadCount && i < taskCount; ++i) {
+        threads.emplace_back(runTasks);
+    }
+    runTasks();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/*!
+ * \class ThreadPool
+ * \brief The ThreadPool class runs tasks on a fixed set of worker threads which live as long as the pool.
+ *
+ * It is meant to be owned by a stream buffer processing a sequence of independent blocks: the buffer posts one task
+ * per block and consumes the results in order via the returned futures. The queue of pending tasks is bounded so
+ * the producer is throttled instead of buffering an arbitrary amount of data.
+ *
+ * Each task is passed the index of the worker running it so it can use per-worker state without locking.
+ */
+
+/*!
+ * \brief Starts \a threadCount worker threads.
+ * \param queueSize Specifies the maximum number of tasks waiting to be picked up by a worker; defaults to twice the
+ *                  number of threads.
+ * \remarks If \a threadCount is one or less, no threads are started and post() runs tasks immediately.
+ */
+ThreadPool::ThreadPool(std::size_t threadCount, std::size_t queueSize)
+    : m_threadCount(std::max<std::size_t>(threadCount, 1))
+    , m_queueSize(queueSize ? queueSize : m_threadCount * 2)
+    , m_stopping(false)
+{
+    if (m_threadCount == 1) {
+        return;
+    }
+    m_threads.reserve(m_threadCount);
+    try {
+        for (auto i = std::size_t(); i != m_threadCount; ++i) {
+            m_threads.emplace_back(&ThreadPool::work, this, i);
+        }
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+/*!
+ * \brief Destroys the pool after stopping it (see stop()).
+ */
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+/*!
+ * \brief Discards the tasks which have not been started yet and waits for the running tasks to complete.
+ * \remarks The futures of discarded tasks report std::future_errc::broken_promise.
+ */
+void ThreadPool::stop()
+{
+    {
+        const auto lock = std::lock_guard<std::mutex>(m_mutex);
+        m_stopping = true;
+        m_queue.clear();
+    }
+    m_taskAvailable.notify_all();
+    m_spaceAvailable.notify_all();
+    for (auto &thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+/*!
+ * \brief Queues \a task to be run by the next idle worker.
+ * \returns Returns a future which becomes ready when the task has completed and which rethrows its exception.
+ * \remarks Blocks while the queue is full.
+ */
+std::future<void> ThreadPool::post(Task task)
+{
+    auto packagedTask = std::packaged_task<void(std::size_t)>(std::move(task));
+    auto future = packagedTask.get_future();
+    if (m_threads.empty()) {
+        packagedTask(0);
+        return future;
+    }
+    {
+        auto lock = std::unique_lock<std::mutex>(m_mutex);
+        m_spaceAvailable.wait(lock, [this] { return m_stopping || m_queue.size() < m_queueSize; });
+        m_queue.emplace_back(std::move(packagedTask));
+    }
+    m_taskAvailable.notify_one();
+    return future;
+}
+
+/*!
+ * \brief Runs queued tasks on the worker with the specified \a workerIndex until the pool is destroyed.
+ */
+void ThreadPool::work(std::size_t workerIndex)
+{
+    for (;;) {
+        auto task = std::packaged_task<void(std::size_t)>();
+        {
+            auto lock = std::unique_lock<std::mutex>(m_mutex);
+            m_taskAvailable.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_spaceAvailable.notify_one();
+        task(workerIndex);
+    }
+}
+
+} // namespace Util
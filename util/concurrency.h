@@ -0,0 +1,55 @@
+#ifndef PASSWORD_FILE_UTIL_CONCURRENCY_H
+#define PASSWORD_FILE_UTIL_CONCURRENCY_H
+
+#include "../global.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util {
+
+void runConcurrently(std::size_t taskCount, std::size_t threadCount, const std::function<void(std::size_t)> &task);
+
+class PASSWORD_FILE_EXPORT ThreadPool {
+public:
+    using Task = std::function<void(std::size_t)>;
+
+    explicit ThreadPool(std::size_t threadCount, std::size_t queueSize = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ~ThreadPool();
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t threadCount() const;
+    std::future<void> post(Task task);
+
+private:
+    void stop();
+    void work(std::size_t workerIndex);
+
+    std::size_t m_threadCount;
+    std::size_t m_queueSize;
+    std::deque<std::packaged_task<void(std::size_t)>> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_spaceAvailable;
+    bool m_stopping;
+    std::vector<std::thread> m_threads;
+};
+
+/*!
+ * \brief Returns the number of workers; tasks are passed a worker index below that number.
+ */
+inline std::size_t ThreadPool::threadCount() const
+{
+    return m_threadCount;
+}
+
+} // namespace Util
+
+#endif // PASSWORD_FILE_UTIL_CONCURRENCY_H
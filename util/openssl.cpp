@@ -4,11 +4,16 @@
 #include <c++utilities/conversion/binaryconversion.h>
 
 #include <openssl/conf.h>
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 
-#include <random>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 /*!
  * \brief Contains utility classes and functions.
@@ -22,6 +27,74 @@ namespace OpenSsl {
 
 static_assert(Sha256Sum::size == SHA256_DIGEST_LENGTH, "SHA-256 sum fits into Sha256Sum struct");
 
+/*!
+ * \brief The FetchCache struct holds the algorithms returned by fetchCipher() and fetchDigest().
+ * \remarks With OpenSSL 3 the algorithms are fetched explicitly and freed when the program exits. OpenSSL is initialized
+ *          before so its own clean-up runs after the algorithms have been freed.
+ */
+struct FetchCache {
+    FetchCache()
+    {
+        OPENSSL_init_crypto(0, nullptr);
+    }
+    ~FetchCache()
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        for (auto &[name, cipher] : ciphers) {
+            EVP_CIPHER_free(const_cast<evp_cipher_st *>(cipher));
+        }
+        for (auto &[name, digest] : digests) {
+            EVP_MD_free(const_cast<evp_md_st *>(digest));
+        }
+#endif
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::string, const evp_cipher_st *> ciphers;
+    std::unordered_map<std::string, const evp_md_st *> digests;
+};
+
+/*!
+ * \brief Returns the FetchCache of the process.
+ */
+static FetchCache &fetchCache()
+{
+    static auto cache = FetchCache();
+    return cache;
+}
+
+/// \brief The CipherContextPool struct holds the cipher contexts released on the current thread.
+struct CipherContextPool {
+    CipherContextPool()
+    {
+        contexts.reserve(CipherContext::maxPooledContexts);
+    }
+    ~CipherContextPool()
+    {
+        for (auto *const context : contexts) {
+            EVP_CIPHER_CTX_free(context);
+        }
+    }
+
+    std::vector<evp_cipher_ctx_st *> contexts;
+};
+
+static thread_local CipherContextPool cipherContextPool;
+
+/// \brief The DigestContext struct holds the digest context used by computeSha256Sum() on the current thread.
+struct DigestContext {
+    DigestContext()
+        : context(EVP_MD_CTX_new())
+    {
+    }
+    ~DigestContext()
+    {
+        EVP_MD_CTX_free(context);
+    }
+
+    evp_md_ctx_st *context;
+};
+
 /*!
  * \brief Initializes OpenSSL.
  */
@@ -46,23 +119,141 @@ void clean()
 
 /*!
  * \brief Computes a SHA-256 sum using OpenSSL.
+ * \remarks The digest is only fetched once and the digest context is re-used by further invocations on the same
+ *          thread. So repeatedly hashing small buffers (like when deriving keys) does not involve any lookups.
+ * \throws Throws std::runtime_error when OpenSSL is unable to compute the sum.
  */
 Sha256Sum computeSha256Sum(const unsigned char *buffer, std::size_t size)
 {
+    static const auto *const sha256 = fetchDigest("SHA256");
+    thread_local auto digestContext = DigestContext();
     auto hash = Sha256Sum();
-    SHA256(buffer, size, hash.data);
+    if (!sha256 || !digestContext.context || EVP_DigestInit_ex(digestContext.context, sha256, nullptr) != 1
+        || EVP_DigestUpdate(digestContext.context, buffer, size) != 1 || EVP_DigestFinal_ex(digestContext.context, hash.data, nullptr) != 1) {
+        throw std::runtime_error("Unable to compute SHA-256 sum: " + errorMessages());
+    }
     return hash;
 }
 
 /*!
- * \brief Generates a random number using OpenSSL.
+ * \brief Generates a random number within [\a min, \a max] using OpenSSL.
+ * \remarks The number is drawn from the thread-local pool of OpenSslRandomDevice without bias.
+ * \throws Throws Io::CryptoException when no random data can be obtained.
  */
 uint32_t generateRandomNumber(uint32_t min, uint32_t max)
 {
-    OpenSslRandomDevice dev;
-    std::default_random_engine rng(dev());
-    std::uniform_int_distribution<uint32_t> dist(min, max);
-    return dist(rng);
+    return OpenSslRandomDevice()(min, max);
+}
+
+/*!
+ * \brief Returns the messages of all errors queued by OpenSSL within the current thread and clears the queue.
+ */
+std::string errorMessages()
+{
+    auto messages = std::string();
+    while (const auto errorCode = ERR_get_error()) {
+        if (!messages.empty()) {
+            messages += '\n';
+        }
+        messages += ERR_error_string(errorCode, nullptr);
+    }
+    return messages;
+}
+
+/*!
+ * \brief Returns the cipher with the specified \a name or nullptr if it is not available.
+ * \remarks The cipher is only fetched once (explicitly when using OpenSSL 3) and kept until the program exits. So
+ *          using the returned cipher avoids the implicit lookup OpenSSL 3 does when using e.g. EVP_aes_256_cbc().
+ */
+const evp_cipher_st *fetchCipher(const char *name)
+{
+    auto &cache = fetchCache();
+    const auto lock = std::lock_guard<std::mutex>(cache.mutex);
+    auto &cipher = cache.ciphers[name];
+    if (!cipher) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        ERR_set_mark(); // do not leave an error in the queue if the algorithm is not available
+        cipher = EVP_CIPHER_fetch(nullptr, name, nullptr);
+        ERR_pop_to_mark();
+#else
+        cipher = EVP_get_cipherbyname(name);
+#endif
+    }
+    return cipher;
+}
+
+/*!
+ * \brief Returns the digest with the specified \a name or nullptr if it is not available.
+ * \remarks The digest is only fetched once (explicitly when using OpenSSL 3) and kept until the program exits.
+ */
+const evp_md_st *fetchDigest(const char *name)
+{
+    auto &cache = fetchCache();
+    const auto lock = std::lock_guard<std::mutex>(cache.mutex);
+    auto &digest = cache.digests[name];
+    if (!digest) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        ERR_set_mark(); // do not leave an error in the queue if the algorithm is not available
+        digest = EVP_MD_fetch(nullptr, name, nullptr);
+        ERR_pop_to_mark();
+#else
+        digest = EVP_get_digestbyname(name);
+#endif
+    }
+    return digest;
+}
+
+/*!
+ * \class CipherContext
+ * \brief The CipherContext class provides an OpenSSL cipher context which is taken from a pool when constructing and
+ *        returned to the pool when destroying.
+ *
+ * The pool is thread-local and holds up to maxPooledContexts contexts. So constructing contexts repeatedly (like when
+ * loading and saving many files) does not allocate new contexts each time. The context is reset before it is returned
+ * to the pool so no key material is kept around.
+ */
+
+/*!
+ * \brief Takes a cipher context from the pool of the current thread or allocates a new one if the pool is empty.
+ * \throws Throws std::bad_alloc when no context can be allocated.
+ */
+CipherContext::CipherContext()
+{
+    auto &contexts = cipherContextPool.contexts;
+    if (contexts.empty()) {
+        m_context = EVP_CIPHER_CTX_new();
+        if (!m_context) {
+            throw std::bad_alloc();
+        }
+    } else {
+        m_context = contexts.back();
+        contexts.pop_back();
+    }
+}
+
+/*!
+ * \brief Takes over the cipher context from \a other.
+ */
+CipherContext::CipherContext(CipherContext &&other) noexcept
+    : m_context(other.m_context)
+{
+    other.m_context = nullptr;
+}
+
+/*!
+ * \brief Resets the cipher context and returns it to the pool of the current thread.
+ */
+CipherContext::~CipherContext()
+{
+    if (!m_context) {
+        return;
+    }
+    auto &contexts = cipherContextPool.contexts;
+    if (contexts.size() < maxPooledContexts && EVP_CIPHER_CTX_reset(m_context) == 1) {
+        contexts.emplace_back(m_context);
+    } else {
+        EVP_CIPHER_CTX_free(m_context);
+    }
 }
 
 } // namespace OpenSsl
@@ -5,6 +5,11 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
+
+struct evp_cipher_st;
+struct evp_cipher_ctx_st;
+struct evp_md_st;
 
 namespace Util {
 
@@ -19,6 +24,33 @@ PASSWORD_FILE_EXPORT void init();
 PASSWORD_FILE_EXPORT void clean();
 PASSWORD_FILE_EXPORT Sha256Sum computeSha256Sum(const unsigned char *buffer, std::size_t size);
 PASSWORD_FILE_EXPORT std::uint32_t generateRandomNumber(std::uint32_t min, std::uint32_t max);
+PASSWORD_FILE_EXPORT std::string errorMessages();
+PASSWORD_FILE_EXPORT const evp_cipher_st *fetchCipher(const char *name);
+PASSWORD_FILE_EXPORT const evp_md_st *fetchDigest(const char *name);
+
+class PASSWORD_FILE_EXPORT CipherContext {
+public:
+    static constexpr std::size_t maxPooledContexts = 16;
+
+    explicit CipherContext();
+    CipherContext(CipherContext &&other) noexcept;
+    CipherContext(const CipherContext &) = delete;
+    ~CipherContext();
+    CipherContext &operator=(const CipherContext &) = delete;
+
+    evp_cipher_ctx_st *get() const;
+
+private:
+    evp_cipher_ctx_st *m_context;
+};
+
+/*!
+ * \brief Returns the OpenSSL cipher context.
+ */
+inline evp_cipher_ctx_st *CipherContext::get() const
+{
+    return m_context;
+}
 
 } // namespace OpenSsl
 } // namespace Util
@@ -1,22 +1,106 @@
 #include "./opensslrandomdevice.h"
+#include "./openssl.h"
 
 #include "../io/cryptoexception.h"
 
 #include <c++utilities/conversion/binaryconversion.h>
 
-#include <openssl/err.h>
+#include <openssl/crypto.h>
 #include <openssl/rand.h>
 
-#include <string>
+#ifdef PLATFORM_UNIX
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
 using namespace std;
 using namespace CppUtilities;
 
 namespace Util {
 
+/*!
+ * \brief The RandomPool struct holds random bytes obtained from RAND_bytes() which have not been served yet.
+ * \remarks
+ * - There is one pool per thread so serving bytes does not require any locking.
+ * - Served bytes are wiped from the pool and the pool is wiped when the thread exits.
+ * - The pool of the thread calling fork() is discarded in the child process so parent and child do not serve the same
+ *   bytes. (The pools of other threads do not exist in the child process.)
+ */
+struct RandomPool {
+    ~RandomPool();
+    void refill();
+    void take(unsigned char *buffer, std::size_t size);
+    void discard();
+
+    unsigned char data[OpenSslRandomDevice::poolSize];
+    std::size_t offset = OpenSslRandomDevice::poolSize;
+};
+
+static thread_local RandomPool randomPool;
+
+/*!
+ * \brief Wipes the remaining bytes.
+ */
+RandomPool::~RandomPool()
+{
+    discard();
+}
+
+/*!
+ * \brief Fills the pool with new random bytes.
+ * \throws Throws Io::CryptoException when RAND_bytes() fails.
+ */
+void RandomPool::refill()
+{
+#ifdef PLATFORM_UNIX
+    static std::once_flag registeredForkHandler;
+    std::call_once(registeredForkHandler, [] { pthread_atfork(nullptr, nullptr, [] { randomPool.discard(); }); });
+#endif
+    if (RAND_bytes(data, static_cast<int>(sizeof(data))) != 1) {
+        throw Io::CryptoException(OpenSsl::errorMessages());
+    }
+    offset = 0;
+}
+
+/*!
+ * \brief Copies \a size random bytes into \a buffer, refilling the pool as needed.
+ * \throws Throws Io::CryptoException when RAND_bytes() fails.
+ */
+void RandomPool::take(unsigned char *buffer, std::size_t size)
+{
+    while (size) {
+        if (offset == sizeof(data)) {
+            refill();
+        }
+        const auto chunkSize = std::min(size, sizeof(data) - offset);
+        std::memcpy(buffer, data + offset, chunkSize);
+        OPENSSL_cleanse(data + offset, chunkSize);
+        offset += chunkSize;
+        buffer += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+/*!
+ * \brief Wipes the remaining bytes so the next request refills the pool.
+ */
+void RandomPool::discard()
+{
+    OPENSSL_cleanse(data + offset, sizeof(data) - offset);
+    offset = sizeof(data);
+}
+
 /*!
  * \class OpenSslRandomDevice
  * \brief Provides a random device using the OpenSSL function RAND_bytes().
+ *
+ * The device satisfies the requirements of a UniformRandomBitGenerator so it can be used with the distributions of the
+ * standard library. It serves the random bytes from a thread-local pool which is refilled in blocks of poolSize bytes
+ * so generating many small random numbers does not call RAND_bytes() each time. Requests bigger than the pool are
+ * served by RAND_bytes() directly.
  */
 
 /*!
@@ -28,24 +112,53 @@ OpenSslRandomDevice::OpenSslRandomDevice()
 
 /*!
  * \brief Generates a new random number.
+ * \throws Throws Io::CryptoException when RAND_bytes() fails.
  */
 OpenSslRandomDevice::result_type OpenSslRandomDevice::operator()() const
 {
-    unsigned char buf[4];
-    if (RAND_bytes(buf, sizeof(buf))) {
-        return LE::toUInt32(reinterpret_cast<char *>(buf));
+    char buffer[sizeof(result_type)];
+    randomPool.take(reinterpret_cast<unsigned char *>(buffer), sizeof(buffer));
+    return LE::toUInt32(buffer);
+}
+
+/*!
+ * \brief Generates a new random number within [\a min, \a max].
+ * \remarks Numbers are drawn until one falls into the biggest range which is a multiple of the requested range so
+ *          the result is not biased towards lower numbers.
+ * \throws Throws Io::CryptoException when RAND_bytes() fails.
+ */
+OpenSslRandomDevice::result_type OpenSslRandomDevice::operator()(result_type min, result_type max) const
+{
+    const auto range = static_cast<result_type>(max - min + 1);
+    if (!range) {
+        return (*this)(); // the whole range of result_type has been requested
+    }
+    const auto threshold = static_cast<result_type>(-range % range);
+    for (;;) {
+        if (const auto number = (*this)(); number >= threshold) {
+            return min + number % range;
+        }
     }
+}
 
-    // handle error case
-    string errorMsg;
-    while (unsigned long errorCode = ERR_get_error()) {
-        if (!errorMsg.empty()) {
-            errorMsg += '\n';
+/*!
+ * \brief Fills the specified \a buffer with \a size random bytes.
+ * \throws Throws Io::CryptoException when RAND_bytes() fails.
+ */
+void OpenSslRandomDevice::generate(unsigned char *buffer, std::size_t size) const
+{
+    if (size <= poolSize) {
+        randomPool.take(buffer, size);
+        return;
+    }
+    for (constexpr auto maxChunkSize = static_cast<std::size_t>(std::numeric_limits<int>::max()); size;) {
+        const auto chunkSize = std::min(size, maxChunkSize);
+        if (RAND_bytes(buffer, static_cast<int>(chunkSize)) != 1) {
+            throw Io::CryptoException(OpenSsl::errorMessages());
         }
-        errorMsg += ERR_error_string(errorCode, nullptr);
-        errorCode = ERR_get_error();
+        buffer += chunkSize;
+        size -= chunkSize;
     }
-    throw Io::CryptoException(std::move(errorMsg));
 }
 
 /*!
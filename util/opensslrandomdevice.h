@@ -3,6 +3,7 @@
 
 #include "../global.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 
@@ -12,8 +13,12 @@ class PASSWORD_FILE_EXPORT OpenSslRandomDevice {
 public:
     using result_type = std::uint32_t;
 
+    static constexpr std::size_t poolSize = 4096;
+
     OpenSslRandomDevice();
     result_type operator()() const;
+    result_type operator()(result_type min, result_type max) const;
+    void generate(unsigned char *buffer, std::size_t size) const;
     bool status() const;
     static constexpr result_type min();
     static constexpr result_type max();
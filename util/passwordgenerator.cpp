@@ -0,0 +1,217 @@
+#include "./passwordgenerator.h"
+#include "./opensslrandomdevice.h"
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Util {
+
+/*!
+ * \brief The CharacterClass struct associates a class of characters with the characters it consists of.
+ */
+struct CharacterClass {
+    PasswordCharacterClasses flag;
+    const char *characters;
+};
+
+static constexpr CharacterClass characterClassTable[] = {
+    { PasswordCharacterClasses::LowerCase, "abcdefghijklmnopqrstuvwxyz" },
+    { PasswordCharacterClasses::UpperCase, "ABCDEFGHIJKLMNOPQRSTUVWXYZ" },
+    { PasswordCharacterClasses::Digits, "0123456789" },
+    { PasswordCharacterClasses::Symbols, "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~" },
+};
+
+/*!
+ * \brief The RandomIndexSampler class draws indices within [0, alphabetSize) from blocks of random bytes.
+ *
+ * Each index is taken from one random byte. Bytes not smaller than the biggest multiple of the alphabet size which
+ * fits into a byte are rejected so the indices are not biased towards lower values. Less than half of the bytes are
+ * rejected for any alphabet size (and none for alphabet sizes which divide 256).
+ */
+class RandomIndexSampler {
+public:
+    static constexpr std::size_t blockSize = 1024;
+
+    explicit RandomIndexSampler(std::size_t alphabetSize);
+    ~RandomIndexSampler();
+    void sample(unsigned char *indices, std::size_t count);
+
+private:
+    const OpenSslRandomDevice m_random;
+    const unsigned int m_alphabetSize;
+    const unsigned int m_limit;
+    std::array<unsigned char, blockSize> m_block;
+    std::size_t m_offset;
+};
+
+/*!
+ * \brief Constructs a sampler for the specified \a alphabetSize (which must be within [1, 256]).
+ */
+RandomIndexSampler::RandomIndexSampler(std::size_t alphabetSize)
+    : m_alphabetSize(static_cast<unsigned int>(alphabetSize))
+    , m_limit(256u - 256u % m_alphabetSize)
+    , m_offset(blockSize)
+{
+}
+
+/*!
+ * \brief Wipes the unused random bytes.
+ */
+RandomIndexSampler::~RandomIndexSampler()
+{
+    OPENSSL_cleanse(m_block.data(), m_block.size());
+}
+
+/*!
+ * \brief Writes \a count indices to \a indices.
+ * \throws Throws Io::CryptoException when no random data can be obtained.
+ */
+void RandomIndexSampler::sample(unsigned char *indices, std::size_t count)
+{
+    for (auto *const end = indices + count; indices != end;) {
+        if (m_offset == blockSize) {
+            m_random.generate(m_block.data(), blockSize);
+            m_offset = 0;
+        }
+        // note: The loop is branch-free so rejected bytes do not cause mispredicted branches; the index of a rejected
+        //       byte is just overwritten by the next one.
+        const auto *const block = m_block.data();
+        const auto available = std::min(blockSize - m_offset, static_cast<std::size_t>(end - indices));
+        auto written = std::size_t();
+        for (auto i = m_offset, blockEnd = m_offset + available; i != blockEnd; ++i) {
+            const auto byte = static_cast<unsigned int>(block[i]);
+            indices[written] = static_cast<unsigned char>(byte % m_alphabetSize);
+            written += byte < m_limit;
+        }
+        m_offset += available;
+        indices += written;
+    }
+}
+
+/*!
+ * \class PasswordGenerator
+ * \brief The PasswordGenerator class generates random passwords using OpenSslRandomDevice.
+ *
+ * Each character is chosen uniformly from the alphabet which is made of the characters of the configured classes
+ * without the excluded characters. When required classes are configured, passwords lacking a character of a required
+ * class are discarded and generated again. So the generated passwords are still uniformly distributed among all
+ * passwords meeting the requirements.
+ *
+ * The random bytes are requested in blocks and turned into characters via rejection sampling (see RandomIndexSampler)
+ * so generating many passwords at once via generate(std::size_t) is cheap.
+ */
+
+/*!
+ * \brief Constructs a new generator for passwords with the specified \a length and \a characterClasses.
+ */
+PasswordGenerator::PasswordGenerator(std::size_t length, PasswordCharacterClasses characterClasses)
+    : m_length(length)
+    , m_characterClasses(characterClasses)
+    , m_requiredClasses(PasswordCharacterClasses::None)
+    , m_excludingAmbiguousCharacters(false)
+{
+}
+
+/*!
+ * \brief Returns the characters the generated passwords are composed of.
+ */
+std::string PasswordGenerator::alphabet() const
+{
+    auto alphabet = std::string();
+    for (const auto &characterClass : characterClassTable) {
+        if (!(m_characterClasses & characterClass.flag)) {
+            continue;
+        }
+        for (const auto *character = characterClass.characters; *character; ++character) {
+            if (m_excludedCharacters.find(*character) == std::string::npos
+                && (!m_excludingAmbiguousCharacters || !std::strchr(ambiguousCharacters, *character))) {
+                alphabet += *character;
+            }
+        }
+    }
+    return alphabet;
+}
+
+/*!
+ * \brief Generates a new password.
+ * \throws Throws std::runtime_error when the configuration does not allow generating a password; see generate(std::size_t).
+ * \throws Throws Io::CryptoException when no random data can be obtained.
+ */
+std::string PasswordGenerator::generate() const
+{
+    return std::move(generate(1).front());
+}
+
+/*!
+ * \brief Generates \a count new passwords.
+ * \throws Throws std::runtime_error when the configuration does not allow generating a password. That is the case when
+ *         the length is zero, the alphabet is empty, a required class is not part of the alphabet or the length is smaller
+ *         than the number of required classes.
+ * \throws Throws Io::CryptoException when no random data can be obtained.
+ */
+std::vector<std::string> PasswordGenerator::generate(std::size_t count) const
+{
+    // determine alphabet and the required class of each character
+    const auto characters = alphabet();
+    if (!m_length) {
+        throw std::runtime_error("Unable to generate passwords: The length is zero.");
+    }
+    if (characters.empty()) {
+        throw std::runtime_error("Unable to generate passwords: No characters are left to choose from.");
+    }
+    auto characterMasks = std::array<unsigned int, 256>();
+    auto requiredMask = 0u;
+    auto requiredCount = std::size_t();
+    for (auto classIndex = 0u; classIndex != std::size(characterClassTable); ++classIndex) {
+        const auto &characterClass = characterClassTable[classIndex];
+        if (!(m_requiredClasses & characterClass.flag)) {
+            continue;
+        }
+        const auto mask = 1u << classIndex;
+        requiredMask |= mask;
+        ++requiredCount;
+        auto present = false;
+        for (const auto *character = characterClass.characters; *character; ++character) {
+            if (characters.find(*character) != std::string::npos) {
+                characterMasks[static_cast<unsigned char>(*character)] |= mask;
+                present = true;
+            }
+        }
+        if (!present) {
+            throw std::runtime_error("Unable to generate passwords: A required class of characters is not part of the alphabet.");
+        }
+    }
+    if (m_length < requiredCount) {
+        throw std::runtime_error("Unable to generate passwords: The length is smaller than the number of required classes.");
+    }
+
+    // generate passwords, discarding the ones not meeting the requirements
+    auto passwords = std::vector<std::string>();
+    passwords.reserve(count);
+    auto sampler = RandomIndexSampler(characters.size());
+    auto indices = std::string(m_length, '\0');
+    auto *const indexData = reinterpret_cast<unsigned char *>(indices.data());
+    while (passwords.size() != count) {
+        sampler.sample(indexData, m_length);
+        auto &password = passwords.emplace_back(m_length, '\0');
+        auto presentMask = 0u;
+        for (auto i = std::size_t(); i != m_length; ++i) {
+            presentMask |= characterMasks[static_cast<unsigned char>(password[i] = characters[indexData[i]])];
+        }
+        if ((presentMask & requiredMask) != requiredMask) {
+            OPENSSL_cleanse(password.data(), password.size());
+            passwords.pop_back();
+        }
+    }
+    OPENSSL_cleanse(indices.data(), indices.size());
+    return passwords;
+}
+
+} // namespace Util
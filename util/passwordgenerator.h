@@ -0,0 +1,138 @@
+#ifndef PASSWORD_FILE_UTIL_PASSWORDGENERATOR_H
+#define PASSWORD_FILE_UTIL_PASSWORDGENERATOR_H
+
+#include "../global.h"
+
+#include <c++utilities/misc/flagenumclass.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Util {
+
+enum class PasswordCharacterClasses : std::uint64_t {
+    None = 0,
+    LowerCase = 1,
+    UpperCase = 2,
+    Digits = 4,
+    Symbols = 8,
+    All = LowerCase | UpperCase | Digits | Symbols,
+};
+
+class PASSWORD_FILE_EXPORT PasswordGenerator {
+public:
+    static constexpr const char *ambiguousCharacters = "0Oo1lI|";
+
+    explicit PasswordGenerator(std::size_t length = 20, PasswordCharacterClasses characterClasses = PasswordCharacterClasses::All);
+
+    std::size_t length() const;
+    void setLength(std::size_t length);
+    PasswordCharacterClasses characterClasses() const;
+    void setCharacterClasses(PasswordCharacterClasses characterClasses);
+    PasswordCharacterClasses requiredClasses() const;
+    void setRequiredClasses(PasswordCharacterClasses requiredClasses);
+    const std::string &excludedCharacters() const;
+    void setExcludedCharacters(const std::string &excludedCharacters);
+    bool isExcludingAmbiguousCharacters() const;
+    void setExcludingAmbiguousCharacters(bool excludingAmbiguousCharacters);
+    std::string alphabet() const;
+    std::string generate() const;
+    std::vector<std::string> generate(std::size_t count) const;
+
+private:
+    std::size_t m_length;
+    PasswordCharacterClasses m_characterClasses;
+    PasswordCharacterClasses m_requiredClasses;
+    std::string m_excludedCharacters;
+    bool m_excludingAmbiguousCharacters;
+};
+
+/*!
+ * \brief Returns the length of the generated passwords.
+ */
+inline std::size_t PasswordGenerator::length() const
+{
+    return m_length;
+}
+
+/*!
+ * \brief Sets the length of the generated passwords.
+ */
+inline void PasswordGenerator::setLength(std::size_t length)
+{
+    m_length = length;
+}
+
+/*!
+ * \brief Returns the classes of characters the generated passwords are composed of.
+ */
+inline PasswordCharacterClasses PasswordGenerator::characterClasses() const
+{
+    return m_characterClasses;
+}
+
+/*!
+ * \brief Sets the classes of characters the generated passwords are composed of.
+ */
+inline void PasswordGenerator::setCharacterClasses(PasswordCharacterClasses characterClasses)
+{
+    m_characterClasses = characterClasses;
+}
+
+/*!
+ * \brief Returns the classes of characters each generated password contains at least one character of.
+ * \remarks Defaults to no classes.
+ */
+inline PasswordCharacterClasses PasswordGenerator::requiredClasses() const
+{
+    return m_requiredClasses;
+}
+
+/*!
+ * \brief Sets the classes of characters each generated password contains at least one character of.
+ * \remarks The required classes must be a subset of characterClasses().
+ */
+inline void PasswordGenerator::setRequiredClasses(PasswordCharacterClasses requiredClasses)
+{
+    m_requiredClasses = requiredClasses;
+}
+
+/*!
+ * \brief Returns the characters which are never used.
+ */
+inline const std::string &PasswordGenerator::excludedCharacters() const
+{
+    return m_excludedCharacters;
+}
+
+/*!
+ * \brief Sets the characters which are never used.
+ */
+inline void PasswordGenerator::setExcludedCharacters(const std::string &excludedCharacters)
+{
+    m_excludedCharacters = excludedCharacters;
+}
+
+/*!
+ * \brief Returns whether the characters in ambiguousCharacters are never used.
+ */
+inline bool PasswordGenerator::isExcludingAmbiguousCharacters() const
+{
+    return m_excludingAmbiguousCharacters;
+}
+
+/*!
+ * \brief Sets whether the characters in ambiguousCharacters are never used.
+ */
+inline void PasswordGenerator::setExcludingAmbiguousCharacters(bool excludingAmbiguousCharacters)
+{
+    m_excludingAmbiguousCharacters = excludingAmbiguousCharacters;
+}
+
+} // namespace Util
+
+CPP_UTILITIES_MARK_FLAG_ENUM_CLASS(Util, Util::PasswordCharacterClasses);
+
+#endif // PASSWORD_FILE_UTIL_PASSWORDGENERATOR_H